@@ -15,6 +15,51 @@
 #define IV_LEN        12
 #define TAG_LEN       16
 
+#define BLOB_OVERHEAD (IV_LEN + TAG_LEN)
+
+/** @brief: cipher identifiers, the first byte of a tagged blob */
+#define CIPHER_AES_256_GCM       0x01
+#define CIPHER_CHACHA20_POLY1305 0x02
+
+#define CIPHER_HEADER_LEN    1
+#define TAGGED_BLOB_OVERHEAD (CIPHER_HEADER_LEN + BLOB_OVERHEAD)
+
+#define KEYED_HASH_MAX_KEY_LEN 64
+#define KEYED_HASH_MAX_LEN     64
+
+#define KDF_MIN_T_COST 1
+#define KDF_MAX_T_COST 16
+#define KDF_MIN_M_COST 65536
+#define KDF_MAX_M_COST 4194304
+#define KDF_MAX_P_COST 16
+
+/**
+ * @brief: Argon2id cost parameters used by derive_key_material
+ *
+ * @note: m_cost is expressed in KiB, p_cost is both the lanes and threads count
+ */
+typedef struct {
+    uint32_t t_cost;
+    uint32_t m_cost;
+    uint32_t p_cost;
+} KdfParams;
+
+/** @brief: KdfDescriptor algorithm identifiers */
+#define KDF_ALG_ARGON2ID 0x01
+
+/**
+ * @brief: Everything needed to re-derive the key material of a vault
+ *
+ * @note: stored along with the vault so its cost can change without
+ * breaking existing vaults
+ */
+typedef struct {
+    uint8_t algorithm;
+    KdfParams params;
+    uint32_t out_len;
+    uint8_t salt[SALT_LEN];
+} KdfDescriptor;
+
 /**
  * @brief: hashes a password and a titan_key and a salt and produces a 64 bits
  * data
@@ -27,6 +72,10 @@
  * @return: true if succeed, false otherwise
  *
  * @note: consider allocating memory for the out_key pointer
+ * @note: the cost parameters are the ones set by set_kdf_params, the
+ * ARGON_*_COST constants otherwise
+ * @note: on linux the argon2 memory is mmap'd (huge pages when available),
+ * locked when RLIMIT_MEMLOCK allows it and excluded from core dumps
  *
  * @warning: the titan_key and salt pointers must point to 32 bit memory block
  */
@@ -35,6 +84,78 @@ bool derive_key_material(const char *password,
                          const uint8_t *salt,
                          uint8_t *out_key);
 
+/**
+ * @brief: derives the key material described by a KdfDescriptor
+ *
+ * @param: password a string as const char*
+ * @param: titan_key random data of 32 bytes as const uint8_t*
+ * @param: kdf the descriptor holding the algorithm, costs, salt and length
+ * @param: out_key the uint8_t* pointer of which the kdf->out_len bytes result
+ * will be stored
+ *
+ * @return: true if succeed, false otherwise (including invalid descriptors)
+ */
+bool derive_key_material_kdf(const char *password,
+                             const uint8_t *titan_key,
+                             const KdfDescriptor *kdf,
+                             uint8_t *out_key);
+
+/**
+ * @brief: checks that a descriptor uses a known algorithm, valid costs and
+ * an output length of MAT_KEY_LEN
+ *
+ * @param: kdf the descriptor to check
+ *
+ * @return: true if valid, false otherwise (or on NULL)
+ */
+bool is_valid_kdf_descriptor(const KdfDescriptor *kdf);
+
+/**
+ * @brief: checks that KDF parameters are within the KDF_MIN_* and KDF_MAX_*
+ * bounds
+ *
+ * @param: params the parameters to check
+ *
+ * @return: true if valid, false otherwise (or on NULL)
+ */
+bool is_valid_kdf_params(const KdfParams *params);
+
+/**
+ * @brief: sets the cost parameters used by derive_key_material
+ *
+ * @param: params the new parameters
+ *
+ * @return: true if succeed, false if the parameters are invalid
+ *
+ * @warning: not thread safe, meant to be called once at startup
+ */
+bool set_kdf_params(const KdfParams *params);
+
+/**
+ * @brief: reads the cost parameters currently used by derive_key_material
+ *
+ * @param: out_params where the parameters will be stored
+ */
+void get_kdf_params(KdfParams *out_params);
+
+/**
+ * @brief: benchmarks argon2id on the current host and picks the strongest
+ * parameters that run within a target latency and memory budget
+ *
+ * @param: target_ms the latency target of one derivation, in milliseconds
+ * @param: mem_budget_kib the memory budget in KiB, 0 to use half of the
+ * currently available memory
+ * @param: out_params where the chosen parameters will be stored
+ *
+ * @return: true if succeed, false otherwise
+ *
+ * @note: one lane per online CPU (up to KDF_MAX_P_COST), memory is raised
+ * before passes. On slow hosts the KDF_MIN_* floor may exceed the target.
+ * @note: runs several full derivations, expect it to take a few times
+ * target_ms
+ */
+bool calibrate_kdf(uint32_t target_ms, uint64_t mem_budget_kib, KdfParams *out_params);
+
 /**
  * @brief: hashes a password and a salt and produces a 32 bit data
  *
@@ -45,6 +166,7 @@ bool derive_key_material(const char *password,
  * @return: true if succeed, false otherwise
  *
  * @note: consider allocating memory for the out_key pointer
+ * @note: uses the same argon2 memory allocator as derive_key_material
  *
  * @warning: the salt pointer must points to 32 bit memory block
  */
@@ -52,6 +174,28 @@ bool hash_key(const uint8_t *key,
                            const uint8_t *salt,
                            uint8_t *out_key);
 
+/**
+ * @brief: keyed BLAKE2b of data, a fast MAC for high entropy keys
+ *
+ * @param: key the MAC key as a const uint8_t*
+ * @param: key_len the key length, 1 to KEYED_HASH_MAX_KEY_LEN bytes
+ * @param: data the data to authenticate, may be NULL when data_len is 0
+ * @param: data_len the length of data
+ * @param: out_hash the uint8_t* pointer of which the result will be stored
+ * @param: out_len the digest length, 1 to KEYED_HASH_MAX_LEN bytes
+ *
+ * @return: true if succeed, false otherwise
+ *
+ * @warning: not a password hash, use derive_key_material for low entropy
+ * secrets
+ */
+bool keyed_hash(const uint8_t *key,
+                size_t key_len,
+                const uint8_t *data,
+                size_t data_len,
+                uint8_t *out_hash,
+                size_t out_len);
+
 /**
  * @brief: encrypt data
  *
@@ -88,4 +232,270 @@ bool decrypt_blob(const uint8_t *key,
                   size_t blob_len,
                   uint8_t *out_plaintext);
 
+/**
+ * @brief: checks that a cipher id is one of the CIPHER_* constants
+ *
+ * @param: cipher the id to check
+ *
+ * @return: true if known, false otherwise
+ */
+bool is_valid_cipher(uint8_t cipher);
+
+/**
+ * @brief: picks the faster cipher for the current host
+ *
+ * @return: CIPHER_AES_256_GCM when the CPU has AES and carry-less multiply
+ * instructions, CIPHER_CHACHA20_POLY1305 otherwise
+ */
+uint8_t preferred_cipher(void);
+
+/**
+ * @brief: encrypt data into a tagged blob, its cipher id followed by the IV,
+ * the ciphertext and the tag
+ *
+ * @param: key the 32 bytes master key as a const uint8_t*
+ * @param: cipher one of the CIPHER_* constants
+ * @param: plaintext the data of which will be encrypted as a const uint8_t*
+ * @param: plaintext_len the length of the plaintext as a size_t
+ * @param: out_blob where plaintext_len + TAGGED_BLOB_OVERHEAD bytes will be
+ * stored
+ *
+ * @return: true if succeed, false otherwise (including an unknown cipher)
+ *
+ * @note: the cipher id is authenticated along with the ciphertext
+ */
+bool encrypt_tagged_blob(const uint8_t *key,
+                         uint8_t cipher,
+                         const uint8_t *plaintext,
+                         size_t plaintext_len,
+                         uint8_t *out_blob);
+
+/**
+ * @brief: decrypt a tagged blob with the cipher named by its header
+ *
+ * @param: key the 32 bytes master key as a const uint8_t*
+ * @param: blob the data of which will be decrypted as a const uint8_t*
+ * @param: blob_len the length of the blob as a size_t
+ * @param: out_plaintext where blob_len - TAGGED_BLOB_OVERHEAD bytes will be
+ * stored
+ *
+ * @return: true if succeed, false otherwise (including an unknown cipher)
+ */
+bool decrypt_tagged_blob(const uint8_t *key,
+                         const uint8_t *blob,
+                         size_t blob_len,
+                         uint8_t *out_plaintext);
+
+/**
+ * @brief: handle keeping the key and reusable cipher contexts, so encrypting
+ * or decrypting many blobs under the same key only costs an IV setup per blob.
+ * Each (cipher, direction) context is keyed the first time it is used
+ *
+ * @note: the untagged functions produce and accept the AES-256-GCM blobs of
+ * encrypt_blob and decrypt_blob, the tagged ones seal with the cipher the
+ * context was created for and open any known cipher
+ * @warning: not thread safe, use one context per thread
+ */
+typedef struct AeadContext AeadContext;
+
+/**
+ * @brief: a read-only byte range, the input of the batch functions
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+} BlobSpan;
+
+/**
+ * @brief: creates an AeadContext for a key
+ *
+ * @param: key the 32 bytes master key as a const uint8_t*
+ *
+ * @return: the context, NULL on failure
+ *
+ * @note: the key is copied into the context and wiped by aead_context_free
+ */
+AeadContext *aead_context_new(const uint8_t *key);
+
+/**
+ * @brief: creates an AeadContext whose tagged blobs use a given cipher
+ *
+ * @param: key the 32 bytes master key as a const uint8_t*
+ * @param: cipher one of the CIPHER_* constants
+ *
+ * @return: the context, NULL on failure (including an unknown cipher)
+ *
+ * @note: aead_context_new is aead_context_new_cipher with CIPHER_AES_256_GCM
+ */
+AeadContext *aead_context_new_cipher(const uint8_t *key, uint8_t cipher);
+
+/**
+ * @brief: the cipher aead_seal_tagged uses with a context, 0 for NULL
+ */
+uint8_t aead_context_cipher(const AeadContext *aead);
+
+/**
+ * @brief: wipes and frees an AeadContext, NULL is ignored
+ */
+void aead_context_free(AeadContext *aead);
+
+/**
+ * @brief: encrypt_blob with an AeadContext
+ *
+ * @param: aead the context holding the key
+ * @param: plaintext the data of which will be encrypted as a const uint8_t*
+ * @param: plaintext_len the length of the plaintext as a size_t
+ * @param: out_blob where plaintext_len + BLOB_OVERHEAD bytes will be stored
+ *
+ * @return: true if succeed, false otherwise
+ */
+bool aead_encrypt(AeadContext *aead,
+                  const uint8_t *plaintext,
+                  size_t plaintext_len,
+                  uint8_t *out_blob);
+
+/**
+ * @brief: decrypt_blob with an AeadContext
+ *
+ * @param: aead the context holding the key
+ * @param: blob the data of which will be decrypted as a const uint8_t*
+ * @param: blob_len the length of the blob as a size_t
+ * @param: out_plaintext where blob_len - BLOB_OVERHEAD bytes will be stored
+ *
+ * @return: true if succeed, false otherwise (including a wrong key or a
+ * tampered blob)
+ */
+bool aead_decrypt(AeadContext *aead,
+                  const uint8_t *blob,
+                  size_t blob_len,
+                  uint8_t *out_plaintext);
+
+/**
+ * @brief: aead_encrypt binding associated data to the blob
+ *
+ * @param: aead the context holding the key
+ * @param: ad data authenticated but not encrypted nor stored, may be NULL
+ * when ad_len is 0
+ * @param: ad_len the length of ad
+ * @param: plaintext the data of which will be encrypted as a const uint8_t*
+ * @param: plaintext_len the length of the plaintext as a size_t
+ * @param: out_blob where plaintext_len + BLOB_OVERHEAD bytes will be stored
+ *
+ * @return: true if succeed, false otherwise
+ *
+ * @note: the blob only decrypts with the same ad, see aead_decrypt_ad
+ */
+bool aead_encrypt_ad(AeadContext *aead,
+                     const uint8_t *ad,
+                     size_t ad_len,
+                     const uint8_t *plaintext,
+                     size_t plaintext_len,
+                     uint8_t *out_blob);
+
+/**
+ * @brief: aead_decrypt of a blob made by aead_encrypt_ad
+ *
+ * @param: aead the context holding the key
+ * @param: ad the associated data the blob was encrypted with
+ * @param: ad_len the length of ad
+ * @param: blob the data of which will be decrypted as a const uint8_t*
+ * @param: blob_len the length of the blob as a size_t
+ * @param: out_plaintext where blob_len - BLOB_OVERHEAD bytes will be stored
+ *
+ * @return: true if succeed, false otherwise (including a different ad)
+ */
+bool aead_decrypt_ad(AeadContext *aead,
+                     const uint8_t *ad,
+                     size_t ad_len,
+                     const uint8_t *blob,
+                     size_t blob_len,
+                     uint8_t *out_plaintext);
+
+/**
+ * @brief: aead_encrypt_ad producing a tagged blob with the context's cipher
+ *
+ * @param: aead the context holding the key
+ * @param: ad data authenticated but not encrypted nor stored, may be NULL
+ * when ad_len is 0
+ * @param: ad_len the length of ad
+ * @param: plaintext the data of which will be encrypted as a const uint8_t*
+ * @param: plaintext_len the length of the plaintext as a size_t
+ * @param: out_blob where plaintext_len + TAGGED_BLOB_OVERHEAD bytes will be
+ * stored
+ *
+ * @return: true if succeed, false otherwise
+ */
+bool aead_seal_tagged(AeadContext *aead,
+                      const uint8_t *ad,
+                      size_t ad_len,
+                      const uint8_t *plaintext,
+                      size_t plaintext_len,
+                      uint8_t *out_blob);
+
+/**
+ * @brief: decrypts a tagged blob with the cipher named by its header
+ *
+ * @param: aead the context holding the key, whatever its own cipher
+ * @param: ad the associated data the blob was encrypted with
+ * @param: ad_len the length of ad
+ * @param: blob the data of which will be decrypted as a const uint8_t*
+ * @param: blob_len the length of the blob as a size_t
+ * @param: out_plaintext where blob_len - TAGGED_BLOB_OVERHEAD bytes will be
+ * stored
+ *
+ * @return: true if succeed, false otherwise (including an unknown cipher)
+ */
+bool aead_open_tagged(AeadContext *aead,
+                      const uint8_t *ad,
+                      size_t ad_len,
+                      const uint8_t *blob,
+                      size_t blob_len,
+                      uint8_t *out_plaintext);
+
+/**
+ * @brief: encrypts count plaintexts into one caller supplied slab
+ *
+ * @param: aead the context holding the key
+ * @param: plaintexts the count plaintexts to encrypt
+ * @param: count the number of plaintexts
+ * @param: out_slab where the blobs are stored back to back, in order
+ * @param: slab_len the size of out_slab, at least the sum of the plaintext
+ * lengths plus count * BLOB_OVERHEAD
+ * @param: out_blobs optional, receives where each blob lies in out_slab
+ *
+ * @return: true if succeed, false otherwise (including a slab too small)
+ *
+ * @note: the IVs of the whole batch are drawn from the CSPRNG together
+ */
+bool aead_encrypt_batch(AeadContext *aead,
+                        const BlobSpan *plaintexts,
+                        size_t count,
+                        uint8_t *out_slab,
+                        size_t slab_len,
+                        BlobSpan *out_blobs);
+
+/**
+ * @brief: decrypts count blobs into one caller supplied slab
+ *
+ * @param: aead the context holding the key
+ * @param: blobs the count blobs to decrypt
+ * @param: count the number of blobs
+ * @param: out_slab where the plaintexts are stored back to back, in order
+ * @param: slab_len the size of out_slab, at least the sum of the blob lengths
+ * minus count * BLOB_OVERHEAD
+ * @param: out_plaintexts optional, receives where each plaintext lies in
+ * out_slab
+ *
+ * @return: true if succeed, false otherwise (including a slab too small)
+ *
+ * @note: all or nothing, when a blob does not authenticate the plaintexts
+ * already written to out_slab are wiped
+ */
+bool aead_decrypt_batch(AeadContext *aead,
+                        const BlobSpan *blobs,
+                        size_t count,
+                        uint8_t *out_slab,
+                        size_t slab_len,
+                        BlobSpan *out_plaintexts);
+
 #endif
@@ -13,6 +13,12 @@
  * - uuid is a null-terminated C string.
  * - other text fields are binary blobs and may contain null bytes.
  * - *_len fields indicate the size of each blob.
+ * - record is a packed record holding every field in one blob. Entries hold
+ *   either the record (with NULL field blobs) or the field blobs (with a NULL
+ *   record), the latter being the format rows were written in before.
+ * - entries read by the repository or built by encrypt_entry() own a single
+ *   block starting at uuid, the other fields point into it (see
+ *   free_int_entry()).
  */
 typedef struct {
     char *uuid;
@@ -27,6 +33,9 @@ typedef struct {
     uint32_t password_len;
     uint32_t notes_len;
 
+    uint8_t *record;
+    uint32_t record_len;
+
     uint64_t created_at;
     uint64_t updated_at;
 } IntVaultEntry;
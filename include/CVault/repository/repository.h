@@ -3,8 +3,10 @@
 
 #include <CVault/models/config.h>
 #include <CVault/models/vault_entry.h>
+#include <CVault/repository/statement_cache.h>
 #include <CVault/utils/data_structure_utils.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <vendor/sqlite3/sqlite3.h>
 
 /**
@@ -19,9 +21,26 @@ typedef enum {
     REPO_UNEXPECTED_ERR
 } repo_return_code;
 
+/**
+ * @brief Version of the entries schema, stored as vault.db's user_version
+ *
+ * @details version 2 keys the entries by their UUID as a 16 bytes BLOB in a
+ * WITHOUT ROWID table. The API still takes and returns uuid strings, they are
+ * converted at the repository edge. Version 3 adds record_blob, a packed
+ * record holding every field (see entry_service.h); a row holds either the
+ * record or the per-field blobs.
+ */
+#define VAULT_SCHEMA_VERSION 3
+
+/** @brief Rows per transaction of add_entries() and update_entries() when batch_size is 0 */
+#define REPO_DEFAULT_BATCH 1000
+
 /**
  * @brief Initialize the vault database schema
  *
+ * @details Older tables are rebuilt as the current one in a single
+ * transaction, their rows keep their per-field blobs
+ *
  * @param db Pointer to the SQLite database connection
  *
  * @return repo_return_code OK on success, DATA_BASE_ERR on database erorr
@@ -40,13 +59,40 @@ repo_return_code repo_vault_init(sqlite3 *db);
  */
 repo_return_code add_entry(IntVaultEntry *entry, sqlite3 *db);
 
+/**
+ * @brief Add many vault entries with one statement and few commits
+ *
+ * @details Inserts the entries in order, batch_size rows per transaction. A
+ * row that fails (duplicate uuid, malformed entry) is reported in out_results
+ * and skipped, the rest of its batch is still committed. Called inside a
+ * transaction, the rows join it and nothing is committed.
+ *
+ * @param entries Array of count entries to add
+ * @param count Number of entries
+ * @param batch_size Rows per transaction, 0 for REPO_DEFAULT_BATCH
+ * @param out_results Array of count codes receiving each row's add_entry()
+ * result, DATA_BASE_ERR for rows of a batch that could not be committed. May
+ * be NULL
+ * @param db Pointer to the SQLite database connection
+ *
+ * @return repo_return_code OK once every batch was committed, whatever the
+ * row results, DATA_BASE_ERR when a transaction failed (the following batches
+ * are not attempted)
+ */
+repo_return_code add_entries(IntVaultEntry *entries,
+                             size_t count,
+                             size_t batch_size,
+                             repo_return_code *out_results,
+                             sqlite3 *db);
+
 /**
  * @brief Retrieve a vault entry by UUID
  *
  * @details Fetches a single entry from the database and decrypts its fields
  *
  * @param uuid The unique identifier of the entry to retrieve
- * @param out_entry Pointer to store the retrieved entry data (caller allocated)
+ * @param out_entry Pointer to store the retrieved entry data (caller allocated),
+ * its fields are one block to release with free_int_entry()
  * @param db Pointer to the SQLite database connection
  *
  * @return repo_return_code OK on success, NOT_FOUND_ERR if uuid doesn't exist,
@@ -60,7 +106,8 @@ repo_return_code read_entry(const char *uuid, IntVaultEntry *out_entry, sqlite3
  * @details Fetches all entries and stores them in a doubly linked list
  *
  * @param out_wrapper Pointer to the linked list head where entries will be appended (caller
- * allocated)
+ * allocated). Each entry is one block holding the struct and its fields, to
+ * release with free_int_entry_node()
  * @param db Pointer to the SQLite database connection
  *
  * @return repo_return_code OK on success, MEMORY_ERR on allocation failure,
@@ -69,10 +116,144 @@ repo_return_code read_entry(const char *uuid, IntVaultEntry *out_entry, sqlite3
  */
 repo_return_code read_all_entries(DLinkedList *out_wrapper, sqlite3 *db);
 
+/**
+ * @brief Release an entry filled by read_entry(), next_entry() or
+ * encrypt_entry()
+ *
+ * @details The uuid heads the single block holding every field, freeing it
+ * releases them all. The struct itself is zeroed
+ *
+ * @param entry The entry, NULL is ignored
+ */
+void free_int_entry(IntVaultEntry *entry);
+
+/**
+ * @brief Release an entry of a list filled by the repository, struct
+ * included
+ *
+ * @details Meant for dlinked_list_destroy()
+ *
+ * @param data The IntVaultEntry* of a list node
+ */
+void free_int_entry_node(void *data);
+
+/**
+ * @brief Iterator over the entries table, one row in memory at a time
+ */
+typedef struct EntryCursor EntryCursor;
+
+/**
+ * @brief Open a cursor over all vault entries
+ *
+ * @details The rows are stepped from a live statement by next_entry(), so
+ * the first one is available at once and memory does not grow with the
+ * vault. In borrow mode the entries point into SQLite's column memory instead
+ * of being copied
+ *
+ * @param borrow true to borrow the column memory, false for malloc'd copies
+ * @param out_cursor Receives the cursor, to be closed with close_entry_cursor()
+ * @param db Pointer to the SQLite database connection
+ *
+ * @return repo_return_code OK on success, MEMORY_ERR on allocation failure,
+ * DATA_BASE_ERR on database error
+ *
+ * @warning The cursor holds a read transaction on db until it is closed
+ */
+repo_return_code open_entry_cursor(bool borrow, EntryCursor **out_cursor, sqlite3 *db);
+
+/**
+ * @brief Step a cursor to its next entry
+ *
+ * @param cursor The cursor
+ * @param out_entry Receives the entry. Without borrow its fields are the
+ * caller's to free with free_int_entry(), as with read_entry(). With borrow they, the uuid
+ * included, are read only and valid until the next call or close
+ *
+ * @return repo_return_code OK when out_entry holds an entry, NOT_FOUND_ERR
+ * past the last one, MEMORY_ERR on allocation failure, DATA_BASE_ERR on
+ * database error
+ */
+repo_return_code next_entry(EntryCursor *cursor, IntVaultEntry *out_entry);
+
+/**
+ * @brief Close a cursor and release its statement
+ *
+ * @param cursor The cursor, NULL is ignored
+ */
+void close_entry_cursor(EntryCursor *cursor);
+
+/**
+ * @brief Retrieve a page of vault entries in uuid order
+ *
+ * @details Fetches at most limit entries whose uuid sorts after after_uuid,
+ * the uuid of the last entry of a page being the after_uuid of the next one.
+ * Shorthand for read_entries_page() in ENTRY_ORDER_UUID
+ *
+ * @param after_uuid The uuid the page starts after, NULL for the first page
+ * @param limit Maximum number of entries to fetch
+ * @param out_wrapper Pointer to the linked list where entries will be appended (caller
+ * allocated), as with read_all_entries()
+ * @param db Pointer to the SQLite database connection
+ *
+ * @return repo_return_code OK on success (fewer than limit entries on the
+ * last page), NOT_FOUND_ERR if after_uuid is not a UUID, MEMORY_ERR on
+ * allocation failure, DATA_BASE_ERR on database error, DATA_STRUCTURE_ERR on
+ * list operation failure
+ */
+repo_return_code read_entries_after(const char *after_uuid,
+                                    uint32_t limit,
+                                    DLinkedList *out_wrapper,
+                                    sqlite3 *db);
+
+/**
+ * @brief Orders of read_entries_page()
+ */
+typedef enum {
+    /** @brief By uuid, the storage order */
+    ENTRY_ORDER_UUID = 0,
+
+    /** @brief Most recently updated first, uuid descending among equal times */
+    ENTRY_ORDER_RECENT
+} entry_order;
+
+/** @brief Size of a continuation token buffer, NUL included */
+#define ENTRY_PAGE_TOKEN_LEN 64
+
+/**
+ * @brief Retrieve one page of vault entries in a stable order
+ *
+ * @details Keyset pagination: the token names the last entry of the previous
+ * page and the page is a range scan of an index starting right after it
+ * (the primary key, or entries_recent on updated_at and uuid), so every page
+ * costs the same whatever its position. Entries added or changed between two
+ * calls are neither skipped nor repeated unless they move across the token
+ *
+ * @param order The order of the pages, the same for every page of a listing
+ * @param token The out_next_token of the previous page, NULL or "" for the
+ * first page
+ * @param limit Maximum number of entries to fetch
+ * @param out_wrapper Pointer to the linked list where entries will be appended (caller
+ * allocated), as with read_all_entries()
+ * @param out_next_token Buffer of ENTRY_PAGE_TOKEN_LEN bytes, receives the
+ * token of the next page, "" after the last page
+ * @param db Pointer to the SQLite database connection
+ *
+ * @return repo_return_code OK on success, NOT_FOUND_ERR if token is malformed
+ * or from another order, MEMORY_ERR on allocation failure, DATA_BASE_ERR on
+ * database error, DATA_STRUCTURE_ERR on list operation failure
+ */
+repo_return_code read_entries_page(entry_order order,
+                                   const char *token,
+                                   uint32_t limit,
+                                   DLinkedList *out_wrapper,
+                                   char *out_next_token,
+                                   sqlite3 *db);
+
 /**
  * @brief Update an existing vault entry
  *
  * @details Updates specific fields of an entry identified by UUID. NULL values are skipped.
+ * A non NULL record replaces the whole entry: the per-field blobs are cleared.
  *
  * @param uuid The unique identifier of the entry to update
  * @param new_entry Pointer to entry data with updated fields (NULL fields are not updated)
@@ -83,6 +264,29 @@ repo_return_code read_all_entries(DLinkedList *out_wrapper, sqlite3 *db);
  */
 repo_return_code update_entry(const char *uuid, IntVaultEntry *new_entry, sqlite3 *db);
 
+/**
+ * @brief Update many vault entries with one statement and few commits
+ *
+ * @details Same as update_entry() for each entry, identified by its own uuid,
+ * batched like add_entries()
+ *
+ * @param entries Array of count entries, NULL fields are not updated
+ * @param count Number of entries
+ * @param batch_size Rows per transaction, 0 for REPO_DEFAULT_BATCH
+ * @param out_results Array of count codes receiving each row's update_entry()
+ * result, DATA_BASE_ERR for rows of a batch that could not be committed. May
+ * be NULL
+ * @param db Pointer to the SQLite database connection
+ *
+ * @return repo_return_code OK once every batch was committed, whatever the
+ * row results, DATA_BASE_ERR when a transaction failed
+ */
+repo_return_code update_entries(IntVaultEntry *entries,
+                                size_t count,
+                                size_t batch_size,
+                                repo_return_code *out_results,
+                                sqlite3 *db);
+
 /**
  * @brief Delete a vault entry by UUID
  * @details Permanently removes an entry from the database
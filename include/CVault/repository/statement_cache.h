@@ -0,0 +1,69 @@
+#ifndef STATEMENT_CACHE_H
+#define STATEMENT_CACHE_H
+
+#include <stdint.h>
+#include <vendor/sqlite3/sqlite3.h>
+
+/**
+ * Prepared statements of the repository, kept per connection
+ *
+ * Every repository function takes its statement from repo_prepare() and hands
+ * it back with repo_release(), which resets it and clears its bindings instead
+ * of finalizing it, so each SQL text is parsed and planned once per
+ * connection. A statement already checked out (the same query running on
+ * another thread, or nested) is prepared afresh and finalized on release.
+ *
+ * The cached statements keep their connection busy: connections used by the
+ * repository must be closed with repo_close().
+ */
+
+/** @brief Statements cached per connection, the others are prepared on each use */
+#define REPO_STATEMENT_CACHE_SLOTS 32
+
+/**
+ * @brief Use counters of a connection's statement cache
+ */
+typedef struct {
+    uint64_t hits;   /**< statements reused from the cache */
+    uint64_t misses; /**< statements prepared, cached or not */
+    uint32_t cached; /**< statements currently held */
+} RepoStatementStats;
+
+/**
+ * @brief Get a prepared statement for sql on db
+ *
+ * @param db Pointer to the SQLite database connection
+ * @param sql The SQL text, compared by content
+ *
+ * @return The statement, reset and without bindings, or NULL on database or
+ * memory error. It must be given back with repo_release()
+ */
+sqlite3_stmt *repo_prepare(sqlite3 *db, const char *sql);
+
+/**
+ * @brief Give back a statement returned by repo_prepare()
+ *
+ * @param db Pointer to the SQLite database connection
+ * @param stmt The statement, NULL is ignored
+ */
+void repo_release(sqlite3 *db, sqlite3_stmt *stmt);
+
+/**
+ * @brief Read the statement cache counters of a connection
+ *
+ * @param db Pointer to the SQLite database connection
+ * @param out_stats Receives the counters, zeroed for a connection that has no
+ * cache yet
+ */
+void repo_statement_stats(sqlite3 *db, RepoStatementStats *out_stats);
+
+/**
+ * @brief Finalize the cached statements of a connection and close it
+ *
+ * @param db Pointer to the SQLite database connection, NULL is ignored
+ *
+ * @return int SQLITE_OK on success, the sqlite3_close() error otherwise
+ */
+int repo_close(sqlite3 *db);
+
+#endif // !STATEMENT_CACHE_H
@@ -2,6 +2,7 @@
 #define DB_INII_SERVICE_H
 
 #include <stdbool.h>
+#include <vendor/sqlite3/sqlite3.h>
 
 /**
  * @brief Initializes the database schema.
@@ -17,4 +18,16 @@ bool init_schema();
  */
 bool is_init_schema();
 
+/**
+ * @brief Opens vault.db and checks it holds the entries table.
+ *
+ * @param out_db receives the connection, to be closed with repo_close().
+ * It is set to NULL on failure.
+ *
+ * @return true if the database is open and its schema is valid.
+ *
+ * @note Paths must have been initialized with initialize_paths().
+ */
+bool open_vault_db(sqlite3 **out_db);
+
 #endif // !DB_INII_SERVICE_H
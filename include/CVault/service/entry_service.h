@@ -0,0 +1,183 @@
+#ifndef ENTRY_SERVICE_H
+#define ENTRY_SERVICE_H
+
+#include <CVault/crypto/crypto_core.h>
+#include <CVault/models/vault_entry.h>
+#include <CVault/utils/data_structure_utils.h>
+#include <CVault/utils/secret_arena.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vendor/sqlite3/sqlite3.h>
+
+/**
+ * @file entry_service.h
+ * @brief Encryption and decryption of vault entries
+ *
+ * Entries are stored as one packed record per row:
+ * - 1 byte: ENTRY_RECORD_VERSION_02
+ * - the aead_seal_tagged() blob (cipher id, IV, ciphertext, tag) of the
+ *   plaintext service_len, username_len, password_len, notes_len (4 bytes
+ *   little endian each, ENTRY_RECORD_NO_NOTES for an entry without notes)
+ *   followed by the four fields
+ *
+ * The associated data is the version byte followed by the 16 bytes of the
+ * uuid, so a record cannot be swapped between entries. Version 01 records
+ * hold an untagged AES-256-GCM blob instead, and rows written before records
+ * hold one encrypt_blob() blob per field; both are read as well and rewritten
+ * as version 02 records by load_entry() and by descriptor upgrades.
+ *
+ * decrypt_entries() turns the IntVaultEntry list returned by the repository
+ * into ExtVaultEntry plaintexts. Large lists are split in chunks of
+ * ENTRY_DECODE_CHUNK entries claimed by worker threads, each with its own
+ * AeadContext; every entry is written at its own index so the output keeps
+ * the row order. Given a SecretArena, the array, the uuids and the fields
+ * are all carved from it: records open in place in locked memory and the
+ * whole result is dropped by resetting the arena instead of entry by entry.
+ */
+
+/** @brief Version bytes of the packed record format */
+#define ENTRY_RECORD_VERSION_01 0x01
+#define ENTRY_RECORD_VERSION_02 0x02
+
+/** @brief notes_len of a record whose entry has no notes */
+#define ENTRY_RECORD_NO_NOTES 0xFFFFFFFFu
+
+/** @brief Size of the field lengths leading the record plaintext */
+#define ENTRY_RECORD_LENGTHS_SIZE 16
+
+/** @brief Record size besides the fields: version, cipher id, IV, lengths and tag */
+#define ENTRY_RECORD_OVERHEAD (1 + TAGGED_BLOB_OVERHEAD + ENTRY_RECORD_LENGTHS_SIZE)
+
+/** @brief Entries claimed at once by a decode worker */
+#define ENTRY_DECODE_CHUNK 64
+
+/** @brief Upper bound of the decode worker count */
+#define ENTRY_MAX_WORKERS 64
+
+/**
+ * @brief Return codes for Entry Service operations, stored in es_status
+ */
+typedef enum {
+    /** @brief Operation successful */
+    ES_SUCCESS = 0,
+
+    /** @brief An entry is malformed or does not authenticate under the key */
+    ES_DECRYPT_ERR,
+
+    /** @brief Memory or cipher context allocation failed */
+    ES_MEMORY_ERR,
+
+    /** @brief The entry does not exist */
+    ES_NOT_FOUND,
+
+    /** @brief Reading vault.db failed */
+    ES_DB_ERR
+} es_return_code;
+
+/**
+ * @brief Throughput of the last decrypt_entries() call
+ */
+typedef struct {
+    uint64_t entries;  /**< entries decrypted */
+    uint64_t bytes;    /**< plaintext bytes produced */
+    uint32_t workers;  /**< threads that took part, the caller included */
+    double elapsed_ms; /**< wall-clock time of the whole decode */
+    double mib_per_s;  /**< bytes over elapsed_ms, 0 for an empty list */
+} DecodeStats;
+
+/**
+ * @brief Status of the last Entry Service operation
+ */
+extern es_return_code es_status;
+
+/**
+ * @brief Decrypt a list of repository entries
+ *
+ * @param[in] entries IntVaultEntry* list, as filled by read_all_entries()
+ * @param[in] key The VAULT_MASTER_KEY_LEN bytes master key
+ * @param[in] workers Thread count, 0 for one per online CPU. Capped at
+ *                    ENTRY_MAX_WORKERS and at one per chunk of entries
+ * @param[in] arena Where the plaintexts go, NULL for the heap
+ * @param[out] out_entries Receives an array of entries->size ExtVaultEntry
+ *                         in list order, NULL for an empty list
+ * @param[out] out_stats Receives the throughput, may be NULL
+ *
+ * @return true if every entry was decrypted
+ *
+ * @post On failure *out_entries is NULL, nothing decrypted is left in memory
+ *       (the arena is rewound to where it was) and es_status is
+ *       ES_DECRYPT_ERR or ES_MEMORY_ERR
+ *
+ * @note The text fields are NUL terminated, notes is NULL when the entry has
+ * none. Release a heap array with free_ext_entries(), an arena array with
+ * secret_arena_reset() or secret_arena_destroy() and never one entry at a time
+ * @note Runs on the caller's thread alone when threads cannot be created
+ */
+bool decrypt_entries(const DLinkedList *entries,
+                     const uint8_t *key,
+                     uint32_t workers,
+                     SecretArena *arena,
+                     ExtVaultEntry **out_entries,
+                     DecodeStats *out_stats);
+
+/**
+ * @brief Encrypt an entry as a packed record
+ *
+ * @param[in] aead Context holding the master key, its cipher is the record's
+ * @param[in] entry The entry, its uuid must be a UUID string and notes may be
+ *                  NULL
+ * @param[out] out_row Receives a copy of the uuid, the record and the
+ *                     timestamps, the field blobs are NULL. Release it with
+ *                     free_int_entry()
+ *
+ * @return true on success, out_row is left zeroed otherwise
+ */
+bool encrypt_entry(AeadContext *aead, const ExtVaultEntry *entry, IntVaultEntry *out_row);
+
+/**
+ * @brief Decrypt a repository entry, packed record or per-field blobs
+ *
+ * @param[in] aead Context holding the master key
+ * @param[in] row The entry as read from the repository
+ * @param[out] out_entry Receives the entry, release it with free_ext_entry()
+ *
+ * @return true on success, out_entry is left zeroed otherwise
+ */
+bool decrypt_entry(AeadContext *aead, const IntVaultEntry *row, ExtVaultEntry *out_entry);
+
+/**
+ * @brief Read and decrypt one entry, rewriting it as a packed record when it
+ * still uses per-field blobs
+ *
+ * @param[in] db The vault.db connection
+ * @param[in] aead Context holding the master key, created with the vault's
+ *                 cipher (see read_vault_cipher())
+ * @param[in] uuid The entry to read
+ * @param[out] out_entry Receives the entry, release it with free_ext_entry()
+ *
+ * @return true if the entry was read, whether or not the rewrite succeeded
+ *
+ * @post On failure es_status is ES_NOT_FOUND, ES_DB_ERR, ES_DECRYPT_ERR or
+ *       ES_MEMORY_ERR
+ *
+ * @note A row whose record uses another cipher than aead's is left as is
+ */
+bool load_entry(sqlite3 *db, AeadContext *aead, const char *uuid, ExtVaultEntry *out_entry);
+
+/**
+ * @brief Wipe and free the fields of one entry, the struct itself is zeroed
+ *
+ * @param[in] entry The entry, NULL is ignored
+ */
+void free_ext_entry(ExtVaultEntry *entry);
+
+/**
+ * @brief Wipe and free a heap array returned by decrypt_entries()
+ *
+ * @param[in] entries The array, NULL is ignored
+ * @param[in] count Its number of entries
+ */
+void free_ext_entries(ExtVaultEntry *entries, size_t count);
+
+#endif // !ENTRY_SERVICE_H
@@ -0,0 +1,174 @@
+#ifndef KDF_SERVICE_H
+#define KDF_SERVICE_H
+
+#include <CVault/crypto/crypto_core.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file kdf_service.h
+ * @brief Host KDF cost calibration and per-vault KDF descriptors
+ *
+ * Benchmarks argon2id on the current host, records the chosen parameters in
+ * the configs table and applies them to derive_key_material. They are the
+ * target every vault descriptor is upgraded to.
+ *
+ * The record stored under KDF_PARAMS_CONFIG_KEY has the following layout
+ * (integers are little-endian):
+ * - 1 byte: record version
+ * - 4 bytes: t_cost
+ * - 4 bytes: m_cost (KiB)
+ * - 4 bytes: p_cost
+ *
+ * @note The configuration service must be opened before calling any of these
+ * functions.
+ */
+
+/** @brief Key of the calibrated parameters in the configs table */
+#define KDF_PARAMS_CONFIG_KEY "kdf_params"
+
+/** @brief Version identifier of the parameters record */
+#define KDF_PARAMS_RECORD_VERSION_01 0x01
+
+/** @brief Total record size: version(1) + t(4) + m(4) + p(4) = 13 bytes */
+#define KDF_PARAMS_RECORD_SIZE_V01 13
+
+/** @brief Key of the vault KDF descriptor in the configs table */
+#define KDF_DESCRIPTOR_CONFIG_KEY "kdf_descriptor"
+
+/** @brief Version identifier of the descriptor record */
+#define KDF_DESCRIPTOR_RECORD_VERSION_01 0x01
+
+/**
+ * @brief Descriptor record size: version(1) + algorithm(1) + t(4) + m(4) +
+ * p(4) + out_len(4) + salt(32) = 50 bytes
+ */
+#define KDF_DESCRIPTOR_RECORD_SIZE_V01 (18 + SALT_LEN)
+
+/** @brief Unlock latency targeted when no explicit target is given */
+#define KDF_DEFAULT_TARGET_MS 1000
+
+/**
+ * @brief Return codes for KDF Service operations, stored in kdf_status
+ */
+typedef enum {
+    /** @brief Operation successful */
+    KDF_SUCCESS = 0,
+
+    /** @brief The benchmark could not run argon2id */
+    KDF_CALIBRATION_ERR,
+
+    /** @brief Reading or writing the configs table failed */
+    KDF_CONFIG_ERR,
+
+    /** @brief The stored record has a wrong size or invalid parameters */
+    KDF_CORRUPTED_ERR,
+
+    /** @brief The stored record has an unknown version byte */
+    KDF_UNSUPPORTED_VER_ERR
+} kdf_return_code;
+
+/**
+ * @brief Status of the last KDF Service operation
+ */
+extern kdf_return_code kdf_status;
+
+/**
+ * @brief Calibrate the KDF on this host, record and apply the result
+ *
+ * @param[in] target_ms Latency target of one derivation in milliseconds,
+ *                      0 for KDF_DEFAULT_TARGET_MS
+ * @param[in] mem_budget_kib Memory budget in KiB, 0 to derive it from the
+ *                           currently available memory
+ * @param[out] out_params Receives the chosen parameters, may be NULL
+ *
+ * @return true if the parameters were calibrated, stored and applied
+ *
+ * @post On failure kdf_status is KDF_CALIBRATION_ERR or KDF_CONFIG_ERR
+ *
+ * @note Takes a few times target_ms to complete
+ */
+bool calibrate_kdf_service(uint32_t target_ms, uint64_t mem_budget_kib, KdfParams *out_params);
+
+/**
+ * @brief Apply the recorded parameters to derive_key_material
+ *
+ * @details When no calibration record can be read the compiled-in
+ * ARGON_*_COST defaults are kept and the call succeeds.
+ *
+ * @return true if the recorded parameters (or the defaults) are in use
+ *
+ * @post On failure kdf_status is KDF_CORRUPTED_ERR or
+ *       KDF_UNSUPPORTED_VER_ERR and the previous parameters are kept
+ */
+bool load_kdf_service();
+
+/**
+ * @brief Build a descriptor for a new vault from the parameters in use
+ *
+ * @param[out] out_kdf Receives the descriptor, with a fresh random salt
+ *
+ * @return true on success, false if out_kdf is NULL or no salt could be drawn
+ */
+bool new_kdf_descriptor(KdfDescriptor *out_kdf);
+
+/**
+ * @brief Check whether a vault descriptor differs from the parameters in use
+ *
+ * @details Both weaker and stronger descriptors are outdated, so lowering the
+ * calibrated cost also lowers the cost of existing vaults.
+ *
+ * @param[in] kdf The descriptor to check
+ *
+ * @return true if the vault should be re-derived with new_kdf_descriptor()
+ */
+bool is_outdated_kdf_descriptor(const KdfDescriptor *kdf);
+
+/**
+ * @brief Serialize a descriptor into a KDF_DESCRIPTOR_RECORD_SIZE_V01 record
+ *
+ * @param[in] kdf The descriptor to serialize, must be valid
+ * @param[out] out_record Buffer of at least KDF_DESCRIPTOR_RECORD_SIZE_V01 bytes
+ *
+ * @return true on success, false on NULL or invalid descriptor
+ */
+bool encode_kdf_descriptor(const KdfDescriptor *kdf, uint8_t *out_record);
+
+/**
+ * @brief Parse a descriptor record
+ *
+ * @param[in] record The serialized record
+ * @param[in] record_len Its length in bytes
+ * @param[out] out_kdf Receives the descriptor
+ *
+ * @return true if the record is a valid descriptor
+ *
+ * @post On failure kdf_status is KDF_UNSUPPORTED_VER_ERR or KDF_CORRUPTED_ERR
+ */
+bool decode_kdf_descriptor(const uint8_t *record, size_t record_len, KdfDescriptor *out_kdf);
+
+/**
+ * @brief Read the vault KDF descriptor from the configs table
+ *
+ * @param[out] out_kdf Receives the descriptor
+ *
+ * @return true on success
+ *
+ * @post On failure kdf_status is KDF_CONFIG_ERR (no descriptor),
+ *       KDF_UNSUPPORTED_VER_ERR or KDF_CORRUPTED_ERR
+ */
+bool read_kdf_descriptor_service(KdfDescriptor *out_kdf);
+
+/**
+ * @brief Add or replace the vault KDF descriptor in the configs table
+ *
+ * @param[in] kdf The descriptor to store, must be valid
+ *
+ * @return true on success
+ *
+ * @post On failure kdf_status is KDF_CONFIG_ERR or KDF_CORRUPTED_ERR
+ */
+bool store_kdf_descriptor_service(const KdfDescriptor *kdf);
+
+#endif // !KDF_SERVICE_H
@@ -0,0 +1,121 @@
+#ifndef REKEY_SERVICE_H
+#define REKEY_SERVICE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vendor/sqlite3/sqlite3.h>
+
+/**
+ * @file rekey_service.h
+ * @brief Re-encryption of every entry of vault.db under a new data key
+ *
+ * rekey_entries() runs as a three stage pipeline over pages of
+ * REKEY_DEFAULT_BATCH entries read in uuid order:
+ * - a reader thread fetching the next page with read_entries_after()
+ * - worker threads decrypting each entry with the old key and sealing it as a
+ *   packed record under the new one
+ * - the calling thread writing each page back in its own transaction, in
+ *   page order, then reporting the last uuid written as a checkpoint
+ *
+ * At most one page per worker plus REKEY_QUEUE_DEPTH are in memory at once,
+ * whatever the size of the vault. An entry that already opens with the new
+ * key is skipped, so a run resumed from any checkpoint at or before the last
+ * page written (or from the start) finishes the job without touching
+ * anything twice.
+ */
+
+/** @brief Entries per page when RekeyOptions.batch_size is 0 */
+#define REKEY_DEFAULT_BATCH 256
+
+/** @brief Pages in flight besides the ones being sealed: read ahead and written */
+#define REKEY_QUEUE_DEPTH 2
+
+/** @brief Upper bound of the worker thread count */
+#define REKEY_MAX_WORKERS 16
+
+/**
+ * @brief Return codes for Rekey Service operations, stored in rk_status
+ */
+typedef enum {
+    /** @brief Operation successful */
+    RK_SUCCESS = 0,
+
+    /** @brief An entry opens with neither key */
+    RK_DECRYPT_ERR,
+
+    /** @brief Sealing an entry under the new key failed */
+    RK_ENCRYPT_ERR,
+
+    /** @brief Reading or writing vault.db failed */
+    RK_DB_ERR,
+
+    /** @brief The checkpoint callback failed, the run stopped after the page */
+    RK_CHECKPOINT_ERR,
+
+    /** @brief Memory, thread or cipher context allocation failed */
+    RK_MEMORY_ERR
+} rk_return_code;
+
+/**
+ * @brief Called after each page is committed
+ *
+ * @param[in] last_uuid The uuid of the last entry of the page
+ * @param[in] arg RekeyOptions.checkpoint_arg
+ *
+ * @return false to stop the run
+ */
+typedef bool (*RekeyCheckpoint)(const char *last_uuid, void *arg);
+
+/**
+ * @brief Tuning and resumption of a rekey_entries() run
+ */
+typedef struct {
+    uint32_t batch_size;        /**< entries per page, 0 for REKEY_DEFAULT_BATCH */
+    uint32_t workers;           /**< crypto threads, 0 for one per online CPU */
+    const char *resume_after;   /**< checkpoint of an interrupted run, NULL to start */
+    RekeyCheckpoint checkpoint; /**< may be NULL */
+    void *checkpoint_arg;
+} RekeyOptions;
+
+/**
+ * @brief Progress and throughput of the last rekey_entries() call
+ */
+typedef struct {
+    uint64_t entries;      /**< entries re-encrypted */
+    uint64_t skipped;      /**< entries found under the new key already */
+    uint64_t batches;      /**< pages committed */
+    uint32_t workers;      /**< crypto threads used */
+    double elapsed_ms;     /**< wall-clock time of the whole run */
+    double entries_per_s;  /**< entries plus skipped over elapsed_ms */
+} RekeyStats;
+
+/**
+ * @brief Status of the last Rekey Service operation
+ */
+extern rk_return_code rk_status;
+
+/**
+ * @brief Re-encrypt every entry under a new key
+ *
+ * @param[in] db The vault.db connection, not used by anyone else during the run
+ * @param[in] old_key The VAULT_MASTER_KEY_LEN bytes key the entries are under
+ * @param[in] new_key The VAULT_MASTER_KEY_LEN bytes key to move them to
+ * @param[in] cipher The CIPHER_* constant of the new records
+ * @param[in] options May be NULL for the defaults
+ * @param[out] out_stats Receives the progress, filled on failure too. May be
+ *                       NULL
+ *
+ * @return true once every entry opens with new_key
+ *
+ * @post On failure the pages committed so far stay under new_key, the run
+ *       can be resumed from the last checkpoint. rk_status tells why it
+ *       stopped
+ */
+bool rekey_entries(sqlite3 *db,
+                   const uint8_t *old_key,
+                   const uint8_t *new_key,
+                   uint8_t cipher,
+                   const RekeyOptions *options,
+                   RekeyStats *out_stats);
+
+#endif // !REKEY_SERVICE_H
@@ -15,7 +15,10 @@
  * The service uses a versioned blob format with the following structure:
  * - 1 byte: version identifier
  * - 32 bytes: the actual key material
- * - 32 bytes: HMAC for integrity verification
+ * - 32 bytes: MAC for integrity verification
+ *
+ * v1 MACs are hash_key() (Argon2id) digests, v2 MACs are keyed BLAKE2b
+ * digests. v1 files are rewritten as v2 the first time they are loaded.
  */
 
 /** @brief Version identifier for Titan Key format v1 */
@@ -24,12 +27,27 @@
 /** @brief Size of the key material in bytes (256 bits) */
 #define TITAN_KEY_SIZE_V01 32
 
-/** @brief Size of the MAC (HMAC-SHA256) in bytes */
+/** @brief Size of the MAC (Argon2id hash_key digest) in bytes */
 #define TITAN_KEY_MAC_SIZE_V01 32
 
 /** @brief Total blob size: version(1) + key(32) + MAC(32) = 65 bytes */
 #define TITAN_BLOB_SIZE_V01 (1 + TITAN_KEY_SIZE_V01 + TITAN_KEY_MAC_SIZE_V01)
 
+/** @brief Version identifier for Titan Key format v2, written by init_titan_key() */
+#define TITAN_KEY_VERSION_02 0x02
+
+/** @brief Size of the key material in bytes (256 bits) */
+#define TITAN_KEY_SIZE_V02 32
+
+/** @brief Size of the MAC (BLAKE2b keyed with the titan key) in bytes */
+#define TITAN_KEY_MAC_SIZE_V02 32
+
+/** @brief Domain separation string hashed after the version byte */
+#define TITAN_KEY_MAC_CONTEXT_V02 "cvault titan key v2"
+
+/** @brief Total blob size: version(1) + key(32) + MAC(32) = 65 bytes */
+#define TITAN_BLOB_SIZE_V02 (1 + TITAN_KEY_SIZE_V02 + TITAN_KEY_MAC_SIZE_V02)
+
 /**
  * @brief Return codes for Titan Key Service operations
  *
@@ -53,7 +71,8 @@ typedef enum {
     TKS_SYSCALL_ERR,
 
     /** @brief Unsupported version error. Key blob has unknown version byte.
-     *  Stored when: Loaded key file has version != TITAN_KEY_VERSION_01 */
+     *  Stored when: Loaded key file has neither TITAN_KEY_VERSION_01 nor
+     *  TITAN_KEY_VERSION_02 */
     TKS_UNSUPPORTED_VER_ERR,
 
     /** @brief Service initialization error. Environment paths setup failed.
@@ -93,9 +112,10 @@ extern stk_return_code tk_status;
 /**
  * @brief Initialize the Titan Key by generating and storing a new key
  *
- * Generates a new 256-bit random key and stores it in an encrypted blob
- * with MAC for integrity protection. The blob is written to disk with
- * restricted permissions (0600 - readable/writable by owner only).
+ * Generates a new 256-bit random key and stores it in a v2 blob
+ * with MAC for integrity protection. The blob is written to a temporary file
+ * with restricted permissions (0600 - readable/writable by owner only) and
+ * renamed over the key file.
  *
  * @return true if initialization successful, false otherwise
  *
@@ -108,15 +128,16 @@ extern stk_return_code tk_status;
  *   - TKS_UNSOPPORTED_OP: Running on unsupported platform (non-Linux)
  *
  * @note This function uses the system random number generator and requires
- *       cryptographic hashing capability via hash_key()
+ *       cryptographic hashing capability via keyed_hash()
  */
 bool init_titan_key();
 
 /**
  * @brief Load the Titan Key from storage with integrity verification
  *
- * Reads the Titan Key from the stored blob, verifies its integrity using
- * HMAC, and returns the key material if valid.
+ * Opens the key file once, applies the is_valid_titan_key() checks to the
+ * open descriptor with fstat(), then reads the blob, verifies its integrity
+ * using HMAC, and returns the key material if valid.
  *
  * @param[out] out_titan_key Pointer to buffer where key material will be written
  *                            Must be at least TITAN_KEY_SIZE_V01 bytes
@@ -126,14 +147,19 @@ bool init_titan_key();
  * @post On success: tk_status = TKS_SUCCESS, out_titan_key contains 32-byte key
  * @post On failure: tk_status set to one of:
  *   - TKS_NOTKF: Key file does not exist
- *   - TKS_SYSCALL_ERR: File open failed
+ *   - TKS_SERVICE_ERR: initialize_paths() failed
+ *   - TKS_SYSCALL_ERR: File open or fstat() failed
  *   - TKS_UTIL_ERR: HMAC computation failed during verification
- *   - TKS_TAMPERD: HMAC verification failed (data integrity compromised)
+ *   - TKS_TAMPERD: File size, type or permissions mismatch, or HMAC
+ *                  verification failed (data integrity compromised)
  *   - TKS_UNSUPPORTED_VER_ERR: Key blob has unsupported version byte
  *   - TKS_UNSOPPORTED_OP: Running on unsupported platform (non-Linux)
  *
  * @note This function performs constant-time HMAC comparison to prevent
  *       timing attacks on the MAC verification
+ * @note A v1 key costs a full hash_key() run to verify. Once verified it is
+ *       rewritten as v2 so later loads only cost a BLAKE2b; a failed rewrite
+ *       does not fail the load
  */
 bool load_titan_key(uint8_t *out_titan_key);
 
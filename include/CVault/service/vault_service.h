@@ -0,0 +1,259 @@
+#ifndef VAULT_SERVICE_H
+#define VAULT_SERVICE_H
+
+#include <CVault/service/rekey_service.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vendor/sqlite3/sqlite3.h>
+
+/**
+ * @file vault_service.h
+ * @brief Vault creation and unlocking
+ *
+ * A vault is described by a KdfDescriptor (see kdf_service.h) and a
+ * verification hash, both stored in the configs table. The key material
+ * derived from the master password is split in two halves: the key
+ * encryption key, which wraps the vault's random data key, and the
+ * verification key, whose hash_key() digest proves the password is right
+ * without storing anything about the other half. The entries are encrypted
+ * with the data key, the "master key" handed out by unlock_vault().
+ *
+ * When a vault is unlocked with a descriptor that no longer matches the
+ * calibrated parameters, or its password is changed, only the data key is
+ * wrapped again under freshly derived material, whatever the number of
+ * entries. The new descriptor and wrapped key are first recorded under
+ * VAULT_PENDING_CONFIG_KEY so an upgrade interrupted by a crash is completed
+ * or discarded by the next unlock. Vaults created before the data key use the
+ * first half of their material as data key; it gets wrapped on their next
+ * unlock.
+ *
+ * rotate_data_key() replaces the data key itself and re-encrypts every entry
+ * with rekey_entries(). The new key, wrapped under the old one, and the last
+ * entry moved so far are kept under VAULT_ROTATION_CONFIG_KEY until the new
+ * key is wrapped in place of the old, so the next unlock carries on a
+ * rotation cut short instead of leaving entries under two keys.
+ *
+ * Entries are sealed with the cipher recorded under VAULT_CIPHER_CONFIG_KEY
+ * when the vault was created, AES-256-GCM on hosts with AES instructions and
+ * ChaCha20-Poly1305 otherwise (see preferred_cipher()). Vaults created before
+ * the cipher was recorded use AES-256-GCM.
+ *
+ * Unlocking runs as a pipeline: the titan key file is read and verified and
+ * vault.db is opened and checked on their own threads while the vault
+ * records are read from config.db. Argon2 starts as soon as the titan key,
+ * which it uses as its secret, is available, and the vault.db open keeps
+ * overlapping with it.
+ *
+ * create_vault() and every unlock apply the parameters recorded by
+ * calibrate_kdf_service() with load_kdf_service() (the compiled-in defaults
+ * without a record), so new descriptors and upgrades target them. A corrupted
+ * record fails with VS_KDF_ERR.
+ *
+ * @note The configuration service must be opened before calling any of these
+ * functions.
+ */
+
+/** @brief Size of the master key returned by unlock_vault() */
+#define VAULT_MASTER_KEY_LEN 32
+
+/** @brief Key of the verification hash in the configs table */
+#define VAULT_VERIFIER_CONFIG_KEY "verification_hash"
+
+/** @brief Key of the wrapped data key in the configs table */
+#define VAULT_DATA_KEY_CONFIG_KEY "wrapped_data_key"
+
+/** @brief Key of the entry cipher id in the configs table */
+#define VAULT_CIPHER_CONFIG_KEY "entry_cipher"
+
+/** @brief Key of an in-flight descriptor upgrade in the configs table */
+#define VAULT_PENDING_CONFIG_KEY "kdf_rehash_pending"
+
+/** @brief Key of an in-flight data key rotation in the configs table */
+#define VAULT_ROTATION_CONFIG_KEY "data_key_rotation"
+
+/**
+ * @brief Return codes for Vault Service operations, stored in vs_status
+ */
+typedef enum {
+    /** @brief Operation successful */
+    VS_SUCCESS = 0,
+
+    /** @brief The titan key could not be created or loaded, see tk_status */
+    VS_TITAN_KEY_ERR,
+
+    /** @brief Key derivation failed or the descriptor is unusable, see kdf_status */
+    VS_KDF_ERR,
+
+    /** @brief Reading or writing the configs table failed */
+    VS_CONFIG_ERR,
+
+    /** @brief No vault has been created yet */
+    VS_NO_VAULT,
+
+    /** @brief create_vault() was called on an existing vault */
+    VS_VAULT_EXISTS,
+
+    /** @brief The master password does not match the verification hash */
+    VS_WRONG_PASSWORD,
+
+    /** @brief The vault was unlocked but upgrading its descriptor failed */
+    VS_REKEY_ERR,
+
+    /** @brief Random generation or hashing failed */
+    VS_UTIL_ERR,
+
+    /** @brief vault.db could not be opened or has no entries table */
+    VS_DB_ERR,
+
+    /** @brief A data key rotation could not be completed, see rk_status */
+    VS_ROTATION_ERR
+} vs_return_code;
+
+/**
+ * @brief Wall-clock time spent in each unlock stage, in milliseconds
+ *
+ * @details titan_key_ms and database_ms run concurrently with the rest, so
+ * total_ms is close to the longest chain rather than the sum.
+ */
+typedef struct {
+    double titan_key_ms; /**< key file I/O and verification */
+    double database_ms;  /**< vault.db open and schema check */
+    double kdf_ms;       /**< Argon2 on the master password */
+    double verify_ms;    /**< verification hash check */
+    double upgrade_ms;   /**< pending upgrade recovery and descriptor upgrade */
+    double total_ms;     /**< whole unlock, as seen by the caller */
+} UnlockTimings;
+
+/**
+ * @brief Status of the last Vault Service operation
+ */
+extern vs_return_code vs_status;
+
+/**
+ * @brief Choose the entry cipher of the vaults created from now on
+ *
+ * @param[in] cipher One of the CIPHER_* constants of crypto_core.h, or 0 to
+ *                   go back to preferred_cipher()
+ *
+ * @return true if the cipher is known
+ *
+ * @warning Not thread safe, meant to be called once at startup
+ */
+bool set_vault_cipher(uint8_t cipher);
+
+/**
+ * @brief Read the entry cipher of the vault
+ *
+ * @param[out] out_cipher Receives a CIPHER_* constant
+ *
+ * @return true on success, CIPHER_AES_256_GCM is returned for a vault that
+ *         does not record its cipher
+ *
+ * @post On failure vs_status is VS_CONFIG_ERR (unknown cipher id)
+ */
+bool read_vault_cipher(uint8_t *out_cipher);
+
+/**
+ * @brief Create a vault protected by a master password
+ *
+ * @details Creates the titan key if needed, derives the key material with the
+ * parameters currently in use and records the entry cipher, the descriptor and
+ * the verification hash.
+ *
+ * @param[in] password The master password, must not be NULL
+ *
+ * @return true if the vault was created
+ *
+ * @post On failure vs_status is one of VS_VAULT_EXISTS, VS_TITAN_KEY_ERR,
+ *       VS_KDF_ERR, VS_UTIL_ERR or VS_CONFIG_ERR
+ */
+bool create_vault(const char *password);
+
+/**
+ * @brief Unlock the vault and retrieve its master key
+ *
+ * @details Derives the key material with the vault's own descriptor, checks
+ * it against the verification hash and unwraps the data key. An outdated
+ * descriptor is then upgraded: the material is re-derived with fresh
+ * parameters and salt and the data key wrapped under it, the entries are not
+ * touched.
+ *
+ * @param[in] password The master password, must not be NULL
+ * @param[out] out_master_key Buffer of at least VAULT_MASTER_KEY_LEN bytes,
+ *                            receives the data key
+ *
+ * @return true if the password is right and out_master_key holds the key
+ *
+ * @post On success vs_status is VS_SUCCESS, or VS_REKEY_ERR when the upgrade
+ *       failed and the vault was left on its previous descriptor
+ * @post On failure vs_status is one of VS_NO_VAULT, VS_WRONG_PASSWORD,
+ *       VS_TITAN_KEY_ERR, VS_KDF_ERR, VS_UTIL_ERR, VS_CONFIG_ERR, VS_DB_ERR or
+ *       VS_ROTATION_ERR when an interrupted rotation still cannot complete
+ *
+ * @warning The unlock takes about twice the usual latency when an upgrade
+ * happens, the key material being derived twice
+ */
+bool unlock_vault(const char *password, uint8_t *out_master_key);
+
+/**
+ * @brief Change the master password of the vault
+ *
+ * @details Unlocks the vault with password, then wraps its data key under
+ * material derived from new_password with a fresh descriptor. The entries
+ * are not re-encrypted.
+ *
+ * @param[in] password The current master password, must not be NULL
+ * @param[in] new_password The new master password, must not be NULL
+ *
+ * @return true if the vault now opens with new_password only
+ *
+ * @post On failure vs_status is one of the unlock_vault() failures, or
+ *       VS_REKEY_ERR when the new wrapping could not be stored
+ *
+ * @note A crash during the change is settled by the next unlock, which then
+ * only succeeds with new_password once the new verification hash is stored
+ */
+bool change_master_password(const char *password, const char *new_password);
+
+/**
+ * @brief Replace the data key of the vault and re-encrypt every entry
+ *
+ * @details Unlocks the vault with password, records a random new data key and
+ * moves the entries to it with rekey_entries(), checkpointing after each
+ * page. The new key is then wrapped under freshly derived material.
+ *
+ * @param[in] password The master password, must not be NULL
+ * @param[out] out_stats Receives the progress of the re-encryption. May be
+ *                       NULL
+ *
+ * @return true if every entry is under the new key and the vault opens to it
+ *
+ * @post On failure vs_status is one of the unlock_vault() failures, or
+ *       VS_ROTATION_ERR with rk_status telling why the entries could not all
+ *       be moved. The next unlock carries the rotation on
+ */
+bool rotate_data_key(const char *password, RekeyStats *out_stats);
+
+/**
+ * @brief Unlock the vault, keep vault.db open and report stage timings
+ *
+ * @details Same as unlock_vault(), the vault.db connection opened by the
+ * pipeline is handed to the caller instead of being closed.
+ *
+ * @param[in] password The master password, must not be NULL
+ * @param[out] out_master_key Buffer of at least VAULT_MASTER_KEY_LEN bytes
+ * @param[out] out_vault_db Receives the open vault.db connection on success,
+ *                          to be closed with repo_close(). May be NULL
+ * @param[out] out_timings Receives the stage timings, filled on failure too.
+ *                         May be NULL
+ *
+ * @return true if the password is right and out_master_key holds the key
+ *
+ * @post Same vs_status values as unlock_vault(), plus VS_DB_ERR
+ */
+bool unlock_vault_session(const char *password,
+                          uint8_t *out_master_key,
+                          sqlite3 **out_vault_db,
+                          UnlockTimings *out_timings);
+
+#endif // !VAULT_SERVICE_H
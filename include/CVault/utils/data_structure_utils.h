@@ -2,6 +2,7 @@
 #define DATA_STRUCTURE_UTILS_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct DLinkedListNode DLinkedListNode;
@@ -83,7 +84,245 @@ bool dlinked_list_is_created(DLinkedList *wrapper);
  */
 void dlinked_list_destroy(DLinkedList *wrapper,void (*destroy_data)(void*));
 
-// TODO: add hash map logic
-// TODO: add Prefix Tree logic later
+/*
+ * Open addressing hash map with Robin Hood probing.
+ *
+ * Slots are kept in one flat array of 24 bytes each (32 bits of the hash,
+ * the probe distance, the key and the value pointers), so a lookup reads
+ * consecutive slots and compares hashes before calling the equal function.
+ * An insert takes the slot of any entry closer to its home than itself,
+ * which keeps probe sequences short up to HASH_MAP_MAX_LOAD, and a removal
+ * shifts the following entries back instead of leaving tombstones.
+ *
+ * Growing is incremental: when the load is reached a table twice as large
+ * is allocated and every later put or remove moves HASH_MAP_MIGRATE_STEP
+ * slots of the old table into it, so no single call rehashes the whole map.
+ * Lookups check the new table then what is left of the old one.
+ *
+ * The map stores pointers only, keys and values belong to the caller and
+ * keys must not be NULL.
+ */
+
+/** @brief: slots allocated by hash_map_create() for a capacity of 0 */
+#define HASH_MAP_MIN_SLOTS 16
+
+/** @brief: fill ratio, in eighths, that starts a resize */
+#define HASH_MAP_MAX_LOAD 7
+
+/** @brief: old slots migrated by each put or remove during a resize */
+#define HASH_MAP_MIGRATE_STEP 32
+
+typedef struct HashMap HashMap;
+
+/** @brief: hashes a key, equal keys must hash the same */
+typedef uint64_t (*HashMapHashFn)(const void *key);
+
+/** @brief: tells whether two keys are the same */
+typedef bool (*HashMapEqualFn)(const void *key1, const void *key2);
+
+/** @brief: releases (and wipes) an entry when the map is destroyed */
+typedef void (*HashMapDestroyFn)(void *key, void *value);
+
+/**
+ * @brief: Creates an empty hash map
+ *
+ * @param: hash The hash function of the keys
+ * @param: equal The equality of the keys
+ * @param: capacity Entries expected, slots are allocated so that they fit
+ * without a resize. 0 for HASH_MAP_MIN_SLOTS slots
+ *
+ * @return: A pointer to a newly allocated HashMap, or NULL on failure
+ *
+ * @note: The returned map must be freed using hash_map_destroy()
+ */
+HashMap *hash_map_create(HashMapHashFn hash, HashMapEqualFn equal, uint64_t capacity);
+
+/**
+ * @brief: Inserts a key or replaces the key and value stored for it
+ *
+ * @param: map The hash map
+ * @param: key The key, not NULL
+ * @param: value The value
+ * @param: out_previous Receives the value replaced, NULL for a new key. May be
+ * NULL
+ *
+ * @return: The map pointer on success, NULL on failure (the map is unchanged)
+ */
+HashMap *hash_map_put(HashMap *map, void *key, void *value, void **out_previous);
+
+/**
+ * @brief: Looks a key up
+ *
+ * @param: map The hash map
+ * @param: key The key to look for
+ *
+ * @return: The value stored for key, NULL if there is none
+ */
+void *hash_map_get(const HashMap *map, const void *key);
+
+/**
+ * @brief: Tells whether a key is stored, whatever its value
+ *
+ * @param: map The hash map
+ * @param: key The key to look for
+ *
+ * @return: true if the key is in the map
+ */
+bool hash_map_contains(const HashMap *map, const void *key);
+
+/**
+ * @brief: Removes a key
+ *
+ * @param: map The hash map
+ * @param: key The key to remove
+ * @param: out_value Receives the value it had, may be NULL
+ *
+ * @return: true if the key was in the map
+ */
+bool hash_map_remove(HashMap *map, const void *key, void **out_value);
+
+/**
+ * @brief: Returns the number of entries of the map
+ *
+ * @param: map The hash map
+ *
+ * @return: The entry count, 0 for a NULL map
+ */
+uint64_t hash_map_size(const HashMap *map);
+
+/**
+ * @brief: Walks the entries of the map in no particular order
+ *
+ * @param: map The hash map
+ * @param: iterator Position of the walk, set to 0 before the first call
+ * @param: out_key Receives the key of the next entry, may be NULL
+ * @param: out_value Receives its value, may be NULL
+ *
+ * @return: true while an entry was returned, false once they were all seen
+ *
+ * @note: the map must not be changed during the walk
+ */
+bool hash_map_next(const HashMap *map, uint64_t *iterator, void **out_key, void **out_value);
+
+/**
+ * @brief: Destroys the hash map and wipes its slots
+ *
+ * @param: map The hash map, NULL is ignored
+ * @param: destroy_entry Called for each entry before the slots are wiped, to
+ * wipe and free the key and value, or NULL if no cleanup needed
+ */
+void hash_map_destroy(HashMap *map, HashMapDestroyFn destroy_entry);
+
+/**
+ * @brief: Hashes a byte string, FNV-1a with a final avalanche
+ *
+ * @param: data The bytes
+ * @param: length Their number
+ *
+ * @return: The 64 bit hash
+ */
+uint64_t hash_map_hash_bytes(const void *data, size_t length);
+
+/**
+ * @brief: HashMapHashFn of NUL terminated strings
+ */
+uint64_t hash_map_hash_string(const void *key);
+
+/**
+ * @brief: HashMapEqualFn of NUL terminated strings
+ */
+bool hash_map_string_equal(const void *key1, const void *key2);
+
+/*
+ * Compressed prefix tree (radix trie) of NUL terminated words.
+ *
+ * Every edge holds a whole run of characters, a node only exists where two
+ * words part or where a word ends, so a lookup costs the length of the
+ * prefix whatever the number of words. Children are kept sorted by their
+ * first byte: a prefix walk binary searches each level and enumerates the
+ * words below it in byte order.
+ *
+ * A word may carry several values (two entries of the same service), values
+ * are pointers owned by the caller. Labels are wiped when a node is merged
+ * or freed, the tree is meant to index decrypted names.
+ */
+
+typedef struct PrefixTree PrefixTree;
+
+/**
+ * @brief: receives the words found by prefix_tree_find_prefix
+ *
+ * @param: word The whole word, valid during the call only
+ * @param: value One value stored for it
+ * @param: arg The arg given to prefix_tree_find_prefix
+ *
+ * @return: false to stop the enumeration
+ */
+typedef bool (*PrefixTreeVisitFn)(const char *word, void *value, void *arg);
+
+/**
+ * @brief: Creates an empty prefix tree
+ *
+ * @return: A pointer to a newly allocated PrefixTree, or NULL on failure
+ *
+ * @note: The returned tree must be freed using prefix_tree_destroy()
+ */
+PrefixTree *prefix_tree_create(void);
+
+/**
+ * @brief: Adds a value under a word
+ *
+ * @param: tree The prefix tree
+ * @param: word The word, "" is a valid word
+ * @param: value The value, the same word may hold several
+ *
+ * @return: The tree pointer on success, NULL on failure (no value is added)
+ */
+PrefixTree *prefix_tree_insert(PrefixTree *tree, const char *word, void *value);
+
+/**
+ * @brief: Removes one value from a word, the word goes once it holds none
+ *
+ * @param: tree The prefix tree
+ * @param: word The word
+ * @param: value The value to remove, compared by pointer
+ *
+ * @return: true if the value was stored under word
+ */
+bool prefix_tree_remove(PrefixTree *tree, const char *word, const void *value);
+
+/**
+ * @brief: Enumerates the words starting with a prefix, in byte order
+ *
+ * @param: tree The prefix tree
+ * @param: prefix The prefix, "" for every word
+ * @param: visit Called once per value of each matching word, may be NULL to
+ * count them only
+ * @param: arg Passed to visit
+ *
+ * @return: The number of values visited, the one visit stopped on included
+ */
+uint64_t prefix_tree_find_prefix(const PrefixTree *tree,
+                                 const char *prefix,
+                                 PrefixTreeVisitFn visit,
+                                 void *arg);
+
+/**
+ * @brief: Returns the number of values stored in the tree
+ *
+ * @param: tree The prefix tree
+ *
+ * @return: The value count, 0 for a NULL tree
+ */
+uint64_t prefix_tree_size(const PrefixTree *tree);
+
+/**
+ * @brief: Destroys the prefix tree, wiping its labels
+ *
+ * @param: tree The prefix tree, NULL is ignored
+ * @param: destroy_value Called for each value stored, or NULL if no cleanup
+ * needed
+ */
+void prefix_tree_destroy(PrefixTree *tree, void (*destroy_value)(void *));
 
 #endif
@@ -0,0 +1,129 @@
+#ifndef SECRET_ARENA_H
+#define SECRET_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bump allocator for decrypted secrets.
+ *
+ * An arena is a chain of regions, each its own anonymous mapping framed by
+ * two PROT_NONE guard pages, locked in RAM with mlock() and left out of core
+ * dumps with MADV_DONTDUMP. Allocations are carved from the newest region and
+ * never freed one by one: secret_arena_reset() wipes every byte handed out
+ * and keeps the oldest region for reuse, secret_arena_destroy() wipes and
+ * unmaps everything. Both cost one pass per region whatever the number of
+ * allocations.
+ *
+ * Allocation is guarded by a mutex, an arena can be filled from several
+ * threads at once.
+ */
+
+/** @brief: usable bytes of a region when the arena is created with 0 */
+#define SECRET_ARENA_REGION_SIZE (64 * 1024)
+
+/** @brief: alignment of every block returned by secret_arena_alloc */
+#define SECRET_ARENA_ALIGN 16
+
+typedef struct SecretArena SecretArena;
+
+/**
+ * @brief: Position of an arena, to roll back the allocations made after it
+ */
+typedef struct {
+    void *region; /* newest region when the mark was taken, NULL for none */
+    size_t used;  /* bytes handed out from it */
+} SecretArenaMark;
+
+/**
+ * @brief: Occupancy of an arena
+ */
+typedef struct {
+    uint32_t regions;      /* regions currently mapped */
+    uint64_t capacity;     /* usable bytes of those regions */
+    uint64_t used;         /* bytes handed out, alignment included */
+    uint64_t locked;       /* usable bytes mlock() accepted, the rest may be swapped */
+    uint64_t allocations;  /* blocks handed out since creation or the last reset */
+} SecretArenaStats;
+
+/**
+ * @brief: Creates an empty arena, regions are mapped on the first allocations
+ *
+ * @param: region_size Usable bytes of a region, rounded up to whole pages. 0
+ * for SECRET_ARENA_REGION_SIZE
+ *
+ * @return: The arena, NULL on allocation failure or on platforms without mmap
+ *
+ * @note: must be released with secret_arena_destroy()
+ */
+SecretArena *secret_arena_create(size_t region_size);
+
+/**
+ * @brief: Hands out a zeroed block of size bytes
+ *
+ * @param: arena The arena
+ * @param: size The block size, a block larger than a region gets a region
+ * of its own
+ *
+ * @return: A SECRET_ARENA_ALIGN aligned block, NULL on NULL arena, 0 size or
+ * mapping failure
+ */
+void *secret_arena_alloc(SecretArena *arena, size_t size);
+
+/**
+ * @brief: Copies len bytes into the arena as a NUL terminated string
+ *
+ * @param: arena The arena
+ * @param: data The bytes to copy, may hold NULs
+ * @param: len Their number
+ *
+ * @return: The copy, NULL on failure
+ */
+char *secret_arena_strndup(SecretArena *arena, const void *data, size_t len);
+
+/**
+ * @brief: Takes a mark to roll back to with secret_arena_rewind
+ *
+ * @param: arena The arena
+ *
+ * @return: The current position of the arena
+ */
+SecretArenaMark secret_arena_mark(SecretArena *arena);
+
+/**
+ * @brief: Wipes the allocations made after mark and gives their space back
+ *
+ * @param: arena The arena
+ * @param: mark A mark taken on this arena since its last reset
+ *
+ * @note: the regions mapped after the mark are unmapped, blocks handed out
+ * after it must not be used any more. No allocation may run concurrently
+ */
+void secret_arena_rewind(SecretArena *arena, SecretArenaMark mark);
+
+/**
+ * @brief: Wipes every block and keeps the oldest region for reuse
+ *
+ * @param: arena The arena, NULL is ignored
+ *
+ * @note: every block handed out so far becomes invalid
+ */
+void secret_arena_reset(SecretArena *arena);
+
+/**
+ * @brief: Wipes every block, unmaps the regions and frees the arena
+ *
+ * @param: arena The arena, NULL is ignored
+ */
+void secret_arena_destroy(SecretArena *arena);
+
+/**
+ * @brief: Reads the occupancy of an arena
+ *
+ * @param: arena The arena
+ * @param: out_stats Receives the counters, zeroed for a NULL arena
+ */
+void secret_arena_stats(SecretArena *arena, SecretArenaStats *out_stats);
+
+#endif // !SECRET_ARENA_H
@@ -6,9 +6,16 @@
 #include <stdint.h>
 
 #define UUID_STR_LEN 36
+#define UUID_BIN_LEN 16
 #define TIMEOUT 15
 #define MAX_LEN 200
 
+/** @brief: bytes folded per iteration by constant_time_equal */
+#define CT_COMPARE_BLOCK 64
+
+/** @brief: per-thread buffer size of the random source, larger requests bypass it */
+#define RANDOM_POOL_SIZE 4096
+
 /**
  * @brief: Enumeration for return codes
  */
@@ -36,15 +43,38 @@ typedef enum {
     CHARSET_DIGITS
 } charset_flag;
 
+/** @brief: character classes of a password_policy, to be OR'ed together */
+#define PASSWORD_CLASS_LOWER  0x01u /* a-z */
+#define PASSWORD_CLASS_UPPER  0x02u /* A-Z */
+#define PASSWORD_CLASS_DIGIT  0x04u /* 0-9 */
+#define PASSWORD_CLASS_SYMBOL 0x08u /* !@#$%^&*()-_=+ */
+#define PASSWORD_CLASS_ALL    0x0Fu
+
+/** @brief: longest password generate_passwords accepts */
+#define PASSWORD_MAX_LEN 4096
+
+/**
+ * @brief: Composition rules of the passwords built by generate_passwords
+ */
+typedef struct {
+    uint64_t length;   /* characters per password, without the NUL */
+    uint32_t classes;  /* PASSWORD_CLASS_* the characters are drawn from */
+    uint32_t required; /* PASSWORD_CLASS_* appearing at least once, within classes */
+} password_policy;
+
 /**
  * @brief: Securely wipes memory by bypassing compiler optimizations.
  *
  * @param: ptr The memory block to clear.
- * @param: width The number of bytes to clear.
+ * @param: width The number of bytes to clear, any size the address space holds.
  *
  * @return: SUCCESS on success,
  * NULL_POINTER on passing null to ptr,
- * INVALID_SIZE on passing an invalid width (too big or negative).
+ * INVALID_SIZE on passing an invalid width (0 or above SIZE_MAX).
+ *
+ * @note: the block is cleared by the libc memset (word or vector stores)
+ * followed by a compiler barrier that claims to read it, so the stores are
+ * never dropped as dead
  */
 util_result_code secure_memset(void *ptr, uint64_t width);
 
@@ -63,6 +93,25 @@ util_result_code secure_memset(void *ptr, uint64_t width);
  */
 util_result_code generate_uuid(char *out_buffer);
 
+/**
+ * @brief: Formats 16 UUID bytes as a lowercase 8-4-4-4-12 string
+ *
+ * @param: bytes The UUID_BIN_LEN bytes to format
+ * @param: out_buffer Buffer of at least UUID_STR_LEN + 1 bytes, NUL terminated
+ */
+void uuid_to_string(const uint8_t *bytes, char *out_buffer);
+
+/**
+ * @brief: Parses an 8-4-4-4-12 UUID string into its 16 bytes
+ *
+ * @param: uuid The string to parse, hex digits in either case
+ * @param: out_bytes Buffer of at least UUID_BIN_LEN bytes
+ *
+ * @return: true if uuid is a well formed UUID string, false otherwise (or on
+ * NULL)
+ */
+bool uuid_from_string(const char *uuid, uint8_t *out_bytes);
+
 /**
  * @brief: Generates a random password
  *
@@ -78,6 +127,35 @@ util_result_code generate_uuid(char *out_buffer);
  * the implemented system calls
  */
 util_result_code generate_password(uint64_t length, char *out_buffer, charset_flag flag);
+
+/**
+ * @brief: Generates count passwords following a composition policy
+ *
+ * @param: policy The length and character classes of every password
+ * @param: count The number of passwords to generate
+ * @param: out_buffer Buffer of count * stride bytes, password i starts at
+ * out_buffer + i * stride and is NUL terminated
+ * @param: stride The distance between two passwords, at least length + 1
+ *
+ * @return: SUCCESS on success,
+ * NULL_POINTER on passing NULL to policy or out_buffer,
+ * INVALID_SIZE on a length of 0 or above PASSWORD_MAX_LEN, a stride too
+ * small, no class, required classes outside of classes or more required
+ * classes than characters,
+ * SYSCALL_ERR if a system call failed (out_buffer is wiped),
+ * NOT_SUPPORTED if the current environment doesn't support
+ * the implemented system calls
+ *
+ * @note: every password draws one character of each required class, fills
+ * the rest from all of its classes and is shuffled, so policies hold without
+ * regenerating. Characters are unbiased: random bytes are mapped through a
+ * 256 entry table where the bytes above the largest multiple of the charset
+ * size are rejected without branching, one byte at a time (no SIMD)
+ */
+util_result_code generate_passwords(const password_policy *policy,
+                                    uint64_t count,
+                                    char *out_buffer,
+                                    size_t stride);
 /**
  * @brief: Copies a string to the Wayland clipboard and schedules an auto-clear.
  *
@@ -96,8 +174,38 @@ util_result_code generate_password(uint64_t length, char *out_buffer, charset_fl
  */
 util_result_code copy_string_to_clipboard(char *string);
 
+/**
+ * @brief: Fills a buffer with cryptographically secure random bytes
+ *
+ * @param: size The number of bytes to generate
+ * @param: out_buffer Buffer to store the result
+ *
+ * @return: SUCCESS on success,
+ * NULL_POINTER on passing NULL to out_buffer,
+ * SYSCALL_ERR if a system call failed,
+ * NOT_SUPPORTED if the current environment doesn't support
+ * the implemented system calls
+ *
+ * @note: small requests are served from a per-thread buffer refilled with
+ * RANDOM_POOL_SIZE bytes of getrandom() at a time, bytes are wiped from it
+ * as they are handed out and a forked child never reuses its parent's buffer.
+ * generate_uuid and generate_password draw from the same source
+ */
 util_result_code random_raw_bytes(uint64_t size, uint8_t *out_buffer);
 
+/**
+ * @brief: Compares two buffers in a time that depends on length only
+ *
+ * @param: data1 The first buffer
+ * @param: data2 The second buffer
+ * @param: length The number of bytes to compare
+ *
+ * @return: true if the buffers hold the same bytes
+ *
+ * @note: the differences are OR'ed together CT_COMPARE_BLOCK bytes at a time
+ * in vector registers (64 bit words without GCC vector extensions), with no
+ * branch on the data and no early exit
+ */
 bool constant_time_equal(const uint8_t *data1, const uint8_t *data2, size_t length);
 
 #endif
@@ -1,9 +1,143 @@
 #include <CVault/crypto/crypto_core.h>
+#include <limits.h>
+#include <openssl/crypto.h>
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <vendor/argon2/argon2.h>
+#include <vendor/argon2/blake2/blake2.h>
+
+#if defined(__linux__) && defined(__aarch64__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+#if defined(__linux__)
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* alignment of the Argon2 matrix, lets the kernel back it with 2 MiB pages */
+#define ARGON_MEM_ALIGN ((size_t)2 * 1024 * 1024)
+
+static size_t argon_mem_length(size_t size) {
+    return (size + ARGON_MEM_ALIGN - 1) & ~(ARGON_MEM_ALIGN - 1);
+}
+
+/*
+ * Maps the Argon2 memory matrix outside of the malloc heap: explicit huge pages
+ * when the host reserved some, otherwise a 2 MiB aligned anonymous mapping
+ * advised for transparent huge pages. The matrix is kept out of core dumps and
+ * locked (which also prefaults it) when RLIMIT_MEMLOCK allows it.
+ */
+static int argon_memory_alloc(uint8_t **memory, size_t size) {
+    size_t length = argon_mem_length(size);
+    void *region = MAP_FAILED;
+
+    *memory = NULL;
+
+#if defined(MAP_HUGETLB)
+    int huge_flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE;
+#if defined(MAP_HUGE_SHIFT)
+    huge_flags |= 21 << MAP_HUGE_SHIFT; /* MAP_HUGE_2MB, only in <linux/mman.h> */
+#endif
+    region = mmap(NULL, length, PROT_READ | PROT_WRITE, huge_flags, -1, 0);
+#endif
+
+    if (region == MAP_FAILED) {
+        /* over-map by one huge page and trim both ends to get the alignment */
+        uint8_t *raw = mmap(NULL, length + ARGON_MEM_ALIGN, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            return ARGON2_MEMORY_ALLOCATION_ERROR;
+        }
+
+        uint8_t *aligned = (uint8_t *)(((uintptr_t)raw + ARGON_MEM_ALIGN - 1) &
+                                       ~(uintptr_t)(ARGON_MEM_ALIGN - 1));
+        size_t head = (size_t)(aligned - raw);
+
+        if (head > 0) {
+            munmap(raw, head);
+        }
+        if (ARGON_MEM_ALIGN - head > 0) {
+            munmap(aligned + length, ARGON_MEM_ALIGN - head);
+        }
+        region = aligned;
+
+#if defined(MADV_HUGEPAGE)
+        madvise(region, length, MADV_HUGEPAGE);
+#endif
+    }
+
+#if defined(MADV_DONTDUMP)
+    madvise(region, length, MADV_DONTDUMP);
+#endif
+
+    if (mlock(region, length) != 0) {
+        /* not allowed to lock that much, still prefault to keep faults out of the fill */
+#if defined(MADV_POPULATE_WRITE)
+        madvise(region, length, MADV_POPULATE_WRITE);
+#endif
+    }
+
+    *memory = region;
+    return ARGON2_OK;
+}
+
+/*
+ * The anonymous pages go straight back to the kernel, which zeroes them before
+ * reusing them, so argon2 is told not to wipe the matrix first
+ * (ARGON2_FLAG_FREE_CBK_WIPES). munmap also drops the lock.
+ */
+static void argon_memory_free(uint8_t *memory, size_t size) {
+    if (memory) {
+        munmap(memory, argon_mem_length(size));
+    }
+}
+
+#define ARGON_ALLOCATE_CBK argon_memory_alloc
+#define ARGON_FREE_CBK     argon_memory_free
+#define ARGON_MEM_FLAGS    ARGON2_FLAG_FREE_CBK_WIPES
+#else
+#define ARGON_ALLOCATE_CBK NULL
+#define ARGON_FREE_CBK     NULL
+#define ARGON_MEM_FLAGS    ARGON2_DEFAULT_FLAGS
+#endif
+
+/* parameters used by derive_key_material, see set_kdf_params */
+static KdfParams active_kdf_params = {
+    .t_cost = ARGON_T_COST, .m_cost = ARGON_M_COST, .p_cost = ARGON_P_COST};
+
+/*
+ * version is left unset on purpose: existing vaults were derived that way and
+ * it is part of the argon2 initial hash
+ */
+static bool run_argon2id(const uint8_t *pwd, uint32_t pwd_len, const uint8_t *salt,
+                         const uint8_t *secret, uint32_t secret_len, const KdfParams *params,
+                         uint8_t *out, uint32_t out_len) {
+    argon2_context ctx = {.out = out,
+                          .outlen = out_len,
+                          .pwd = (uint8_t *)pwd,
+                          .pwdlen = pwd_len,
+                          .salt = (uint8_t *)salt,
+                          .saltlen = SALT_LEN,
+                          .secret = (uint8_t *)secret,
+                          .secretlen = secret_len,
+                          .ad = NULL,
+                          .adlen = 0,
+                          .t_cost = params->t_cost,
+                          .m_cost = params->m_cost,
+                          .lanes = params->p_cost,
+                          .threads = params->p_cost,
+                          .allocate_cbk = ARGON_ALLOCATE_CBK,
+                          .free_cbk = ARGON_FREE_CBK,
+                          .flags = ARGON_MEM_FLAGS};
+
+    return argon2id_ctx(&ctx) == ARGON2_OK;
+}
 
 bool derive_key_material(const char *password,const uint8_t *titan_key,
                          const uint8_t *salt,uint8_t *out_key){
@@ -12,112 +146,389 @@ bool derive_key_material(const char *password,const uint8_t *titan_key,
         return false;
     }
 
-    uint32_t pwd_len = (uint32_t)strlen(password);
-    uint32_t titan_len = TITAN_KEY_LEN;
+    return run_argon2id((const uint8_t *)password, (uint32_t)strlen(password), salt, titan_key,
+                        TITAN_KEY_LEN, &active_kdf_params, out_key, MAT_KEY_LEN);
+}
+
+bool derive_key_material_kdf(const char *password, const uint8_t *titan_key,
+                             const KdfDescriptor *kdf, uint8_t *out_key) {
+    if (!password || !titan_key || !out_key || !is_valid_kdf_descriptor(kdf)) {
+        return false;
+    }
+
+    return run_argon2id((const uint8_t *)password, (uint32_t)strlen(password), kdf->salt,
+                        titan_key, TITAN_KEY_LEN, &kdf->params, out_key, kdf->out_len);
+}
+
+bool is_valid_kdf_descriptor(const KdfDescriptor *kdf) {
+    if (!kdf) {
+        return false;
+    }
+
+    if (kdf->algorithm != KDF_ALG_ARGON2ID || kdf->out_len != MAT_KEY_LEN) {
+        return false;
+    }
+
+    return is_valid_kdf_params(&kdf->params);
+}
+
+bool is_valid_kdf_params(const KdfParams *params) {
+    if (!params) {
+        return false;
+    }
+
+    if (params->t_cost < KDF_MIN_T_COST || params->t_cost > KDF_MAX_T_COST) {
+        return false;
+    }
 
+    if (params->m_cost < KDF_MIN_M_COST || params->m_cost > KDF_MAX_M_COST) {
+        return false;
+    }
+
+    if (params->p_cost < 1 || params->p_cost > KDF_MAX_P_COST) {
+        return false;
+    }
+
+    return true;
+}
+
+bool set_kdf_params(const KdfParams *params) {
+    if (!is_valid_kdf_params(params)) {
+        return false;
+    }
+
+    active_kdf_params = *params;
+    return true;
+}
+
+void get_kdf_params(KdfParams *out_params) {
+    if (out_params) {
+        *out_params = active_kdf_params;
+    }
+}
+
+static double time_kdf_ms(const KdfParams *params) {
+    const char *pwd = "cvault-calibration";
+    uint8_t salt[SALT_LEN] = {0};
+    uint8_t secret[TITAN_KEY_LEN] = {0};
+    uint8_t out[MAT_KEY_LEN];
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!run_argon2id((const uint8_t *)pwd, (uint32_t)strlen(pwd), salt, secret, TITAN_KEY_LEN,
+                      params, out, MAT_KEY_LEN)) {
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+/* m_cost is kept a multiple of 1 MiB so stored parameters stay readable */
+static uint32_t round_m_cost(uint64_t m_cost) {
+    m_cost -= m_cost % 1024;
+    if (m_cost < KDF_MIN_M_COST) {
+        return KDF_MIN_M_COST;
+    }
+    if (m_cost > KDF_MAX_M_COST) {
+        return KDF_MAX_M_COST;
+    }
+    return (uint32_t)m_cost;
+}
+
+bool calibrate_kdf(uint32_t target_ms, uint64_t mem_budget_kib, KdfParams *out_params) {
+    if (!target_ms || !out_params) {
+        return false;
+    }
+
+    KdfParams params = {.t_cost = KDF_MIN_T_COST, .m_cost = KDF_MIN_M_COST, .p_cost = 1};
+
+#if defined(__linux__)
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 1) {
+        params.p_cost = (cpus > KDF_MAX_P_COST) ? KDF_MAX_P_COST : (uint32_t)cpus;
+    }
+
+    if (!mem_budget_kib) {
+        /* leave half of the memory that is free right now to the rest of the host */
+        long pages = sysconf(_SC_AVPHYS_PAGES);
+        long page_size = sysconf(_SC_PAGESIZE);
+        if (pages > 0 && page_size > 0) {
+            mem_budget_kib = (uint64_t)pages * (uint64_t)page_size / 1024 / 2;
+        }
+    }
+#endif
+
+    if (!mem_budget_kib) {
+        mem_budget_kib = ARGON_M_COST;
+    }
+    uint32_t budget = round_m_cost(mem_budget_kib);
+
+    /* one pass over the smallest matrix gives the cost of a KiB on this host */
+    double probe_ms = time_kdf_ms(&params);
+    if (probe_ms < 0) {
+        return false;
+    }
+    if (probe_ms < 1) {
+        probe_ms = 1;
+    }
+
+    /* prefer memory over passes, only add passes once the budget is spent */
+    double ms_per_kib = probe_ms / KDF_MIN_M_COST;
+    params.m_cost = round_m_cost((uint64_t)(target_ms / ms_per_kib));
+    if (params.m_cost > budget) {
+        params.m_cost = budget;
+    }
+
+    if (params.m_cost == budget) {
+        double pass_ms = ms_per_kib * params.m_cost;
+        uint64_t passes = (uint64_t)(target_ms / pass_ms);
+        if (passes > KDF_MAX_T_COST) {
+            passes = KDF_MAX_T_COST;
+        }
+        params.t_cost = (passes < KDF_MIN_T_COST) ? KDF_MIN_T_COST : (uint32_t)passes;
+    }
+
+    /* the estimate is linear, check it and shrink until the target is met */
+    for (;;) {
+        double ms = time_kdf_ms(&params);
+        if (ms < 0) {
+            return false;
+        }
+
+        if (ms <= target_ms * 1.1) {
+            break;
+        }
+
+        if (params.t_cost > KDF_MIN_T_COST) {
+            params.t_cost--;
+        } else if (params.m_cost > KDF_MIN_M_COST) {
+            params.m_cost = round_m_cost((uint64_t)(params.m_cost * (target_ms / ms)));
+        } else {
+            break;
+        }
+    }
+
+    *out_params = params;
+    return true;
+}
+
+bool hash_key(const uint8_t *key, const uint8_t *salt, 
+			  uint8_t *out_key){
+
+    if (!key || !salt || !out_key) {
+        return false;
+    }
+    /* same parameters as argon2id_hash_raw, only the allocator differs */
     argon2_context ctx = {.out = out_key,
-                          .outlen = MAT_KEY_LEN,
-                          .pwd = (uint8_t *)password,
-                          .pwdlen = pwd_len,
+                          .outlen = 32,
+                          .pwd = (uint8_t *)key,
+                          .pwdlen = VER_KEY_LEN,
                           .salt = (uint8_t *)salt,
                           .saltlen = SALT_LEN,
-                          .secret = (uint8_t *)titan_key,
-                          .secretlen = titan_len,
+                          .secret = NULL,
+                          .secretlen = 0,
                           .ad = NULL,
                           .adlen = 0,
                           .t_cost = ARGON_T_COST,
                           .m_cost = ARGON_M_COST,
                           .lanes = ARGON_P_COST,
                           .threads = ARGON_P_COST,
-                          .allocate_cbk = NULL,
-                          .free_cbk = NULL,
-                          .flags = ARGON2_DEFAULT_FLAGS};
+                          .allocate_cbk = ARGON_ALLOCATE_CBK,
+                          .free_cbk = ARGON_FREE_CBK,
+                          .flags = ARGON_MEM_FLAGS,
+                          .version = ARGON2_VERSION_13};
 
     int result = argon2id_ctx(&ctx);
 
-    return (result == ARGON2_OK);
+	return (result == ARGON2_OK);
 }
 
-bool hash_key(const uint8_t *key, const uint8_t *salt, 
-			  uint8_t *out_key){
+bool keyed_hash(const uint8_t *key, size_t key_len, const uint8_t *data, size_t data_len,
+                uint8_t *out_hash, size_t out_len) {
+    if (!key || !out_hash || (!data && data_len)) {
+        return false;
+    }
 
-    if (!key || !salt || !out_key) {
+    if (!key_len || key_len > KEYED_HASH_MAX_KEY_LEN || !out_len ||
+        out_len > KEYED_HASH_MAX_LEN) {
         return false;
     }
-	uint32_t out_len = 32;
 
-	int result = argon2id_hash_raw(ARGON_T_COST,
-								   ARGON_M_COST,
-								   ARGON_P_COST,
-								   key,
-								   VER_KEY_LEN,
-								   salt,
-								   SALT_LEN,
-								   out_key,
-								   out_len);
+    return blake2b(out_hash, out_len, data, data_len, key, key_len) == 0;
+}
 
-	return (result == ARGON2_OK);
+/* one context per cipher id, index cipher - 1 */
+#define CIPHER_COUNT 2
+
+#define AEAD_KEY_LEN 32
+
+/* cipher contexts are keyed on first use, most handles only ever seal or open one cipher */
+struct AeadContext {
+    uint8_t cipher;
+    uint8_t key[AEAD_KEY_LEN];
+    EVP_CIPHER_CTX *seal[CIPHER_COUNT];
+    EVP_CIPHER_CTX *open[CIPHER_COUNT];
+};
+
+/* IVs drawn per RAND_bytes call by aead_encrypt_batch */
+#define AEAD_BATCH_IVS 32
+
+static const EVP_CIPHER *cipher_of(uint8_t cipher) {
+    switch (cipher) {
+        case CIPHER_AES_256_GCM:
+            return EVP_aes_256_gcm();
+        case CIPHER_CHACHA20_POLY1305:
+            return EVP_chacha20_poly1305();
+        default:
+            return NULL;
+    }
 }
 
-bool encrypt_blob(const uint8_t *key,const uint8_t *plaintext,
-				  size_t plaintext_len,uint8_t *out_blob){
+/* expands the key once, each blob then only sets its IV */
+static EVP_CIPHER_CTX *cipher_context_new(const uint8_t *key, uint8_t cipher, int enc) {
+    const EVP_CIPHER *evp = cipher_of(cipher);
+    if (!evp) {
+        return NULL;
+    }
 
-    if (!key || !plaintext || !out_blob) {
-        return false;
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) {
+        return NULL;
+    }
+
+    if (EVP_CipherInit_ex(ctx, evp, NULL, key, NULL, enc) != 1) {
+        EVP_CIPHER_CTX_free(ctx);
+        return NULL;
     }
+    return ctx;
+}
+
+/* the seal (enc 1) or open context of a valid cipher, NULL on failure */
+static EVP_CIPHER_CTX *context_of(AeadContext *aead, uint8_t cipher, int enc) {
+    EVP_CIPHER_CTX **slot = enc ? &aead->seal[cipher - 1] : &aead->open[cipher - 1];
+
+    if (!*slot) {
+        *slot = cipher_context_new(aead->key, cipher, enc);
+    }
+    return *slot;
+}
 
-    EVP_CIPHER_CTX *ctx = NULL;
+/*
+ * out_blob already starts with its IV, ad may be NULL when ad_len is 0. A
+ * tagged blob's header is authenticated before ad so the cipher id cannot be
+ * swapped.
+ */
+static bool aead_seal(EVP_CIPHER_CTX *ctx, const uint8_t *header, const uint8_t *ad,
+                      size_t ad_len, const uint8_t *plaintext, size_t plaintext_len,
+                      uint8_t *out_blob) {
+    uint8_t *ciphertext = out_blob + IV_LEN;
     int len = 0;
     int ciphertext_len = 0;
 
-    uint8_t *iv = out_blob;
+    if (plaintext_len > INT_MAX || ad_len > INT_MAX) {
+        return false;
+    }
 
-    if (RAND_bytes(iv, IV_LEN) != 1){
+    if (EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, out_blob) != 1) {
         return false;
-	}
+    }
 
-    ctx = EVP_CIPHER_CTX_new();
-    if (!ctx){
+    if (header && EVP_EncryptUpdate(ctx, NULL, &len, header, CIPHER_HEADER_LEN) != 1) {
         return false;
-	}
+    }
 
-    if (EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) != 1){
-		EVP_CIPHER_CTX_free(ctx);
-		return false;
-	}
+    if (ad_len && EVP_EncryptUpdate(ctx, NULL, &len, ad, (int)ad_len) != 1) {
+        return false;
+    }
 
-    if (EVP_EncryptInit_ex(ctx, NULL, NULL, key, iv) != 1){
-		EVP_CIPHER_CTX_free(ctx);
-		return false;
-	}
+    if (EVP_EncryptUpdate(ctx, ciphertext, &len, plaintext, (int)plaintext_len) != 1) {
+        return false;
+    }
+    ciphertext_len = len;
 
-    uint8_t *ciphertext = out_blob + IV_LEN;
+    if (EVP_EncryptFinal_ex(ctx, ciphertext + len, &len) != 1) {
+        return false;
+    }
+    ciphertext_len += len;
 
-    if (EVP_EncryptUpdate(ctx,ciphertext,&len,
-						  plaintext,(int)plaintext_len) != 1){
-		EVP_CIPHER_CTX_free(ctx);
-		return false;
-	}
+    return EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, TAG_LEN,
+                               ciphertext + ciphertext_len) == 1;
+}
 
-    ciphertext_len = len;
+/* wipes out_plaintext when the blob does not authenticate */
+static bool aead_open(EVP_CIPHER_CTX *ctx, const uint8_t *header, const uint8_t *ad,
+                      size_t ad_len, const uint8_t *blob, size_t blob_len,
+                      uint8_t *out_plaintext) {
+    if (blob_len < BLOB_OVERHEAD || blob_len - BLOB_OVERHEAD > INT_MAX || ad_len > INT_MAX) {
+        return false;
+    }
 
-    if (EVP_EncryptFinal_ex(ctx, ciphertext + len, &len) != 1){
-		EVP_CIPHER_CTX_free(ctx);
-		return false;
-	}
+    size_t ciphertext_len = blob_len - BLOB_OVERHEAD;
+    const uint8_t *ciphertext = blob + IV_LEN;
+    const uint8_t *tag = ciphertext + ciphertext_len;
+    int len = 0;
 
+    if (EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, blob) != 1) {
+        return false;
+    }
 
-    ciphertext_len += len;
+    if (header && EVP_DecryptUpdate(ctx, NULL, &len, header, CIPHER_HEADER_LEN) != 1) {
+        return false;
+    }
+
+    if (ad_len && EVP_DecryptUpdate(ctx, NULL, &len, ad, (int)ad_len) != 1) {
+        return false;
+    }
+
+    if (EVP_DecryptUpdate(ctx, out_plaintext, &len, ciphertext, (int)ciphertext_len) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, TAG_LEN, (void *)tag) != 1 ||
+        EVP_DecryptFinal_ex(ctx, out_plaintext + len, &len) != 1) {
+        OPENSSL_cleanse(out_plaintext, ciphertext_len);
+        return false;
+    }
+    return true;
+}
+
+bool is_valid_cipher(uint8_t cipher) {
+    return cipher_of(cipher) != NULL;
+}
+
+uint8_t preferred_cipher(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    bool hardware_gcm = __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul");
+#elif defined(__linux__) && defined(__aarch64__)
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    bool hardware_gcm = (hwcap & HWCAP_AES) && (hwcap & HWCAP_PMULL);
+#else
+    bool hardware_gcm = false;
+#endif
+
+    /* table based AES is both slow and cache-timing prone */
+    return hardware_gcm ? CIPHER_AES_256_GCM : CIPHER_CHACHA20_POLY1305;
+}
 
-    uint8_t *tag = ciphertext + ciphertext_len;
+bool encrypt_blob(const uint8_t *key,const uint8_t *plaintext,
+				  size_t plaintext_len,uint8_t *out_blob){
 
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, TAG_LEN, tag) != 1){
-		EVP_CIPHER_CTX_free(ctx);
-		return false;
+    if (!key || !plaintext || !out_blob) {
+        return false;
+    }
+
+    if (RAND_bytes(out_blob, IV_LEN) != 1){
+        return false;
 	}
 
+    EVP_CIPHER_CTX *ctx = cipher_context_new(key, CIPHER_AES_256_GCM, 1);
+    if (!ctx){
+        return false;
+	}
+
+    bool return_code = aead_seal(ctx, NULL, NULL, 0, plaintext, plaintext_len, out_blob);
+
     EVP_CIPHER_CTX_free(ctx);
-    return true;
+    return return_code;
 
 }
 
@@ -128,51 +539,236 @@ bool decrypt_blob(const uint8_t *key,const uint8_t *blob,
         return false;
     }
 
-    if (blob_len < IV_LEN + TAG_LEN) {
+    if (blob_len < BLOB_OVERHEAD) {
         return false;
     }
 
-    size_t ciphertext_len = blob_len - IV_LEN - TAG_LEN;
-
-    const uint8_t *iv = blob;
-    const uint8_t *ciphertext = blob + IV_LEN;
-    const uint8_t *tag = blob + IV_LEN + ciphertext_len;
-
-    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    EVP_CIPHER_CTX *ctx = cipher_context_new(key, CIPHER_AES_256_GCM, 0);
     if (!ctx){
         return false;
 	}
 
-    int len = 0;
+    bool return_code = aead_open(ctx, NULL, NULL, 0, blob, blob_len, out_plaintext);
+
+    EVP_CIPHER_CTX_free(ctx);
+    return return_code;
+
+}
 
-    if (EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) != 1) {
-		EVP_CIPHER_CTX_free(ctx);
-		return false;
+bool encrypt_tagged_blob(const uint8_t *key, uint8_t cipher, const uint8_t *plaintext,
+                         size_t plaintext_len, uint8_t *out_blob) {
+    AeadContext *aead = aead_context_new_cipher(key, cipher);
+    if (!aead) {
+        return false;
     }
 
-    if (EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv) != 1) {
-		EVP_CIPHER_CTX_free(ctx);
-		return false;
+    bool return_code = aead_seal_tagged(aead, NULL, 0, plaintext, plaintext_len, out_blob);
+
+    aead_context_free(aead);
+    return return_code;
+}
+
+bool decrypt_tagged_blob(const uint8_t *key, const uint8_t *blob, size_t blob_len,
+                         uint8_t *out_plaintext) {
+    AeadContext *aead = aead_context_new(key);
+    if (!aead) {
+        return false;
     }
 
-    if (EVP_DecryptUpdate(ctx,out_plaintext,&len,
-						  ciphertext,(int)ciphertext_len) != 1) {
-		EVP_CIPHER_CTX_free(ctx);
-		return false;
+    bool return_code = aead_open_tagged(aead, NULL, 0, blob, blob_len, out_plaintext);
+
+    aead_context_free(aead);
+    return return_code;
+}
+
+AeadContext *aead_context_new(const uint8_t *key) {
+    return aead_context_new_cipher(key, CIPHER_AES_256_GCM);
+}
+
+AeadContext *aead_context_new_cipher(const uint8_t *key, uint8_t cipher) {
+    if (!key || !is_valid_cipher(cipher)) {
+        return NULL;
     }
 
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG,
-							TAG_LEN, (void *)tag) != 1) {
-		EVP_CIPHER_CTX_free(ctx);
-		return false;
+    AeadContext *aead = calloc(1, sizeof(AeadContext));
+    if (!aead) {
+        return NULL;
     }
+    aead->cipher = cipher;
+    memcpy(aead->key, key, AEAD_KEY_LEN);
+    return aead;
+}
 
-    if (EVP_DecryptFinal_ex(ctx, out_plaintext + len, &len) != 1) {
-		EVP_CIPHER_CTX_free(ctx);
-		return false;
+uint8_t aead_context_cipher(const AeadContext *aead) {
+    return aead ? aead->cipher : 0;
+}
+
+void aead_context_free(AeadContext *aead) {
+    if (!aead) {
+        return;
     }
 
-    EVP_CIPHER_CTX_free(ctx);
+    /* EVP_CIPHER_CTX_free cleanses the expanded keys */
+    for (int i = 0; i < CIPHER_COUNT; i++) {
+        EVP_CIPHER_CTX_free(aead->seal[i]);
+        EVP_CIPHER_CTX_free(aead->open[i]);
+    }
+    OPENSSL_cleanse(aead->key, AEAD_KEY_LEN);
+    free(aead);
+}
+
+bool aead_encrypt(AeadContext *aead, const uint8_t *plaintext, size_t plaintext_len,
+                  uint8_t *out_blob) {
+    return aead_encrypt_ad(aead, NULL, 0, plaintext, plaintext_len, out_blob);
+}
+
+bool aead_decrypt(AeadContext *aead, const uint8_t *blob, size_t blob_len,
+                  uint8_t *out_plaintext) {
+    return aead_decrypt_ad(aead, NULL, 0, blob, blob_len, out_plaintext);
+}
+
+bool aead_encrypt_ad(AeadContext *aead, const uint8_t *ad, size_t ad_len,
+                     const uint8_t *plaintext, size_t plaintext_len, uint8_t *out_blob) {
+    if (!aead || !plaintext || !out_blob || (!ad && ad_len)) {
+        return false;
+    }
+
+    EVP_CIPHER_CTX *ctx = context_of(aead, CIPHER_AES_256_GCM, 1);
+    if (!ctx || RAND_bytes(out_blob, IV_LEN) != 1) {
+        return false;
+    }
+    return aead_seal(ctx, NULL, ad, ad_len, plaintext, plaintext_len, out_blob);
+}
+
+bool aead_decrypt_ad(AeadContext *aead, const uint8_t *ad, size_t ad_len, const uint8_t *blob,
+                     size_t blob_len, uint8_t *out_plaintext) {
+    if (!aead || !blob || !out_plaintext || (!ad && ad_len)) {
+        return false;
+    }
+    EVP_CIPHER_CTX *ctx = context_of(aead, CIPHER_AES_256_GCM, 0);
+    return ctx && aead_open(ctx, NULL, ad, ad_len, blob, blob_len, out_plaintext);
+}
+
+bool aead_seal_tagged(AeadContext *aead, const uint8_t *ad, size_t ad_len,
+                      const uint8_t *plaintext, size_t plaintext_len, uint8_t *out_blob) {
+    if (!aead || !plaintext || !out_blob || (!ad && ad_len)) {
+        return false;
+    }
+
+    EVP_CIPHER_CTX *ctx = context_of(aead, aead->cipher, 1);
+    if (!ctx) {
+        return false;
+    }
+
+    out_blob[0] = aead->cipher;
+    if (RAND_bytes(out_blob + CIPHER_HEADER_LEN, IV_LEN) != 1) {
+        return false;
+    }
+    return aead_seal(ctx, out_blob, ad, ad_len, plaintext, plaintext_len,
+                     out_blob + CIPHER_HEADER_LEN);
+}
+
+bool aead_open_tagged(AeadContext *aead, const uint8_t *ad, size_t ad_len, const uint8_t *blob,
+                      size_t blob_len, uint8_t *out_plaintext) {
+    if (!aead || !blob || !out_plaintext || (!ad && ad_len)) {
+        return false;
+    }
+
+    if (blob_len < TAGGED_BLOB_OVERHEAD || !is_valid_cipher(blob[0])) {
+        return false;
+    }
+
+    EVP_CIPHER_CTX *ctx = context_of(aead, blob[0], 0);
+    return ctx && aead_open(ctx, blob, ad, ad_len, blob + CIPHER_HEADER_LEN,
+                            blob_len - CIPHER_HEADER_LEN, out_plaintext);
+}
+
+bool aead_encrypt_batch(AeadContext *aead, const BlobSpan *plaintexts, size_t count,
+                        uint8_t *out_slab, size_t slab_len, BlobSpan *out_blobs) {
+    uint8_t ivs[AEAD_BATCH_IVS * IV_LEN];
+    size_t needed = 0;
+
+    if (!aead || (count && (!plaintexts || !out_slab))) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (!plaintexts[i].data || plaintexts[i].len > SIZE_MAX - BLOB_OVERHEAD - needed) {
+            return false;
+        }
+        needed += plaintexts[i].len + BLOB_OVERHEAD;
+    }
+    if (needed > slab_len) {
+        return false;
+    }
+
+    EVP_CIPHER_CTX *ctx = count ? context_of(aead, CIPHER_AES_256_GCM, 1) : NULL;
+    if (count && !ctx) {
+        return false;
+    }
+
+    uint8_t *blob = out_slab;
+    for (size_t i = 0; i < count; i++) {
+        size_t slot = i % AEAD_BATCH_IVS;
+
+        if (slot == 0) {
+            size_t left = count - i;
+            size_t n = (left < AEAD_BATCH_IVS) ? left : AEAD_BATCH_IVS;
+
+            if (RAND_bytes(ivs, (int)(n * IV_LEN)) != 1) {
+                return false;
+            }
+        }
+
+        memcpy(blob, ivs + slot * IV_LEN, IV_LEN);
+        if (!aead_seal(ctx, NULL, NULL, 0, plaintexts[i].data, plaintexts[i].len, blob)) {
+            return false;
+        }
+
+        if (out_blobs) {
+            out_blobs[i].data = blob;
+            out_blobs[i].len = plaintexts[i].len + BLOB_OVERHEAD;
+        }
+        blob += plaintexts[i].len + BLOB_OVERHEAD;
+    }
     return true;
+}
+
+bool aead_decrypt_batch(AeadContext *aead, const BlobSpan *blobs, size_t count,
+                        uint8_t *out_slab, size_t slab_len, BlobSpan *out_plaintexts) {
+    size_t needed = 0;
+
+    if (!aead || (count && (!blobs || !out_slab))) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (!blobs[i].data || blobs[i].len < BLOB_OVERHEAD) {
+            return false;
+        }
+        needed += blobs[i].len - BLOB_OVERHEAD;
+    }
+    if (needed > slab_len) {
+        return false;
+    }
+
+    EVP_CIPHER_CTX *ctx = count ? context_of(aead, CIPHER_AES_256_GCM, 0) : NULL;
+    if (count && !ctx) {
+        return false;
+    }
 
+    uint8_t *plaintext = out_slab;
+    for (size_t i = 0; i < count; i++) {
+        if (!aead_open(ctx, NULL, NULL, 0, blobs[i].data, blobs[i].len, plaintext)) {
+            OPENSSL_cleanse(out_slab, (size_t)(plaintext - out_slab));
+            return false;
+        }
+
+        if (out_plaintexts) {
+            out_plaintexts[i].data = plaintext;
+            out_plaintexts[i].len = blobs[i].len - BLOB_OVERHEAD;
+        }
+        plaintext += blobs[i].len - BLOB_OVERHEAD;
+    }
+    return true;
 }
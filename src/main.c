@@ -1,8 +1,46 @@
+#include <CVault/service/db_config_service.h>
+#include <CVault/service/db_init_service.h>
+#include <CVault/service/environment_service.h>
+#include <CVault/service/kdf_service.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+static int run_calibrate(int argc, char **argv);
 
 int main(int argc, char** argv)
 {
+    if (argc > 1 && strcmp(argv[1], "calibrate") == 0) {
+        return run_calibrate(argc, argv);
+    }
+
     printf("Hello, World\n");
     return EXIT_SUCCESS;
 }
+
+/*
+ * calibrate [target_ms] [memory_mib]
+ * benchmarks the KDF and records the parameters in config.db
+ */
+static int run_calibrate(int argc, char **argv)
+{
+    uint32_t target_ms = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 10) : 0;
+    uint64_t mem_budget_kib = (argc > 3) ? strtoull(argv[3], NULL, 10) * 1024 : 0;
+
+    if (!initialize_environment() || !init_schema() || !open_config_service()) {
+        fprintf(stderr, "calibrate: cannot open the configuration database\n");
+        return EXIT_FAILURE;
+    }
+
+    KdfParams params;
+    bool calibrated = calibrate_kdf_service(target_ms, mem_budget_kib, &params);
+    close_config_service();
+
+    if (!calibrated) {
+        fprintf(stderr, "calibrate: failed (kdf_status %d)\n", kdf_status);
+        return EXIT_FAILURE;
+    }
+
+    printf("argon2id t=%u m=%u KiB p=%u\n", params.t_cost, params.m_cost, params.p_cost);
+    return EXIT_SUCCESS;
+}
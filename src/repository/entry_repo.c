@@ -3,102 +3,168 @@
 #include <CVault/models/vault_entry.h>
 #include <CVault/repository/repository.h>
 #include <CVault/utils/security_utils.h>
+#include <errno.h>
+#include <inttypes.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-repo_return_code repo_vault_init(sqlite3 *db) {
-    char *sql_create_entries_table = "CREATE TABLE IF NOT EXISTS entries ("
-                                     "uuid CHAR(36) PRIMARY KEY NOT NULL,"
-                                     "service_blob BLOB NOT NULL,"
-                                     "username_blob BLOB NOT NULL,"
-                                     "password_blob BLOB NOT NULL,"
-                                     "notes_blob BLOB,"
-                                     "created_at INTEGER NOT NULL,"
-                                     "updated_at INTEGER NOT NULL"
-                                     ");";
-    if (sqlite3_exec(db, sql_create_entries_table, NULL, NULL, NULL) != SQLITE_OK) {
-        return DATA_BASE_ERR;
-    }
-
-    if (sqlite3_exec(db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL) != SQLITE_OK) {
-        return DATA_BASE_ERR;
-    }
-
-    return OK;
-}
-
-repo_return_code add_entry(IntVaultEntry *entry, sqlite3 *db) {
-    char *sql_query =
-        "INSERT INTO entries "
-        "(uuid, service_blob, username_blob, password_blob, notes_blob, created_at, updated_at) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?)";
+/*
+ * uuid holds the UUID_BIN_LEN bytes form of the uuid string of the API. A row
+ * holds either record_blob or the per-field blobs it replaces.
+ */
+#define ENTRIES_TABLE_DEFINITION                                                                   \
+    "(uuid BLOB PRIMARY KEY NOT NULL CHECK (length(uuid) = 16),"                                   \
+    "service_blob BLOB,"                                                                           \
+    "username_blob BLOB,"                                                                          \
+    "password_blob BLOB,"                                                                          \
+    "notes_blob BLOB,"                                                                             \
+    "created_at INTEGER NOT NULL,"                                                                 \
+    "updated_at INTEGER NOT NULL,"                                                                 \
+    "record_blob BLOB,"                                                                            \
+    "CHECK (record_blob IS NOT NULL OR (service_blob IS NOT NULL AND "                             \
+    "username_blob IS NOT NULL AND password_blob IS NOT NULL))"                                    \
+    ") WITHOUT ROWID;"
+
+#define SQL_CREATE_RECENT_INDEX                                                                    \
+    "CREATE INDEX IF NOT EXISTS entries_recent ON entries (updated_at, uuid);"
+
+/* keep in sync with VAULT_SCHEMA_VERSION */
+#define SQL_SET_SCHEMA_VERSION "PRAGMA user_version = 3;"
+
+#define SQL_INSERT_ENTRY                                                                           \
+    "INSERT INTO entries "                                                                         \
+    "(uuid, service_blob, username_blob, password_blob, notes_blob, created_at, updated_at, "      \
+    "record_blob) "                                                                                \
+    "VALUES (?, ?, ?, ?, ?, ?, ?, ?)"
+
+/*
+ * keyset pages: ?1 is the uuid and ?2 the updated_at of the last row of the
+ * previous page, ?3 the row count. First pages have no lower bound, any uuid
+ * is a valid key. Recent pages walk entries_recent backwards, the uuid breaks
+ * updated_at ties so the order is total.
+ */
+#define SQL_ALL_ENTRIES "SELECT * FROM entries"
+#define SQL_PAGE_BY_UUID "SELECT * FROM entries ORDER BY uuid LIMIT ?3"
+#define SQL_PAGE_BY_UUID_AFTER "SELECT * FROM entries WHERE uuid > ?1 ORDER BY uuid LIMIT ?3"
+#define SQL_PAGE_BY_RECENT "SELECT * FROM entries ORDER BY updated_at DESC, uuid DESC LIMIT ?3"
+#define SQL_PAGE_BY_RECENT_AFTER                                                                   \
+    "SELECT * FROM entries WHERE (updated_at, uuid) < (?2, ?1) "                                   \
+    "ORDER BY updated_at DESC, uuid DESC LIMIT ?3"
+
+/* a new record replaces the whole entry, the field blobs are dropped */
+#define SQL_UPDATE_ENTRY                                                                           \
+    "UPDATE entries SET "                                                                          \
+    "service_blob = CASE WHEN ?7 IS NULL THEN COALESCE(?1, service_blob) END, "                    \
+    "username_blob = CASE WHEN ?7 IS NULL THEN COALESCE(?2, username_blob) END, "                  \
+    "password_blob = CASE WHEN ?7 IS NULL THEN COALESCE(?3, password_blob) END, "                  \
+    "notes_blob = CASE WHEN ?7 IS NULL THEN COALESCE(?4, notes_blob) END, "                        \
+    "updated_at = ?5, "                                                                            \
+    "record_blob = COALESCE(?7, record_blob) "                                                     \
+    "WHERE uuid = ?6"
+
+struct EntryCursor {
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    bool borrow;
+    bool done;
+    char uuid[UUID_STR_LEN + 1];
+};
+
+static repo_return_code migrate_entries_table(sqlite3 *db, int version);
+static repo_return_code collect_rows(sqlite3_stmt *stmt, uint32_t limit, DLinkedList *out_wrapper,
+                                     bool *out_more);
+static bool parse_page_token(entry_order order, const char *token, int64_t *out_updated_at,
+                             uint8_t *out_uuid);
+static repo_return_code write_entries(IntVaultEntry *entries, size_t count, size_t batch_size,
+                                      repo_return_code *out_results, sqlite3 *db,
+                                      bool inserting);
+static repo_return_code insert_row(sqlite3_stmt *stmt, const IntVaultEntry *entry);
+static repo_return_code update_row(sqlite3_stmt *stmt, const char *uuid,
+                                   const IntVaultEntry *new_entry, sqlite3 *db);
+static int bind_optional_blob(sqlite3_stmt *stmt, int index, const uint8_t *data, uint32_t len);
+static repo_return_code pack_row(sqlite3_stmt *stmt, size_t header_size, uint8_t **out_block,
+                                 IntVaultEntry *out_entry);
+static repo_return_code read_row(sqlite3_stmt *stmt, IntVaultEntry *out_entry);
+static repo_return_code read_row_node(sqlite3_stmt *stmt, IntVaultEntry **out_node);
+static repo_return_code borrow_row(EntryCursor *cursor, IntVaultEntry *out_entry);
+static void borrow_column(sqlite3_stmt *stmt, int column, uint8_t **out_data, uint32_t *out_len);
+static bool entries_table_exists(sqlite3 *db);
 
+repo_return_code repo_vault_init(sqlite3 *db) {
+    char *sql_create_entries_table = "CREATE TABLE IF NOT EXISTS entries " ENTRIES_TABLE_DEFINITION;
     sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db, sql_query, -1, &stmt, NULL) != SQLITE_OK) {
-        return DATA_BASE_ERR;
-    }
+    int version = 0;
 
-    if (sqlite3_bind_text(stmt, 1, (const char *)entry->uuid, -1, SQLITE_TRANSIENT) != SQLITE_OK) {
-        sqlite3_finalize(stmt);
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, NULL) != SQLITE_OK) {
         return DATA_BASE_ERR;
     }
-    if (sqlite3_bind_blob(stmt, 2, (const void *)entry->service_name, (int)entry->service_len,
-                          SQLITE_TRANSIENT) != SQLITE_OK) {
-        sqlite3_finalize(stmt);
-        return DATA_BASE_ERR;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        version = sqlite3_column_int(stmt, 0);
     }
-    if (sqlite3_bind_blob(stmt, 3, (const void *)entry->username, (int)entry->username_len,
-                          SQLITE_TRANSIENT) != SQLITE_OK) {
-        sqlite3_finalize(stmt);
-        return DATA_BASE_ERR;
-    }
-    if (sqlite3_bind_blob(stmt, 4, (const void *)entry->password, (int)entry->password_len,
-                          SQLITE_TRANSIENT) != SQLITE_OK) {
-        sqlite3_finalize(stmt);
-        return DATA_BASE_ERR;
-    }
-    if (entry->notes != NULL) {
-        if (sqlite3_bind_blob(stmt, 5, (const void *)entry->notes, (int)entry->notes_len,
-                              SQLITE_TRANSIENT) != SQLITE_OK) {
-            sqlite3_finalize(stmt);
+    sqlite3_finalize(stmt);
+
+    if (version < VAULT_SCHEMA_VERSION && entries_table_exists(db)) {
+        if (migrate_entries_table(db, version) != OK) {
             return DATA_BASE_ERR;
         }
     } else {
-        if (sqlite3_bind_null(stmt, 5) != SQLITE_OK) {
+        if (sqlite3_exec(db, sql_create_entries_table, NULL, NULL, NULL) != SQLITE_OK) {
+            return DATA_BASE_ERR;
+        }
+        if (version < VAULT_SCHEMA_VERSION &&
+            sqlite3_exec(db, SQL_SET_SCHEMA_VERSION, NULL, NULL, NULL) != SQLITE_OK) {
             return DATA_BASE_ERR;
-            sqlite3_finalize(stmt);
         }
     }
-    if (sqlite3_bind_int(stmt, 6, (int)entry->created_at) != SQLITE_OK) {
+
+    /* dropped with the old table by a migration, so created on every init */
+    if (sqlite3_exec(db, SQL_CREATE_RECENT_INDEX, NULL, NULL, NULL) != SQLITE_OK) {
         return DATA_BASE_ERR;
-        sqlite3_finalize(stmt);
     }
-    if (sqlite3_bind_int(stmt, 7, (int)entry->updated_at) != SQLITE_OK) {
-        sqlite3_finalize(stmt);
+
+    if (sqlite3_exec(db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL) != SQLITE_OK) {
         return DATA_BASE_ERR;
     }
 
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
-        sqlite3_finalize(stmt);
+    return OK;
+}
+
+repo_return_code add_entry(IntVaultEntry *entry, sqlite3 *db) {
+    sqlite3_stmt *stmt;
+
+    if (!(stmt = repo_prepare(db, SQL_INSERT_ENTRY))) {
         return DATA_BASE_ERR;
     }
 
-    sqlite3_finalize(stmt);
-    return OK;
+    repo_return_code return_code = insert_row(stmt, entry);
+    repo_release(db, stmt);
+    return return_code;
+}
+
+repo_return_code add_entries(IntVaultEntry *entries, size_t count, size_t batch_size,
+                             repo_return_code *out_results, sqlite3 *db) {
+    return write_entries(entries, count, batch_size, out_results, db, true);
 }
 
 repo_return_code read_entry(const char *uuid, IntVaultEntry *out_entry, sqlite3 *db) {
     char *sql_query = "SELECT * FROM entries WHERE uuid = ?";
 
+    /* no row can match something that is not a UUID */
+    uint8_t uuid_bytes[UUID_BIN_LEN];
+    if (!uuid_from_string(uuid, uuid_bytes)) {
+        return NOT_FOUND_ERR;
+    }
+
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db, sql_query, -1, &stmt, NULL) != SQLITE_OK) {
+    if (!(stmt = repo_prepare(db, sql_query))) {
         return DATA_BASE_ERR;
     }
 
-    if (sqlite3_bind_text(stmt, 1, uuid, -1, SQLITE_TRANSIENT) != SQLITE_OK) {
-        sqlite3_finalize(stmt);
+    if (sqlite3_bind_blob(stmt, 1, uuid_bytes, UUID_BIN_LEN, SQLITE_TRANSIENT) != SQLITE_OK) {
+        repo_release(db, stmt);
         return DATA_BASE_ERR;
     }
 
@@ -106,236 +172,201 @@ repo_return_code read_entry(const char *uuid, IntVaultEntry *out_entry, sqlite3
 
     switch (rc) {
         case SQLITE_ERROR:
-            sqlite3_finalize(stmt);
+            repo_release(db, stmt);
             return DATA_BASE_ERR;
 
         case SQLITE_DONE:
-            sqlite3_finalize(stmt);
+            repo_release(db, stmt);
             return NOT_FOUND_ERR;
 
-        case SQLITE_ROW:
-            char *tmp_uuid = (char *)sqlite3_column_text(stmt, 0);
-            if (!(out_entry->uuid = strdup(tmp_uuid))) {
-                sqlite3_finalize(stmt);
-                return MEMORY_ERR;
-            }
-
-            uint8_t *tmp_service = (uint8_t *)sqlite3_column_blob(stmt, 1);
-            out_entry->service_name =
-                (uint8_t *)malloc(out_entry->service_len = sqlite3_column_bytes(stmt, 1));
-            if (!out_entry->service_name) {
-                sqlite3_finalize(stmt);
-                return MEMORY_ERR;
-            }
-            memcpy(out_entry->service_name, tmp_service, out_entry->service_len);
-
-            uint8_t *tmp_username = (uint8_t *)sqlite3_column_blob(stmt, 2);
-            out_entry->username =
-                (uint8_t *)malloc(out_entry->username_len = sqlite3_column_bytes(stmt, 2));
-            if (!out_entry->username) {
-                sqlite3_finalize(stmt);
-                return MEMORY_ERR;
-            }
-            memcpy(out_entry->username, tmp_username, out_entry->username_len);
-
-            uint8_t *tmp_password = (uint8_t *)sqlite3_column_blob(stmt, 3);
-            out_entry->password =
-                (uint8_t *)malloc(out_entry->password_len = sqlite3_column_bytes(stmt, 3));
-            if (!out_entry->password) {
-                sqlite3_finalize(stmt);
-                return MEMORY_ERR;
-            }
-            memcpy(out_entry->password, tmp_password, out_entry->password_len);
-
-            if ((out_entry->notes_len = sqlite3_column_bytes(stmt, 4))) {
-                uint8_t *tmp_notes = (uint8_t *)sqlite3_column_blob(stmt, 4);
-                out_entry->notes = (uint8_t *)malloc(out_entry->password_len);
-                if (!out_entry->notes) {
-                    sqlite3_finalize(stmt);
-                    return MEMORY_ERR;
-                }
-                memcpy(out_entry->notes, tmp_notes, out_entry->notes_len);
-            } else {
-                out_entry->notes = NULL;
-            }
-
-            out_entry->created_at = sqlite3_column_int64(stmt, 5);
-
-            out_entry->updated_at = sqlite3_column_int64(stmt, 6);
-
-            sqlite3_finalize(stmt);
-            return OK;
+        case SQLITE_ROW:;
+            repo_return_code row_rc = read_row(stmt, out_entry);
+            repo_release(db, stmt);
+            return row_rc;
         default:
-            sqlite3_finalize(stmt);
+            repo_release(db, stmt);
             return REPO_UNEXPECTED_ERR;
     }
 }
 repo_return_code read_all_entries(DLinkedList *out_wrapper, sqlite3 *db) {
-    char *sql_query = "SELECT * FROM entries";
     sqlite3_stmt *stmt;
 
-    if ((sqlite3_prepare_v2(db, sql_query, -1, &stmt, NULL)) != SQLITE_OK) {
+    if (!(stmt = repo_prepare(db, SQL_ALL_ENTRIES))) {
         return DATA_BASE_ERR;
     }
 
-    int rc;
-    IntVaultEntry *buffer;
-    while (true) {
-        rc = sqlite3_step(stmt);
-        switch (rc) {
-            case SQLITE_ERROR:
-                sqlite3_finalize(stmt);
-                return DATA_BASE_ERR;
-            case SQLITE_DONE:
-                sqlite3_finalize(stmt);
-                return OK;
-            case SQLITE_ROW:
-                buffer = malloc(sizeof(IntVaultEntry));
-
-                char *tmp_uuid = (char *)sqlite3_column_text(stmt, 0);
-                if (!(buffer->uuid = strdup(tmp_uuid))) {
-                    sqlite3_finalize(stmt);
-                    return MEMORY_ERR;
-                }
-
-                uint8_t *tmp_service = (uint8_t *)sqlite3_column_blob(stmt, 1);
-                buffer->service_name =
-                    (uint8_t *)malloc(buffer->service_len = sqlite3_column_bytes(stmt, 1));
-                if (!buffer->service_name) {
-                    sqlite3_finalize(stmt);
-                    return MEMORY_ERR;
-                }
-                memcpy(buffer->service_name, tmp_service, buffer->service_len);
-
-                uint8_t *tmp_username = (uint8_t *)sqlite3_column_blob(stmt, 2);
-                buffer->username =
-                    (uint8_t *)malloc(buffer->username_len = sqlite3_column_bytes(stmt, 2));
-                if (!buffer->username) {
-                    sqlite3_finalize(stmt);
-                    return MEMORY_ERR;
-                }
-                memcpy(buffer->username, tmp_username, buffer->username_len);
-
-                uint8_t *tmp_password = (uint8_t *)sqlite3_column_blob(stmt, 3);
-                buffer->password =
-                    (uint8_t *)malloc(buffer->password_len = sqlite3_column_bytes(stmt, 3));
-                if (!buffer->password) {
-                    sqlite3_finalize(stmt);
-                    return MEMORY_ERR;
-                }
-                memcpy(buffer->password, tmp_password, buffer->password_len);
-
-                if ((buffer->notes_len = sqlite3_column_bytes(stmt, 4))) {
-                    uint8_t *tmp_notes = (uint8_t *)sqlite3_column_blob(stmt, 4);
-                    buffer->notes = (uint8_t *)malloc(buffer->notes_len);
-                    if (!buffer->notes) {
-                        sqlite3_finalize(stmt);
-                        return MEMORY_ERR;
-                    }
-                    memcpy(buffer->notes, tmp_notes, buffer->notes_len);
-                } else {
-                    buffer->notes = NULL;
-                }
+    repo_return_code return_code = collect_rows(stmt, UINT32_MAX, out_wrapper, NULL);
+    repo_release(db, stmt);
+    return return_code;
+}
 
-                buffer->created_at = sqlite3_column_int64(stmt, 5);
+repo_return_code open_entry_cursor(bool borrow, EntryCursor **out_cursor, sqlite3 *db) {
+    EntryCursor *cursor = calloc(1, sizeof(EntryCursor));
 
-                buffer->updated_at = sqlite3_column_int64(stmt, 6);
+    *out_cursor = NULL;
+    if (!cursor) {
+        return MEMORY_ERR;
+    }
 
-                void *tmp = dlinked_list_push_back_node(out_wrapper, buffer);
-                if (tmp == NULL) {
-                    sqlite3_finalize(stmt);
-                    return DATA_STRUCTURE_ERR;
-                } else {
-                    out_wrapper = tmp;
-                }
-                break;
-            default:
-                sqlite3_finalize(stmt);
-                return REPO_UNEXPECTED_ERR;
-        }
+    if (!(cursor->stmt = repo_prepare(db, SQL_ALL_ENTRIES))) {
+        free(cursor);
+        return DATA_BASE_ERR;
     }
-    sqlite3_finalize(stmt);
+
+    cursor->db = db;
+    cursor->borrow = borrow;
+    *out_cursor = cursor;
     return OK;
 }
-repo_return_code update_entry(const char *uuid, IntVaultEntry *new_entry, sqlite3 *db) {
-    char *sql_query = "UPDATE entries SET "
-                      "service_blob = COALESCE(?, service_blob), "
-                      "username_blob = COALESCE(?, username_blob), "
-                      "password_blob = COALESCE(?, password_blob), "
-                      "notes_blob = COALESCE(?,notes_blob), "
-                      "updated_at = ? "
-                      "WHERE uuid = ?";
 
+repo_return_code next_entry(EntryCursor *cursor, IntVaultEntry *out_entry) {
+    if (cursor->done) {
+        return NOT_FOUND_ERR;
+    }
+
+    switch (sqlite3_step(cursor->stmt)) {
+        case SQLITE_ROW:
+            return cursor->borrow ? borrow_row(cursor, out_entry) : read_row(cursor->stmt, out_entry);
+
+        case SQLITE_DONE:
+            cursor->done = true;
+            return NOT_FOUND_ERR;
+
+        default:
+            cursor->done = true;
+            return DATA_BASE_ERR;
+    }
+}
+
+void free_int_entry(IntVaultEntry *entry) {
+    if (!entry) {
+        return;
+    }
+
+    free(entry->uuid);
+    memset(entry, 0, sizeof(IntVaultEntry));
+}
+
+void free_int_entry_node(void *data) {
+    free(data);
+}
+
+void close_entry_cursor(EntryCursor *cursor) {
+    if (!cursor) {
+        return;
+    }
+
+    repo_release(cursor->db, cursor->stmt);
+    free(cursor);
+}
+
+repo_return_code read_entries_after(const char *after_uuid, uint32_t limit,
+                                    DLinkedList *out_wrapper, sqlite3 *db) {
+    char token[ENTRY_PAGE_TOKEN_LEN];
+    char next_token[ENTRY_PAGE_TOKEN_LEN];
+
+    if (after_uuid && snprintf(token, sizeof(token), "u:%s", after_uuid) >= (int)sizeof(token)) {
+        return NOT_FOUND_ERR;
+    }
+
+    return read_entries_page(ENTRY_ORDER_UUID, after_uuid ? token : NULL, limit, out_wrapper,
+                             next_token, db);
+}
+
+repo_return_code read_entries_page(entry_order order, const char *token, uint32_t limit,
+                                   DLinkedList *out_wrapper, char *out_next_token, sqlite3 *db) {
+    uint8_t uuid_bytes[UUID_BIN_LEN] = {0};
+    int64_t updated_at = 0;
+    bool seek = token && *token;
+    const char *sql_query;
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v2(db, sql_query, -1, &stmt, NULL) != SQLITE_OK) {
-        return DATA_BASE_ERR;
+    if (seek && !parse_page_token(order, token, &updated_at, uuid_bytes)) {
+        return NOT_FOUND_ERR;
     }
 
-    if (new_entry->service_name == NULL) {
-        if (sqlite3_bind_null(stmt, 1) != SQLITE_OK) {
-            sqlite3_finalize(stmt);
-            return DATA_BASE_ERR;
-        }
-    } else {
-        if (sqlite3_bind_blob(stmt, 1, new_entry->service_name, new_entry->service_len,
-                              SQLITE_TRANSIENT) != SQLITE_OK) {
-            sqlite3_finalize(stmt);
-            return DATA_BASE_ERR;
+    /* token may be out_next_token itself, it is parsed already */
+    if (!limit) {
+        if (!seek) {
+            out_next_token[0] = '\0';
+        } else if (out_next_token != token) {
+            strcpy(out_next_token, token);
         }
+        return OK;
     }
+    out_next_token[0] = '\0';
 
-    if (new_entry->username == NULL) {
-        if (sqlite3_bind_null(stmt, 2) != SQLITE_OK) {
-            sqlite3_finalize(stmt);
-            return DATA_BASE_ERR;
-        }
+    if (order == ENTRY_ORDER_UUID) {
+        sql_query = seek ? SQL_PAGE_BY_UUID_AFTER : SQL_PAGE_BY_UUID;
     } else {
-        if (sqlite3_bind_blob(stmt, 2, new_entry->username, new_entry->username_len,
-                              SQLITE_TRANSIENT) != SQLITE_OK) {
-            sqlite3_finalize(stmt);
-            return DATA_BASE_ERR;
-        }
+        sql_query = seek ? SQL_PAGE_BY_RECENT_AFTER : SQL_PAGE_BY_RECENT;
     }
 
-    if (new_entry->password == NULL) {
-        if (sqlite3_bind_null(stmt, 3) != SQLITE_OK) {
-            sqlite3_finalize(stmt);
-            return DATA_BASE_ERR;
-        }
-    } else {
-        if (sqlite3_bind_blob(stmt, 3, new_entry->password, new_entry->password_len,
-                              SQLITE_TRANSIENT) != SQLITE_OK) {
-            sqlite3_finalize(stmt);
-            return DATA_BASE_ERR;
-        }
+    if (!(stmt = repo_prepare(db, sql_query))) {
+        return DATA_BASE_ERR;
     }
 
-    if (new_entry->notes == NULL) {
-        if (sqlite3_bind_null(stmt, 4) != SQLITE_OK) {
-            sqlite3_finalize(stmt);
-            return DATA_BASE_ERR;
-        }
-    } else {
-        if (sqlite3_bind_blob(stmt, 4, new_entry->notes, new_entry->notes_len, SQLITE_TRANSIENT) !=
-            SQLITE_OK) {
-            sqlite3_finalize(stmt);
-            return DATA_BASE_ERR;
+    /* one row past the page tells whether there is a next one */
+    bool more = false;
+    repo_return_code return_code = DATA_BASE_ERR;
+    if (sqlite3_bind_blob(stmt, 1, uuid_bytes, UUID_BIN_LEN, SQLITE_TRANSIENT) == SQLITE_OK &&
+        sqlite3_bind_int64(stmt, 2, updated_at) == SQLITE_OK &&
+        sqlite3_bind_int64(stmt, 3, (sqlite3_int64)limit + 1) == SQLITE_OK) {
+        return_code = collect_rows(stmt, limit, out_wrapper, &more);
+    }
+    repo_release(db, stmt);
+
+    if (return_code == OK && more) {
+        const IntVaultEntry *last = out_wrapper->tail->data;
+
+        if (order == ENTRY_ORDER_UUID) {
+            snprintf(out_next_token, ENTRY_PAGE_TOKEN_LEN, "u:%s", last->uuid);
+        } else {
+            snprintf(out_next_token, ENTRY_PAGE_TOKEN_LEN, "r:%" PRId64 ":%s",
+                     (int64_t)last->updated_at, last->uuid);
         }
     }
+    return return_code;
+}
+
+repo_return_code update_entry(const char *uuid, IntVaultEntry *new_entry, sqlite3 *db) {
+    sqlite3_stmt *stmt;
 
-    if (sqlite3_bind_int(stmt, 5, new_entry->updated_at) != SQLITE_OK) {
-        sqlite3_finalize(stmt);
+    if (!(stmt = repo_prepare(db, SQL_UPDATE_ENTRY))) {
         return DATA_BASE_ERR;
     }
 
-    if (sqlite3_bind_text(stmt, 6, uuid, -1, SQLITE_TRANSIENT) != SQLITE_OK) {
-        sqlite3_finalize(stmt);
+    repo_return_code return_code = update_row(stmt, uuid, new_entry, db);
+    repo_release(db, stmt);
+    return return_code;
+}
+
+repo_return_code update_entries(IntVaultEntry *entries, size_t count, size_t batch_size,
+                                repo_return_code *out_results, sqlite3 *db) {
+    return write_entries(entries, count, batch_size, out_results, db, false);
+}
+
+repo_return_code delete_entry(const char *uuid, sqlite3 *db) {
+    char *sql_query = "DELETE FROM entries WHERE uuid = ?";
+    sqlite3_stmt *stmt;
+
+    uint8_t uuid_bytes[UUID_BIN_LEN];
+    if (!uuid_from_string(uuid, uuid_bytes)) {
+        return NOT_FOUND_ERR;
+    }
+
+    if (!(stmt = repo_prepare(db, sql_query))) {
+        return DATA_BASE_ERR;
+    }
+
+    if (sqlite3_bind_blob(stmt, 1, uuid_bytes, UUID_BIN_LEN, SQLITE_TRANSIENT) != SQLITE_OK) {
+        repo_release(db, stmt);
         return DATA_BASE_ERR;
     }
 
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    repo_release(db, stmt);
+
     switch (rc) {
         case SQLITE_DONE:
             return (sqlite3_changes(db)) ? OK : NOT_FOUND_ERR;
@@ -347,23 +378,214 @@ repo_return_code update_entry(const char *uuid, IntVaultEntry *new_entry, sqlite
             return REPO_UNEXPECTED_ERR;
     }
 }
-repo_return_code delete_entry(const char *uuid, sqlite3 *db) {
-    char *sql_query = "DELETE FROM entries WHERE uuid = ?";
+repo_return_code delete_all_entries(sqlite3 *db) {
+    char *sql_query = "DELETE FROM entries";
+    char *err_msg = 0;
+
+    if (sqlite3_exec(db, sql_query, NULL, 0, &err_msg) != SQLITE_OK) {
+        sqlite3_free(err_msg);
+        return DATA_BASE_ERR;
+    }
+
+    return OK;
+}
+
+/*
+ * Rebuilds an older entries table as the current one, all or nothing.
+ * Version 1 tables (uuid CHAR(36) on a rowid table) get their uuids converted
+ * to the binary form, version 2 ones are copied as they are.
+ */
+static repo_return_code migrate_entries_table(sqlite3 *db, int version) {
+    char *sql_create_next = "CREATE TABLE entries_next " ENTRIES_TABLE_DEFINITION;
+    char *sql_copy = "INSERT INTO entries_next "
+                     "(uuid, service_blob, username_blob, password_blob, notes_blob, "
+                     "created_at, updated_at) "
+                     "SELECT uuid, service_blob, username_blob, password_blob, notes_blob, "
+                     "created_at, updated_at FROM entries";
+    char *sql_insert = "INSERT INTO entries_next "
+                       "(uuid, service_blob, username_blob, password_blob, notes_blob, "
+                       "created_at, updated_at) VALUES (?, ?, ?, ?, ?, ?, ?)";
+    char *sql_select = "SELECT uuid, service_blob, username_blob, password_blob, notes_blob, "
+                       "created_at, updated_at FROM entries";
+    sqlite3_stmt *select = NULL;
+    sqlite3_stmt *insert = NULL;
+    repo_return_code return_code = DATA_BASE_ERR;
+
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", NULL, NULL, NULL) != SQLITE_OK) {
+        return DATA_BASE_ERR;
+    }
+
+    if (sqlite3_exec(db, sql_create_next, NULL, NULL, NULL) != SQLITE_OK) {
+        goto finish;
+    }
+
+    if (version >= 2) {
+        if (sqlite3_exec(db, sql_copy, NULL, NULL, NULL) != SQLITE_OK) {
+            goto finish;
+        }
+    } else {
+        if (sqlite3_prepare_v2(db, sql_select, -1, &select, NULL) != SQLITE_OK ||
+            sqlite3_prepare_v2(db, sql_insert, -1, &insert, NULL) != SQLITE_OK) {
+            goto finish;
+        }
+
+        int rc;
+        while ((rc = sqlite3_step(select)) == SQLITE_ROW) {
+            uint8_t uuid[UUID_BIN_LEN];
+
+            if (!uuid_from_string((const char *)sqlite3_column_text(select, 0), uuid) ||
+                sqlite3_bind_blob(insert, 1, uuid, UUID_BIN_LEN, SQLITE_TRANSIENT) !=
+                    SQLITE_OK) {
+                goto finish;
+            }
+
+            for (int column = 1; column < 7; column++) {
+                if (sqlite3_bind_value(insert, column + 1,
+                                       sqlite3_column_value(select, column)) != SQLITE_OK) {
+                    goto finish;
+                }
+            }
+
+            if (sqlite3_step(insert) != SQLITE_DONE) {
+                goto finish;
+            }
+            sqlite3_reset(insert);
+        }
+
+        if (rc != SQLITE_DONE) {
+            goto finish;
+        }
+
+        sqlite3_finalize(select);
+        select = NULL;
+    }
+
+    if (sqlite3_exec(db, "DROP TABLE entries;", NULL, NULL, NULL) == SQLITE_OK &&
+        sqlite3_exec(db, "ALTER TABLE entries_next RENAME TO entries;", NULL, NULL, NULL) ==
+            SQLITE_OK &&
+        sqlite3_exec(db, SQL_SET_SCHEMA_VERSION, NULL, NULL, NULL) == SQLITE_OK) {
+        return_code = OK;
+    }
+
+finish:
+    sqlite3_finalize(select);
+    sqlite3_finalize(insert);
+    sqlite3_exec(db, (return_code == OK) ? "COMMIT;" : "ROLLBACK;", NULL, NULL, NULL);
+    return return_code;
+}
+
+/*
+ * Inserts or updates every entry with one statement, batch_size rows per
+ * transaction. A failing row only undoes its own statement and the
+ * transaction goes on, unless SQLite rolled the whole transaction back (I/O
+ * error, full disk). Inside a caller's transaction the rows are simply added
+ * to it.
+ */
+static repo_return_code write_entries(IntVaultEntry *entries, size_t count, size_t batch_size,
+                                      repo_return_code *out_results, sqlite3 *db,
+                                      bool inserting) {
+    bool own_transaction = sqlite3_get_autocommit(db) != 0;
+    repo_return_code return_code = OK;
     sqlite3_stmt *stmt;
+    size_t done = 0;
+
+    if (!batch_size) {
+        batch_size = REPO_DEFAULT_BATCH;
+    }
+
+    if (!(stmt = repo_prepare(db, inserting ? SQL_INSERT_ENTRY : SQL_UPDATE_ENTRY))) {
+        return_code = DATA_BASE_ERR;
+        goto finish;
+    }
+
+    while (done < count) {
+        size_t end = (count - done > batch_size) ? done + batch_size : count;
+
+        if (own_transaction && sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) != SQLITE_OK) {
+            return_code = DATA_BASE_ERR;
+            break;
+        }
 
-    if (sqlite3_prepare_v2(db, sql_query, -1, &stmt, NULL) != SQLITE_OK) {
+        for (size_t i = done; i < end; i++) {
+            repo_return_code row_rc = inserting
+                                          ? insert_row(stmt, &entries[i])
+                                          : update_row(stmt, entries[i].uuid, &entries[i], db);
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+
+            if (out_results) {
+                out_results[i] = row_rc;
+            }
+        }
+
+        if (own_transaction && sqlite3_get_autocommit(db)) {
+            return_code = DATA_BASE_ERR;
+            break;
+        }
+        if (own_transaction && sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+            sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+            return_code = DATA_BASE_ERR;
+            break;
+        }
+        done = end;
+    }
+
+finish:
+    /* rows of a batch that was not committed are not written */
+    for (size_t i = done; out_results && i < count; i++) {
+        out_results[i] = DATA_BASE_ERR;
+    }
+    repo_release(db, stmt);
+    return return_code;
+}
+
+static repo_return_code insert_row(sqlite3_stmt *stmt, const IntVaultEntry *entry) {
+    uint8_t uuid[UUID_BIN_LEN];
+
+    if (!entry->uuid || !uuid_from_string(entry->uuid, uuid)) {
         return DATA_BASE_ERR;
     }
 
-    if (sqlite3_bind_text(stmt, 1, uuid, -1, SQLITE_TRANSIENT) != SQLITE_OK) {
-        sqlite3_finalize(stmt);
+    /* a NULL record binds NULL, as do the field blobs of a packed entry */
+    if (sqlite3_bind_blob(stmt, 1, uuid, UUID_BIN_LEN, SQLITE_TRANSIENT) != SQLITE_OK ||
+        sqlite3_bind_blob(stmt, 2, entry->service_name, (int)entry->service_len,
+                          SQLITE_TRANSIENT) != SQLITE_OK ||
+        sqlite3_bind_blob(stmt, 3, entry->username, (int)entry->username_len,
+                          SQLITE_TRANSIENT) != SQLITE_OK ||
+        sqlite3_bind_blob(stmt, 4, entry->password, (int)entry->password_len,
+                          SQLITE_TRANSIENT) != SQLITE_OK ||
+        bind_optional_blob(stmt, 5, entry->notes, entry->notes_len) != SQLITE_OK ||
+        sqlite3_bind_int64(stmt, 6, (sqlite3_int64)entry->created_at) != SQLITE_OK ||
+        sqlite3_bind_int64(stmt, 7, (sqlite3_int64)entry->updated_at) != SQLITE_OK ||
+        sqlite3_bind_blob(stmt, 8, entry->record, (int)entry->record_len, SQLITE_TRANSIENT) !=
+            SQLITE_OK) {
         return DATA_BASE_ERR;
     }
 
-    int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    return (sqlite3_step(stmt) == SQLITE_DONE) ? OK : DATA_BASE_ERR;
+}
 
-    switch (rc) {
+/* NULL fields keep their stored value */
+static repo_return_code update_row(sqlite3_stmt *stmt, const char *uuid,
+                                   const IntVaultEntry *new_entry, sqlite3 *db) {
+    uint8_t uuid_bytes[UUID_BIN_LEN];
+
+    if (!uuid || !uuid_from_string(uuid, uuid_bytes)) {
+        return NOT_FOUND_ERR;
+    }
+
+    if (bind_optional_blob(stmt, 1, new_entry->service_name, new_entry->service_len) !=
+            SQLITE_OK ||
+        bind_optional_blob(stmt, 2, new_entry->username, new_entry->username_len) != SQLITE_OK ||
+        bind_optional_blob(stmt, 3, new_entry->password, new_entry->password_len) != SQLITE_OK ||
+        bind_optional_blob(stmt, 4, new_entry->notes, new_entry->notes_len) != SQLITE_OK ||
+        sqlite3_bind_int64(stmt, 5, (sqlite3_int64)new_entry->updated_at) != SQLITE_OK ||
+        sqlite3_bind_blob(stmt, 6, uuid_bytes, UUID_BIN_LEN, SQLITE_TRANSIENT) != SQLITE_OK ||
+        bind_optional_blob(stmt, 7, new_entry->record, new_entry->record_len) != SQLITE_OK) {
+        return DATA_BASE_ERR;
+    }
+
+    switch (sqlite3_step(stmt)) {
         case SQLITE_DONE:
             return (sqlite3_changes(db)) ? OK : NOT_FOUND_ERR;
 
@@ -374,14 +596,193 @@ repo_return_code delete_entry(const char *uuid, sqlite3 *db) {
             return REPO_UNEXPECTED_ERR;
     }
 }
-repo_return_code delete_all_entries(sqlite3 *db) {
-    char *sql_query = "DELETE FROM entries";
-    char *err_msg = 0;
 
-    if (sqlite3_exec(db, sql_query, NULL, 0, &err_msg) != SQLITE_OK) {
-        sqlite3_free(err_msg);
+static int bind_optional_blob(sqlite3_stmt *stmt, int index, const uint8_t *data, uint32_t len) {
+    if (!data) {
+        return sqlite3_bind_null(stmt, index);
+    }
+    return sqlite3_bind_blob(stmt, index, data, (int)len, SQLITE_TRANSIENT);
+}
+
+/*
+ * Appends up to limit rows of stmt to out_wrapper. With out_more, one more
+ * step tells whether rows are left past the limit.
+ */
+static repo_return_code collect_rows(sqlite3_stmt *stmt, uint32_t limit, DLinkedList *out_wrapper,
+                                     bool *out_more) {
+    repo_return_code return_code = OK;
+    uint32_t count = 0;
+    int rc = SQLITE_DONE;
+
+    while (count < limit && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        IntVaultEntry *node;
+
+        if ((return_code = read_row_node(stmt, &node)) != OK) {
+            return return_code;
+        }
+
+        if (!dlinked_list_push_back_node(out_wrapper, node)) {
+            free(node);
+            return DATA_STRUCTURE_ERR;
+        }
+        count++;
+    }
+
+    if (count == limit && out_more) {
+        rc = sqlite3_step(stmt);
+        *out_more = rc == SQLITE_ROW;
+    }
+
+    return (rc == SQLITE_ROW || rc == SQLITE_DONE) ? OK : DATA_BASE_ERR;
+}
+
+/* "u:<uuid>" for ENTRY_ORDER_UUID, "r:<updated_at>:<uuid>" for ENTRY_ORDER_RECENT */
+static bool parse_page_token(entry_order order, const char *token, int64_t *out_updated_at,
+                             uint8_t *out_uuid) {
+    if (order == ENTRY_ORDER_UUID) {
+        return strncmp(token, "u:", 2) == 0 && uuid_from_string(token + 2, out_uuid);
+    }
+
+    if (order != ENTRY_ORDER_RECENT || strncmp(token, "r:", 2) != 0) {
+        return false;
+    }
+
+    char *end;
+    errno = 0;
+    long long updated_at = strtoll(token + 2, &end, 10);
+    if (errno || end == token + 2 || *end != ':') {
+        return false;
+    }
+
+    *out_updated_at = (int64_t)updated_at;
+    return uuid_from_string(end + 1, out_uuid);
+}
+
+/*
+ * Lays the uuid string and the blobs of the current row out in a single
+ * block, header_size bytes after its start, and points the entry into it.
+ * NULL and empty blobs leave their field NULL. The field blobs are NULL on
+ * packed rows, record is NULL on older ones.
+ */
+static repo_return_code pack_row(sqlite3_stmt *stmt, size_t header_size, uint8_t **out_block,
+                                 IntVaultEntry *out_entry) {
+    static const int columns[] = {1, 2, 3, 4, 7};
+    const uint8_t *data[5];
+    int lengths[5];
+    size_t size = header_size + UUID_STR_LEN + 1;
+
+    memset(out_entry, 0, sizeof(IntVaultEntry));
+    *out_block = NULL;
+
+    const uint8_t *uuid = sqlite3_column_blob(stmt, 0);
+    if (!uuid || sqlite3_column_bytes(stmt, 0) != UUID_BIN_LEN) {
         return DATA_BASE_ERR;
     }
 
+    for (int i = 0; i < 5; i++) {
+        data[i] = sqlite3_column_blob(stmt, columns[i]);
+        lengths[i] = sqlite3_column_bytes(stmt, columns[i]);
+        if (!data[i] || lengths[i] <= 0) {
+            lengths[i] = 0;
+        }
+        size += (size_t)lengths[i];
+    }
+
+    uint8_t *block = malloc(size);
+    if (!block) {
+        return MEMORY_ERR;
+    }
+
+    uint8_t *cursor = block + header_size;
+    out_entry->uuid = (char *)cursor;
+    uuid_to_string(uuid, out_entry->uuid);
+    cursor += UUID_STR_LEN + 1;
+
+    uint8_t **fields[] = {&out_entry->service_name, &out_entry->username, &out_entry->password,
+                          &out_entry->notes, &out_entry->record};
+    uint32_t *field_lens[] = {&out_entry->service_len, &out_entry->username_len,
+                              &out_entry->password_len, &out_entry->notes_len,
+                              &out_entry->record_len};
+    for (int i = 0; i < 5; i++) {
+        if (lengths[i]) {
+            memcpy(cursor, data[i], (size_t)lengths[i]);
+            *fields[i] = cursor;
+            *field_lens[i] = (uint32_t)lengths[i];
+            cursor += lengths[i];
+        }
+    }
+
+    out_entry->created_at = sqlite3_column_int64(stmt, 5);
+    out_entry->updated_at = sqlite3_column_int64(stmt, 6);
+    *out_block = block;
+    return OK;
+}
+
+/* the block starts with the uuid, freeing it frees the whole entry */
+static repo_return_code read_row(sqlite3_stmt *stmt, IntVaultEntry *out_entry) {
+    uint8_t *block;
+
+    return pack_row(stmt, 0, &block, out_entry);
+}
+
+/* list entries carry their struct at the head of the block */
+static repo_return_code read_row_node(sqlite3_stmt *stmt, IntVaultEntry **out_node) {
+    IntVaultEntry entry;
+    uint8_t *block;
+
+    repo_return_code return_code = pack_row(stmt, sizeof(IntVaultEntry), &block, &entry);
+    if (return_code == OK) {
+        memcpy(block, &entry, sizeof(IntVaultEntry));
+        *out_node = (IntVaultEntry *)block;
+    }
+    return return_code;
+}
+
+/* points the entry at the row's column memory, the uuid string lives in the cursor */
+static repo_return_code borrow_row(EntryCursor *cursor, IntVaultEntry *out_entry) {
+    sqlite3_stmt *stmt = cursor->stmt;
+    const uint8_t *uuid = sqlite3_column_blob(stmt, 0);
+
+    memset(out_entry, 0, sizeof(IntVaultEntry));
+    if (!uuid || sqlite3_column_bytes(stmt, 0) != UUID_BIN_LEN) {
+        return DATA_BASE_ERR;
+    }
+    uuid_to_string(uuid, cursor->uuid);
+    out_entry->uuid = cursor->uuid;
+
+    borrow_column(stmt, 1, &out_entry->service_name, &out_entry->service_len);
+    borrow_column(stmt, 2, &out_entry->username, &out_entry->username_len);
+    borrow_column(stmt, 3, &out_entry->password, &out_entry->password_len);
+    borrow_column(stmt, 4, &out_entry->notes, &out_entry->notes_len);
+    borrow_column(stmt, 7, &out_entry->record, &out_entry->record_len);
+    out_entry->created_at = sqlite3_column_int64(stmt, 5);
+    out_entry->updated_at = sqlite3_column_int64(stmt, 6);
     return OK;
 }
+
+/* same NULL and empty handling as pack_row() */
+static void borrow_column(sqlite3_stmt *stmt, int column, uint8_t **out_data, uint32_t *out_len) {
+    const uint8_t *data = sqlite3_column_blob(stmt, column);
+    int len = sqlite3_column_bytes(stmt, column);
+
+    *out_data = (data && len > 0) ? (uint8_t *)data : NULL;
+    *out_len = (data && len > 0) ? (uint32_t)len : 0;
+}
+
+static bool entries_table_exists(sqlite3 *db) {
+    sqlite3_stmt *stmt;
+    bool exists = false;
+
+    if (sqlite3_prepare_v2(db,
+                           "SELECT count(*) FROM sqlite_master WHERE type='table' AND "
+                           "name='entries'",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        return false;
+    }
+
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        exists = sqlite3_column_int(stmt, 0) > 0;
+    }
+    sqlite3_finalize(stmt);
+    return exists;
+}
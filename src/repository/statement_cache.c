@@ -0,0 +1,153 @@
+#include <CVault/repository/statement_cache.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char *sql;
+    sqlite3_stmt *stmt;
+    bool in_use;
+} CachedStatement;
+
+typedef struct StatementCache {
+    sqlite3 *db;
+    CachedStatement slots[REPO_STATEMENT_CACHE_SLOTS];
+    uint32_t used;
+    uint64_t hits;
+    uint64_t misses;
+    struct StatementCache *next;
+} StatementCache;
+
+/* one cache per connection, the list and every cache are guarded by caches_lock */
+static StatementCache *caches = NULL;
+static pthread_mutex_t caches_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static StatementCache *find_cache(sqlite3 *db, bool create);
+
+sqlite3_stmt *repo_prepare(sqlite3 *db, const char *sql) {
+    sqlite3_stmt *stmt = NULL;
+
+    pthread_mutex_lock(&caches_lock);
+    StatementCache *cache = find_cache(db, true);
+    if (cache) {
+        for (uint32_t i = 0; i < cache->used; i++) {
+            CachedStatement *slot = &cache->slots[i];
+
+            if (!slot->in_use && strcmp(slot->sql, sql) == 0) {
+                slot->in_use = true;
+                cache->hits++;
+                pthread_mutex_unlock(&caches_lock);
+                return slot->stmt;
+            }
+        }
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&caches_lock);
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+
+    /* kept when a slot is left, otherwise finalized by repo_release() */
+    pthread_mutex_lock(&caches_lock);
+    cache = find_cache(db, false);
+    if (cache && cache->used < REPO_STATEMENT_CACHE_SLOTS) {
+        CachedStatement *slot = &cache->slots[cache->used];
+
+        if ((slot->sql = strdup(sql))) {
+            slot->stmt = stmt;
+            slot->in_use = true;
+            cache->used++;
+        }
+    }
+    pthread_mutex_unlock(&caches_lock);
+
+    return stmt;
+}
+
+void repo_release(sqlite3 *db, sqlite3_stmt *stmt) {
+    if (!stmt) {
+        return;
+    }
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    pthread_mutex_lock(&caches_lock);
+    StatementCache *cache = find_cache(db, false);
+    for (uint32_t i = 0; cache && i < cache->used; i++) {
+        if (cache->slots[i].stmt == stmt) {
+            cache->slots[i].in_use = false;
+            pthread_mutex_unlock(&caches_lock);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&caches_lock);
+
+    sqlite3_finalize(stmt);
+}
+
+void repo_statement_stats(sqlite3 *db, RepoStatementStats *out_stats) {
+    memset(out_stats, 0, sizeof(RepoStatementStats));
+
+    pthread_mutex_lock(&caches_lock);
+    StatementCache *cache = find_cache(db, false);
+    if (cache) {
+        out_stats->hits = cache->hits;
+        out_stats->misses = cache->misses;
+        out_stats->cached = cache->used;
+    }
+    pthread_mutex_unlock(&caches_lock);
+}
+
+int repo_close(sqlite3 *db) {
+    if (!db) {
+        return SQLITE_OK;
+    }
+
+    pthread_mutex_lock(&caches_lock);
+    StatementCache **link = &caches;
+    while (*link && (*link)->db != db) {
+        link = &(*link)->next;
+    }
+
+    StatementCache *cache = *link;
+    if (cache) {
+        *link = cache->next;
+    }
+    pthread_mutex_unlock(&caches_lock);
+
+    if (cache) {
+        for (uint32_t i = 0; i < cache->used; i++) {
+            sqlite3_finalize(cache->slots[i].stmt);
+            free(cache->slots[i].sql);
+        }
+        free(cache);
+    }
+
+    return sqlite3_close(db);
+}
+
+/* moves the cache of db to the front, callers hold caches_lock */
+static StatementCache *find_cache(sqlite3 *db, bool create) {
+    StatementCache **link = &caches;
+
+    while (*link && (*link)->db != db) {
+        link = &(*link)->next;
+    }
+
+    StatementCache *cache = *link;
+    if (cache) {
+        *link = cache->next;
+    } else if (!create || !(cache = calloc(1, sizeof(StatementCache)))) {
+        return NULL;
+    } else {
+        cache->db = db;
+    }
+
+    cache->next = caches;
+    caches = cache;
+    return cache;
+}
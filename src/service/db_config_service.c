@@ -117,5 +117,5 @@ bool service_delete_all_configs() {
 }
 
 bool close_config_service() {
-    return sqlite3_close(db) == SQLITE_OK;
+    return repo_close(db) == SQLITE_OK;
 }
@@ -88,6 +88,27 @@ bool is_init_schema() {
     return valid;
 }
 
+bool open_vault_db(sqlite3 **out_db) {
+    if (!out_db) {
+        return false;
+    }
+
+    *out_db = NULL;
+    if (!open_db_file(db_vault_path, out_db)) {
+        repo_close(*out_db);
+        *out_db = NULL;
+        return false;
+    }
+
+    if (!table_exists(*out_db, "entries")) {
+        close_db_file(*out_db);
+        *out_db = NULL;
+        return false;
+    }
+
+    return true;
+}
+
 static bool open_db_file(char *path, sqlite3 **db) {
     if (!path) {
         return false;
@@ -100,7 +121,7 @@ static bool open_db_file(char *path, sqlite3 **db) {
 }
 
 static bool close_db_file(sqlite3 *db) {
-    if (sqlite3_close(db)) {
+    if (repo_close(db)) {
         return false;
     }
     return true;
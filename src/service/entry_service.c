@@ -0,0 +1,526 @@
+#include <CVault/crypto/crypto_core.h>
+#include <CVault/repository/repository.h>
+#include <CVault/service/entry_service.h>
+#include <CVault/utils/secret_arena.h>
+#include <CVault/utils/security_utils.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* shared by the decode workers, each entry index is claimed exactly once */
+typedef struct {
+    const IntVaultEntry **rows;
+    ExtVaultEntry *out;
+    size_t count;
+    const uint8_t *key;
+    SecretArena *arena;
+    atomic_size_t next;
+    atomic_int error;
+    atomic_uint_fast64_t bytes;
+} DecodeJob;
+
+es_return_code es_status = 0;
+
+static uint32_t worker_count(uint32_t requested, size_t count);
+static void *decode_worker(void *arg);
+static bool decode_entry(AeadContext *aead, const IntVaultEntry *row, SecretArena *arena,
+                         ExtVaultEntry *out);
+static bool decrypt_fields(AeadContext *aead, const IntVaultEntry *row, SecretArena *arena,
+                           ExtVaultEntry *out);
+static bool decrypt_record(AeadContext *aead, const IntVaultEntry *row, SecretArena *arena,
+                           ExtVaultEntry *out);
+static bool decrypt_field(AeadContext *aead, const uint8_t *blob, uint32_t blob_len,
+                          SecretArena *arena, char **out_text);
+static bool record_ad(uint8_t version, const char *uuid, uint8_t *out_ad);
+static char *copy_text(const uint8_t *data, size_t len);
+static uint64_t entry_text_len(const ExtVaultEntry *entry);
+static void write_u32_le(uint8_t *out, uint32_t value);
+static uint32_t read_u32_le(const uint8_t *in);
+static void free_text(char *text);
+
+bool decrypt_entries(const DLinkedList *entries, const uint8_t *key, uint32_t workers,
+                     SecretArena *arena, ExtVaultEntry **out_entries, DecodeStats *out_stats) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (!entries || !key || !out_entries) {
+        es_status = ES_DECRYPT_ERR;
+        return false;
+    }
+    *out_entries = NULL;
+
+    size_t count = (size_t)entries->size;
+    DecodeJob job = {.count = count, .key = key, .arena = arena};
+    SecretArenaMark mark = secret_arena_mark(arena);
+    pthread_t threads[ENTRY_MAX_WORKERS];
+    uint32_t spawned = 0;
+
+    atomic_init(&job.next, 0);
+    atomic_init(&job.error, ES_SUCCESS);
+    atomic_init(&job.bytes, 0);
+
+    if (count) {
+        job.rows = malloc(count * sizeof(*job.rows));
+        job.out = arena ? secret_arena_alloc(arena, count * sizeof(ExtVaultEntry))
+                        : calloc(count, sizeof(ExtVaultEntry));
+        if (!job.rows || !job.out) {
+            free(job.rows);
+            if (!arena) {
+                free(job.out);
+            }
+            es_status = ES_MEMORY_ERR;
+            return false;
+        }
+
+        size_t i = 0;
+        for (DLinkedListNode *node = entries->head; node && i < count; node = node->next) {
+            job.rows[i++] = node->data;
+        }
+        if (i != count) {
+            free(job.rows);
+            if (arena) {
+                secret_arena_rewind(arena, mark);
+            } else {
+                free(job.out);
+            }
+            es_status = ES_DECRYPT_ERR;
+            return false;
+        }
+
+        workers = worker_count(workers, count);
+
+        /* the caller is a worker too, a failed spawn only lowers the fan-out */
+        while (spawned + 1 < workers &&
+               pthread_create(&threads[spawned], NULL, decode_worker, &job) == 0) {
+            spawned++;
+        }
+        decode_worker(&job);
+
+        for (uint32_t t = 0; t < spawned; t++) {
+            pthread_join(threads[t], NULL);
+        }
+    }
+
+    es_return_code error = (es_return_code)atomic_load(&job.error);
+    free(job.rows);
+
+    if (error != ES_SUCCESS) {
+        if (arena) {
+            secret_arena_rewind(arena, mark);
+        } else {
+            free_ext_entries(job.out, count);
+        }
+        es_status = error;
+        return false;
+    }
+
+    if (out_stats) {
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        out_stats->entries = count;
+        out_stats->bytes = atomic_load(&job.bytes);
+        out_stats->workers = count ? spawned + 1 : 0;
+        out_stats->elapsed_ms = (double)(end.tv_sec - start.tv_sec) * 1e3 +
+                                (double)(end.tv_nsec - start.tv_nsec) / 1e6;
+        out_stats->mib_per_s = (out_stats->elapsed_ms > 0)
+                                   ? (double)out_stats->bytes / (1024.0 * 1024.0) /
+                                         (out_stats->elapsed_ms / 1e3)
+                                   : 0;
+    }
+
+    *out_entries = job.out;
+    es_status = ES_SUCCESS;
+    return true;
+}
+
+bool encrypt_entry(AeadContext *aead, const ExtVaultEntry *entry, IntVaultEntry *out_row) {
+    uint8_t ad[1 + UUID_BIN_LEN];
+
+    if (!aead || !entry || !out_row) {
+        return false;
+    }
+    memset(out_row, 0, sizeof(IntVaultEntry));
+
+    if (!entry->service_name || !entry->username || !entry->password ||
+        !record_ad(ENTRY_RECORD_VERSION_02, entry->uuid, ad)) {
+        return false;
+    }
+
+    const char *fields[] = {entry->service_name, entry->username, entry->password, entry->notes};
+    size_t lengths[4];
+    size_t plaintext_len = ENTRY_RECORD_LENGTHS_SIZE;
+
+    for (int i = 0; i < 4; i++) {
+        lengths[i] = fields[i] ? strlen(fields[i]) : 0;
+        if (lengths[i] >= ENTRY_RECORD_NO_NOTES) {
+            return false;
+        }
+        plaintext_len += lengths[i];
+    }
+    if (plaintext_len > UINT32_MAX - ENTRY_RECORD_OVERHEAD) {
+        return false;
+    }
+
+    /* the row is one block: the uuid string, then the record */
+    size_t uuid_size = strlen(entry->uuid) + 1;
+    size_t record_len = 1 + plaintext_len + TAGGED_BLOB_OVERHEAD;
+    uint8_t *plaintext = malloc(plaintext_len);
+    uint8_t *block = malloc(uuid_size + record_len);
+    if (!plaintext || !block) {
+        free(plaintext);
+        free(block);
+        return false;
+    }
+    uint8_t *record = block + uuid_size;
+
+    uint8_t *cursor = plaintext + ENTRY_RECORD_LENGTHS_SIZE;
+    for (int i = 0; i < 4; i++) {
+        write_u32_le(plaintext + 4 * i, fields[i] ? (uint32_t)lengths[i] : ENTRY_RECORD_NO_NOTES);
+        memcpy(cursor, fields[i] ? fields[i] : "", lengths[i]);
+        cursor += lengths[i];
+    }
+
+    record[0] = ENTRY_RECORD_VERSION_02;
+    bool sealed = aead_seal_tagged(aead, ad, sizeof(ad), plaintext, plaintext_len, record + 1);
+
+    secure_memset(plaintext, plaintext_len);
+    free(plaintext);
+
+    if (!sealed) {
+        free(block);
+        return false;
+    }
+
+    out_row->uuid = memcpy(block, entry->uuid, uuid_size);
+    out_row->record = record;
+    out_row->record_len = (uint32_t)record_len;
+    out_row->created_at = entry->created_at;
+    out_row->updated_at = entry->updated_at;
+    return true;
+}
+
+bool decrypt_entry(AeadContext *aead, const IntVaultEntry *row, ExtVaultEntry *out_entry) {
+    return decode_entry(aead, row, NULL, out_entry);
+}
+
+bool load_entry(sqlite3 *db, AeadContext *aead, const char *uuid, ExtVaultEntry *out_entry) {
+    IntVaultEntry row = {0};
+    bool return_code = false;
+
+    if (!db || !aead || !uuid || !out_entry) {
+        es_status = ES_DECRYPT_ERR;
+        return false;
+    }
+
+    switch (read_entry(uuid, &row, db)) {
+        case OK:
+            break;
+        case NOT_FOUND_ERR:
+            es_status = ES_NOT_FOUND;
+            return false;
+        case MEMORY_ERR:
+            es_status = ES_MEMORY_ERR;
+            goto finish;
+        default:
+            es_status = ES_DB_ERR;
+            goto finish;
+    }
+
+    if (!decrypt_entry(aead, &row, out_entry)) {
+        es_status = ES_DECRYPT_ERR;
+        goto finish;
+    }
+
+    /* lazy migration, the entry was read either way */
+    if (!row.record || row.record[0] == ENTRY_RECORD_VERSION_01) {
+        IntVaultEntry packed;
+        if (encrypt_entry(aead, out_entry, &packed)) {
+            update_entry(uuid, &packed, db);
+            free_int_entry(&packed);
+        }
+    }
+
+    es_status = ES_SUCCESS;
+    return_code = true;
+
+finish:
+    free_int_entry(&row);
+    return return_code;
+}
+
+void free_ext_entry(ExtVaultEntry *entry) {
+    if (!entry) {
+        return;
+    }
+
+    free(entry->uuid);
+    free_text(entry->service_name);
+    free_text(entry->username);
+    free_text(entry->password);
+    free_text(entry->notes);
+    memset(entry, 0, sizeof(ExtVaultEntry));
+}
+
+void free_ext_entries(ExtVaultEntry *entries, size_t count) {
+    if (!entries) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        free_ext_entry(&entries[i]);
+    }
+    free(entries);
+}
+
+static uint32_t worker_count(uint32_t requested, size_t count) {
+    if (!requested) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        requested = (online > 0) ? (uint32_t)online : 1;
+    }
+    if (requested > ENTRY_MAX_WORKERS) {
+        requested = ENTRY_MAX_WORKERS;
+    }
+
+    /* a thread without a whole chunk to work on costs more than it saves */
+    size_t chunks = (count + ENTRY_DECODE_CHUNK - 1) / ENTRY_DECODE_CHUNK;
+    if (requested > chunks) {
+        requested = (uint32_t)chunks;
+    }
+    return requested ? requested : 1;
+}
+
+static void *decode_worker(void *arg) {
+    DecodeJob *job = arg;
+    uint64_t bytes = 0;
+
+    AeadContext *aead = aead_context_new(job->key);
+    if (!aead) {
+        atomic_store(&job->error, ES_MEMORY_ERR);
+        return NULL;
+    }
+
+    while (atomic_load(&job->error) == ES_SUCCESS) {
+        size_t first = atomic_fetch_add(&job->next, ENTRY_DECODE_CHUNK);
+        if (first >= job->count) {
+            break;
+        }
+
+        size_t last = first + ENTRY_DECODE_CHUNK;
+        if (last > job->count) {
+            last = job->count;
+        }
+
+        for (size_t i = first; i < last; i++) {
+            if (!decode_entry(aead, job->rows[i], job->arena, &job->out[i])) {
+                atomic_store(&job->error, ES_DECRYPT_ERR);
+                break;
+            }
+            bytes += entry_text_len(&job->out[i]);
+        }
+    }
+
+    atomic_fetch_add(&job->bytes, bytes);
+    aead_context_free(aead);
+    return NULL;
+}
+
+/* with an arena every field lands in it, on failure out is zeroed and the arena keeps the bytes */
+static bool decode_entry(AeadContext *aead, const IntVaultEntry *row, SecretArena *arena,
+                         ExtVaultEntry *out) {
+    if (!aead || !row || !out) {
+        return false;
+    }
+    memset(out, 0, sizeof(ExtVaultEntry));
+
+    if (!row->uuid) {
+        return false;
+    }
+    out->uuid = arena ? secret_arena_strndup(arena, row->uuid, strlen(row->uuid))
+                      : strdup(row->uuid);
+    if (!out->uuid) {
+        return false;
+    }
+    out->created_at = row->created_at;
+    out->updated_at = row->updated_at;
+
+    bool decrypted = row->record ? decrypt_record(aead, row, arena, out)
+                                 : decrypt_fields(aead, row, arena, out);
+    if (!decrypted) {
+        if (arena) {
+            memset(out, 0, sizeof(ExtVaultEntry));
+        } else {
+            free_ext_entry(out);
+        }
+    }
+    return decrypted;
+}
+
+/* per-field blobs, the format of rows written before packed records */
+static bool decrypt_fields(AeadContext *aead, const IntVaultEntry *row, SecretArena *arena,
+                           ExtVaultEntry *out) {
+    if (!decrypt_field(aead, row->service_name, row->service_len, arena, &out->service_name) ||
+        !decrypt_field(aead, row->username, row->username_len, arena, &out->username) ||
+        !decrypt_field(aead, row->password, row->password_len, arena, &out->password)) {
+        return false;
+    }
+
+    return !row->notes || decrypt_field(aead, row->notes, row->notes_len, arena, &out->notes);
+}
+
+/*
+ * With an arena the record opens straight into it and the fields are moved
+ * down over the lengths, each followed by its NUL: four NULs never catch up
+ * with the 16 bytes of lengths, so no field is overwritten before it moves.
+ */
+static bool decrypt_record(AeadContext *aead, const IntVaultEntry *row, SecretArena *arena,
+                           ExtVaultEntry *out) {
+    uint8_t ad[1 + UUID_BIN_LEN];
+    uint8_t version = row->record_len ? row->record[0] : 0;
+    size_t overhead;
+
+    /* version 01 is an untagged AES-256-GCM blob, 02 names its cipher */
+    switch (version) {
+        case ENTRY_RECORD_VERSION_01:
+            overhead = BLOB_OVERHEAD;
+            break;
+        case ENTRY_RECORD_VERSION_02:
+            overhead = TAGGED_BLOB_OVERHEAD;
+            break;
+        default:
+            return false;
+    }
+
+    if (row->record_len < 1 + overhead + ENTRY_RECORD_LENGTHS_SIZE ||
+        !record_ad(version, row->uuid, ad)) {
+        return false;
+    }
+
+    size_t plaintext_len = row->record_len - 1 - overhead;
+    uint8_t *plaintext = arena ? secret_arena_alloc(arena, plaintext_len) : malloc(plaintext_len);
+    if (!plaintext) {
+        return false;
+    }
+
+    bool return_code = false;
+    bool opened = (version == ENTRY_RECORD_VERSION_01)
+                      ? aead_decrypt_ad(aead, ad, sizeof(ad), row->record + 1,
+                                        row->record_len - 1, plaintext)
+                      : aead_open_tagged(aead, ad, sizeof(ad), row->record + 1,
+                                         row->record_len - 1, plaintext);
+    if (!opened) {
+        goto finish;
+    }
+
+    char **fields[] = {&out->service_name, &out->username, &out->password, &out->notes};
+    const uint8_t *cursor = plaintext + ENTRY_RECORD_LENGTHS_SIZE;
+    size_t left = plaintext_len - ENTRY_RECORD_LENGTHS_SIZE;
+    size_t placed = 0;
+    uint32_t lengths[4];
+
+    for (int i = 0; i < 4; i++) {
+        lengths[i] = read_u32_le(plaintext + 4 * i);
+    }
+
+    for (int i = 0; i < 4; i++) {
+        uint32_t len = lengths[i];
+
+        if (i == 3 && len == ENTRY_RECORD_NO_NOTES) {
+            break;
+        }
+        if (len > left) {
+            goto finish;
+        }
+        if (arena) {
+            char *text = memmove(plaintext + placed, cursor, len);
+            text[len] = '\0';
+            *fields[i] = text;
+            placed += len + 1;
+        } else if (!(*fields[i] = copy_text(cursor, len))) {
+            goto finish;
+        }
+        cursor += len;
+        left -= len;
+    }
+    return_code = (left == 0);
+
+finish:
+    if (arena) {
+        /* what is left past the fields, the whole block if the record is rejected */
+        size_t kept = return_code ? placed : 0;
+        secure_memset(plaintext + kept, plaintext_len - kept);
+        return return_code;
+    }
+    secure_memset(plaintext, plaintext_len);
+    free(plaintext);
+    return return_code;
+}
+
+static bool decrypt_field(AeadContext *aead, const uint8_t *blob, uint32_t blob_len,
+                          SecretArena *arena, char **out_text) {
+    if (!blob || blob_len < BLOB_OVERHEAD) {
+        return false;
+    }
+
+    size_t text_len = blob_len - BLOB_OVERHEAD;
+    char *text = arena ? secret_arena_alloc(arena, text_len + 1) : malloc(text_len + 1);
+    if (!text) {
+        return false;
+    }
+
+    if (!aead_decrypt(aead, blob, blob_len, (uint8_t *)text)) {
+        if (arena) {
+            secure_memset(text, text_len);
+        } else {
+            free(text);
+        }
+        return false;
+    }
+
+    text[text_len] = '\0';
+    *out_text = text;
+    return true;
+}
+
+/* associated data of a record: its version byte then the uuid bytes */
+static bool record_ad(uint8_t version, const char *uuid, uint8_t *out_ad) {
+    out_ad[0] = version;
+    return uuid_from_string(uuid, out_ad + 1);
+}
+
+static char *copy_text(const uint8_t *data, size_t len) {
+    char *text = malloc(len + 1);
+
+    if (text) {
+        memcpy(text, data, len);
+        text[len] = '\0';
+    }
+    return text;
+}
+
+static uint64_t entry_text_len(const ExtVaultEntry *entry) {
+    return strlen(entry->service_name) + strlen(entry->username) + strlen(entry->password) +
+           (entry->notes ? strlen(entry->notes) : 0);
+}
+
+static void write_u32_le(uint8_t *out, uint32_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t read_u32_le(const uint8_t *in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) |
+           ((uint32_t)in[3] << 24);
+}
+
+static void free_text(char *text) {
+    if (text) {
+        secure_memset(text, strlen(text));
+        free(text);
+    }
+}
@@ -0,0 +1,237 @@
+#include <CVault/repository/repository.h>
+#include <CVault/service/db_config_service.h>
+#include <CVault/service/kdf_service.h>
+#include <CVault/utils/security_utils.h>
+#include <stdlib.h>
+#include <string.h>
+
+kdf_return_code kdf_status = 0;
+
+static void write_u32_le(uint8_t *out, uint32_t value);
+static uint32_t read_u32_le(const uint8_t *in);
+static bool store_params(const KdfParams *params);
+static bool store_record(char *key, uint8_t *record, size_t record_len);
+
+bool calibrate_kdf_service(uint32_t target_ms, uint64_t mem_budget_kib, KdfParams *out_params) {
+    KdfParams params;
+
+    if (!target_ms) {
+        target_ms = KDF_DEFAULT_TARGET_MS;
+    }
+
+    if (!calibrate_kdf(target_ms, mem_budget_kib, &params)) {
+        kdf_status = KDF_CALIBRATION_ERR;
+        return false;
+    }
+
+    if (!store_params(&params)) {
+        kdf_status = KDF_CONFIG_ERR;
+        return false;
+    }
+
+    if (!set_kdf_params(&params)) {
+        kdf_status = KDF_CALIBRATION_ERR;
+        return false;
+    }
+
+    if (out_params) {
+        *out_params = params;
+    }
+
+    kdf_status = KDF_SUCCESS;
+    return true;
+}
+
+bool load_kdf_service() {
+    Config record = {0};
+
+    if (!service_read_config(KDF_PARAMS_CONFIG_KEY, &record)) {
+        /* nothing recorded yet (or unreadable), keep the defaults */
+        free(record.config_key);
+        free(record.config_value);
+        kdf_status = KDF_SUCCESS;
+        return true;
+    }
+
+    bool return_code = true;
+
+    /* the version byte first, then the size of that version */
+    if (!record.config_value || record.config_value_len < 1) {
+        kdf_status = KDF_CORRUPTED_ERR;
+        return_code = false;
+        goto finish;
+    }
+
+    if (record.config_value[0] != KDF_PARAMS_RECORD_VERSION_01) {
+        kdf_status = KDF_UNSUPPORTED_VER_ERR;
+        return_code = false;
+        goto finish;
+    }
+
+    if (record.config_value_len != KDF_PARAMS_RECORD_SIZE_V01) {
+        kdf_status = KDF_CORRUPTED_ERR;
+        return_code = false;
+        goto finish;
+    }
+
+    KdfParams params = {.t_cost = read_u32_le(record.config_value + 1),
+                        .m_cost = read_u32_le(record.config_value + 5),
+                        .p_cost = read_u32_le(record.config_value + 9)};
+
+    if (!set_kdf_params(&params)) {
+        kdf_status = KDF_CORRUPTED_ERR;
+        return_code = false;
+        goto finish;
+    }
+
+    kdf_status = KDF_SUCCESS;
+
+finish:
+    free(record.config_key);
+    free(record.config_value);
+    return return_code;
+}
+
+bool new_kdf_descriptor(KdfDescriptor *out_kdf) {
+    if (!out_kdf) {
+        return false;
+    }
+
+    out_kdf->algorithm = KDF_ALG_ARGON2ID;
+    out_kdf->out_len = MAT_KEY_LEN;
+    get_kdf_params(&out_kdf->params);
+
+    return random_raw_bytes(SALT_LEN, out_kdf->salt) == SUCCESS;
+}
+
+bool is_outdated_kdf_descriptor(const KdfDescriptor *kdf) {
+    KdfParams target;
+
+    if (!kdf) {
+        return false;
+    }
+
+    get_kdf_params(&target);
+
+    return kdf->algorithm != KDF_ALG_ARGON2ID || kdf->params.t_cost != target.t_cost ||
+           kdf->params.m_cost != target.m_cost || kdf->params.p_cost != target.p_cost;
+}
+
+bool encode_kdf_descriptor(const KdfDescriptor *kdf, uint8_t *out_record) {
+    if (!out_record || !is_valid_kdf_descriptor(kdf)) {
+        return false;
+    }
+
+    out_record[0] = KDF_DESCRIPTOR_RECORD_VERSION_01;
+    out_record[1] = kdf->algorithm;
+    write_u32_le(out_record + 2, kdf->params.t_cost);
+    write_u32_le(out_record + 6, kdf->params.m_cost);
+    write_u32_le(out_record + 10, kdf->params.p_cost);
+    write_u32_le(out_record + 14, kdf->out_len);
+    memcpy(out_record + 18, kdf->salt, SALT_LEN);
+
+    return true;
+}
+
+bool decode_kdf_descriptor(const uint8_t *record, size_t record_len, KdfDescriptor *out_kdf) {
+    if (!record || !record_len || !out_kdf) {
+        kdf_status = KDF_CORRUPTED_ERR;
+        return false;
+    }
+
+    if (record[0] != KDF_DESCRIPTOR_RECORD_VERSION_01) {
+        kdf_status = KDF_UNSUPPORTED_VER_ERR;
+        return false;
+    }
+
+    if (record_len != KDF_DESCRIPTOR_RECORD_SIZE_V01) {
+        kdf_status = KDF_CORRUPTED_ERR;
+        return false;
+    }
+
+    out_kdf->algorithm = record[1];
+    out_kdf->params.t_cost = read_u32_le(record + 2);
+    out_kdf->params.m_cost = read_u32_le(record + 6);
+    out_kdf->params.p_cost = read_u32_le(record + 10);
+    out_kdf->out_len = read_u32_le(record + 14);
+    memcpy(out_kdf->salt, record + 18, SALT_LEN);
+
+    if (!is_valid_kdf_descriptor(out_kdf)) {
+        kdf_status = KDF_CORRUPTED_ERR;
+        return false;
+    }
+
+    kdf_status = KDF_SUCCESS;
+    return true;
+}
+
+bool read_kdf_descriptor_service(KdfDescriptor *out_kdf) {
+    Config record = {0};
+
+    if (!out_kdf) {
+        kdf_status = KDF_CORRUPTED_ERR;
+        return false;
+    }
+
+    if (!service_read_config(KDF_DESCRIPTOR_CONFIG_KEY, &record)) {
+        kdf_status = KDF_CONFIG_ERR;
+        return false;
+    }
+
+    bool return_code =
+        decode_kdf_descriptor(record.config_value, record.config_value_len, out_kdf);
+
+    free(record.config_key);
+    free(record.config_value);
+    return return_code;
+}
+
+bool store_kdf_descriptor_service(const KdfDescriptor *kdf) {
+    uint8_t record[KDF_DESCRIPTOR_RECORD_SIZE_V01];
+
+    if (!encode_kdf_descriptor(kdf, record)) {
+        kdf_status = KDF_CORRUPTED_ERR;
+        return false;
+    }
+
+    if (!store_record(KDF_DESCRIPTOR_CONFIG_KEY, record, sizeof(record))) {
+        kdf_status = KDF_CONFIG_ERR;
+        return false;
+    }
+
+    kdf_status = KDF_SUCCESS;
+    return true;
+}
+
+static bool store_params(const KdfParams *params) {
+    uint8_t record[KDF_PARAMS_RECORD_SIZE_V01];
+
+    record[0] = KDF_PARAMS_RECORD_VERSION_01;
+    write_u32_le(record + 1, params->t_cost);
+    write_u32_le(record + 5, params->m_cost);
+    write_u32_le(record + 9, params->p_cost);
+
+    return store_record(KDF_PARAMS_CONFIG_KEY, record, sizeof(record));
+}
+
+/* replaces the record stored under key, adds it when missing */
+static bool store_record(char *key, uint8_t *record, size_t record_len) {
+    if (service_update_config(key, record, record_len)) {
+        return true;
+    }
+
+    Config config = {.config_key = key, .config_value = record, .config_value_len = record_len};
+
+    return service_add_config(&config);
+}
+
+static void write_u32_le(uint8_t *out, uint32_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t read_u32_le(const uint8_t *in) {
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
@@ -0,0 +1,388 @@
+#include <CVault/crypto/crypto_core.h>
+#include <CVault/repository/repository.h>
+#include <CVault/service/entry_service.h>
+#include <CVault/service/rekey_service.h>
+#include <CVault/utils/security_utils.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* a page goes FREE -> READ (reader) -> SEALING -> SEALED (worker) -> FREE (writer) */
+typedef enum { PAGE_FREE = 0, PAGE_READ, PAGE_SEALING, PAGE_SEALED } page_state;
+
+typedef struct {
+    page_state state;
+    uint64_t seq;
+    DLinkedList *rows;     /* IntVaultEntry* as read, dropped once sealed */
+    IntVaultEntry *sealed; /* packed rows in page order, uuid NULL when skipped */
+    size_t count;
+    uint64_t skipped;
+    char last_uuid[UUID_STR_LEN + 1];
+} RekeyPage;
+
+/* everything below lock is only touched with it held */
+typedef struct {
+    sqlite3 *db;
+    const uint8_t *old_key;
+    const uint8_t *new_key;
+    uint8_t cipher;
+    uint32_t batch_size;
+    const char *resume_after;
+
+    pthread_mutex_t db_lock;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    RekeyPage *pages;
+    size_t page_count;
+    uint64_t next_read;
+    bool read_done;
+    rk_return_code error;
+} RekeyJob;
+
+rk_return_code rk_status = 0;
+
+static uint32_t worker_count(uint32_t requested);
+static void *reader_stage(void *arg);
+static void *seal_stage(void *arg);
+static bool write_page(RekeyJob *job, RekeyPage *page);
+static rk_return_code seal_page(AeadContext *old_aead, AeadContext *new_aead, RekeyPage *page);
+static RekeyPage *find_page(RekeyJob *job, page_state state, uint64_t seq, bool any_seq);
+static void fail(RekeyJob *job, rk_return_code error);
+static void clear_page(RekeyPage *page);
+static double elapsed_ms(struct timespec start);
+
+bool rekey_entries(sqlite3 *db, const uint8_t *old_key, const uint8_t *new_key, uint8_t cipher,
+                   const RekeyOptions *options, RekeyStats *out_stats) {
+    RekeyOptions defaults = {0};
+    RekeyStats stats = {0};
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (!db || !old_key || !new_key || !is_valid_cipher(cipher)) {
+        rk_status = RK_ENCRYPT_ERR;
+        return false;
+    }
+    if (!options) {
+        options = &defaults;
+    }
+
+    uint32_t workers = worker_count(options->workers);
+    RekeyJob job = {.db = db,
+                    .old_key = old_key,
+                    .new_key = new_key,
+                    .cipher = cipher,
+                    .batch_size = options->batch_size ? options->batch_size : REKEY_DEFAULT_BATCH,
+                    .resume_after = options->resume_after,
+                    .page_count = workers + REKEY_QUEUE_DEPTH,
+                    .error = RK_SUCCESS};
+
+    job.pages = calloc(job.page_count, sizeof(RekeyPage));
+    if (!job.pages) {
+        rk_status = RK_MEMORY_ERR;
+        return false;
+    }
+    pthread_mutex_init(&job.db_lock, NULL);
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.changed, NULL);
+
+    pthread_t reader;
+    pthread_t sealers[REKEY_MAX_WORKERS];
+    uint32_t spawned = 0;
+    bool reading = pthread_create(&reader, NULL, reader_stage, &job) == 0;
+
+    while (reading && spawned < workers &&
+           pthread_create(&sealers[spawned], NULL, seal_stage, &job) == 0) {
+        spawned++;
+    }
+    if (!reading || !spawned) {
+        fail(&job, RK_MEMORY_ERR);
+    }
+    stats.workers = spawned;
+
+    /* the writer: commits pages in read order so the checkpoint only moves forward */
+    for (uint64_t next_write = 0;; next_write++) {
+        pthread_mutex_lock(&job.lock);
+        RekeyPage *page;
+        while (!(page = find_page(&job, PAGE_SEALED, next_write, false)) &&
+               job.error == RK_SUCCESS && !(job.read_done && next_write == job.next_read)) {
+            pthread_cond_wait(&job.changed, &job.lock);
+        }
+        bool stop = !page || job.error != RK_SUCCESS;
+        pthread_mutex_unlock(&job.lock);
+
+        if (stop) {
+            break;
+        }
+
+        if (!write_page(&job, page)) {
+            fail(&job, RK_DB_ERR);
+            break;
+        }
+        stats.entries += page->count - page->skipped;
+        stats.skipped += page->skipped;
+        stats.batches++;
+
+        if (options->checkpoint &&
+            !options->checkpoint(page->last_uuid, options->checkpoint_arg)) {
+            fail(&job, RK_CHECKPOINT_ERR);
+            break;
+        }
+
+        pthread_mutex_lock(&job.lock);
+        clear_page(page);
+        pthread_cond_broadcast(&job.changed);
+        pthread_mutex_unlock(&job.lock);
+    }
+
+    if (reading) {
+        pthread_join(reader, NULL);
+    }
+    for (uint32_t t = 0; t < spawned; t++) {
+        pthread_join(sealers[t], NULL);
+    }
+
+    for (size_t i = 0; i < job.page_count; i++) {
+        clear_page(&job.pages[i]);
+    }
+    free(job.pages);
+    pthread_cond_destroy(&job.changed);
+    pthread_mutex_destroy(&job.lock);
+    pthread_mutex_destroy(&job.db_lock);
+
+    stats.elapsed_ms = elapsed_ms(start);
+    stats.entries_per_s = (stats.elapsed_ms > 0)
+                              ? (double)(stats.entries + stats.skipped) / (stats.elapsed_ms / 1e3)
+                              : 0;
+    if (out_stats) {
+        *out_stats = stats;
+    }
+
+    rk_status = job.error;
+    return job.error == RK_SUCCESS;
+}
+
+static uint32_t worker_count(uint32_t requested) {
+    if (!requested) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        requested = (online > 0) ? (uint32_t)online : 1;
+    }
+    return (requested > REKEY_MAX_WORKERS) ? REKEY_MAX_WORKERS : requested;
+}
+
+/* pages are read in uuid order, each starting after the last uuid of the previous one */
+static void *reader_stage(void *arg) {
+    RekeyJob *job = arg;
+    char after[UUID_STR_LEN + 1] = {0};
+    bool started = job->resume_after != NULL;
+
+    if (started) {
+        strncpy(after, job->resume_after, UUID_STR_LEN);
+    }
+
+    while (true) {
+        pthread_mutex_lock(&job->lock);
+        RekeyPage *page;
+        while (!(page = find_page(job, PAGE_FREE, 0, true)) && job->error == RK_SUCCESS) {
+            pthread_cond_wait(&job->changed, &job->lock);
+        }
+        pthread_mutex_unlock(&job->lock);
+
+        if (!page) {
+            return NULL;
+        }
+
+        DLinkedList *rows = dlinked_list_create();
+        if (!rows) {
+            fail(job, RK_MEMORY_ERR);
+            return NULL;
+        }
+
+        pthread_mutex_lock(&job->db_lock);
+        repo_return_code rc =
+            read_entries_after(started ? after : NULL, job->batch_size, rows, job->db);
+        pthread_mutex_unlock(&job->db_lock);
+
+        if (rc != OK) {
+            dlinked_list_destroy(rows, free_int_entry_node);
+            fail(job, (rc == MEMORY_ERR || rc == DATA_STRUCTURE_ERR) ? RK_MEMORY_ERR : RK_DB_ERR);
+            return NULL;
+        }
+
+        size_t count = (size_t)rows->size;
+        if (count) {
+            strcpy(after, ((IntVaultEntry *)rows->tail->data)->uuid);
+            started = true;
+        } else {
+            dlinked_list_destroy(rows, NULL);
+        }
+
+        pthread_mutex_lock(&job->lock);
+        if (count) {
+            page->rows = rows;
+            page->count = count;
+            page->seq = job->next_read++;
+            memcpy(page->last_uuid, after, sizeof(after));
+            page->state = PAGE_READ;
+        }
+        job->read_done = count < job->batch_size;
+        pthread_cond_broadcast(&job->changed);
+        pthread_mutex_unlock(&job->lock);
+
+        if (job->read_done) {
+            return NULL;
+        }
+    }
+}
+
+static void *seal_stage(void *arg) {
+    RekeyJob *job = arg;
+    AeadContext *old_aead = aead_context_new(job->old_key);
+    AeadContext *new_aead = aead_context_new_cipher(job->new_key, job->cipher);
+
+    if (!old_aead || !new_aead) {
+        fail(job, RK_MEMORY_ERR);
+    }
+
+    while (true) {
+        pthread_mutex_lock(&job->lock);
+        RekeyPage *page;
+        while (!(page = find_page(job, PAGE_READ, 0, true)) && job->error == RK_SUCCESS &&
+               !job->read_done) {
+            pthread_cond_wait(&job->changed, &job->lock);
+        }
+        if (page && job->error == RK_SUCCESS) {
+            page->state = PAGE_SEALING;
+        } else {
+            page = NULL;
+        }
+        pthread_mutex_unlock(&job->lock);
+
+        if (!page) {
+            break;
+        }
+
+        rk_return_code rc = seal_page(old_aead, new_aead, page);
+
+        pthread_mutex_lock(&job->lock);
+        page->state = PAGE_SEALED;
+        if (rc != RK_SUCCESS && job->error == RK_SUCCESS) {
+            job->error = rc;
+        }
+        pthread_cond_broadcast(&job->changed);
+        pthread_mutex_unlock(&job->lock);
+    }
+
+    aead_context_free(old_aead);
+    aead_context_free(new_aead);
+    return NULL;
+}
+
+static rk_return_code seal_page(AeadContext *old_aead, AeadContext *new_aead, RekeyPage *page) {
+    rk_return_code return_code = RK_SUCCESS;
+
+    page->sealed = calloc(page->count, sizeof(IntVaultEntry));
+    if (!page->sealed) {
+        return RK_MEMORY_ERR;
+    }
+
+    size_t i = 0;
+    for (DLinkedListNode *node = page->rows->head; node && return_code == RK_SUCCESS;
+         node = node->next, i++) {
+        const IntVaultEntry *row = node->data;
+        ExtVaultEntry plain;
+
+        if (decrypt_entry(old_aead, row, &plain)) {
+            if (!encrypt_entry(new_aead, &plain, &page->sealed[i])) {
+                return_code = RK_ENCRYPT_ERR;
+            }
+            free_ext_entry(&plain);
+        } else if (decrypt_entry(new_aead, row, &plain)) {
+            /* written by an interrupted run after its last checkpoint */
+            free_ext_entry(&plain);
+            page->skipped++;
+        } else {
+            return_code = RK_DECRYPT_ERR;
+        }
+    }
+
+    dlinked_list_destroy(page->rows, free_int_entry_node);
+    page->rows = NULL;
+    return return_code;
+}
+
+/* one transaction per page, a failed page leaves the previous ones committed */
+static bool write_page(RekeyJob *job, RekeyPage *page) {
+    bool return_code = true;
+
+    pthread_mutex_lock(&job->db_lock);
+    if (sqlite3_exec(job->db, "BEGIN IMMEDIATE;", NULL, NULL, NULL) != SQLITE_OK) {
+        pthread_mutex_unlock(&job->db_lock);
+        return false;
+    }
+
+    for (size_t i = 0; return_code && i < page->count; i++) {
+        IntVaultEntry *sealed = &page->sealed[i];
+        if (sealed->uuid) {
+            return_code = update_entry(sealed->uuid, sealed, job->db) == OK;
+        }
+    }
+
+    if (!return_code || sqlite3_exec(job->db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+        sqlite3_exec(job->db, "ROLLBACK;", NULL, NULL, NULL);
+        return_code = false;
+    }
+    pthread_mutex_unlock(&job->db_lock);
+    return return_code;
+}
+
+/* with any_seq the oldest page in state, otherwise the page numbered seq */
+static RekeyPage *find_page(RekeyJob *job, page_state state, uint64_t seq, bool any_seq) {
+    RekeyPage *found = NULL;
+
+    for (size_t i = 0; i < job->page_count; i++) {
+        RekeyPage *page = &job->pages[i];
+
+        if (page->state != state) {
+            continue;
+        }
+        if (state == PAGE_FREE || (!any_seq && page->seq == seq)) {
+            return page;
+        }
+        if (any_seq && (!found || page->seq < found->seq)) {
+            found = page;
+        }
+    }
+    return found;
+}
+
+static void fail(RekeyJob *job, rk_return_code error) {
+    pthread_mutex_lock(&job->lock);
+    if (job->error == RK_SUCCESS) {
+        job->error = error;
+    }
+    pthread_cond_broadcast(&job->changed);
+    pthread_mutex_unlock(&job->lock);
+}
+
+static void clear_page(RekeyPage *page) {
+    if (page->rows) {
+        dlinked_list_destroy(page->rows, free_int_entry_node);
+    }
+    if (page->sealed) {
+        for (size_t i = 0; i < page->count; i++) {
+            free_int_entry(&page->sealed[i]);
+        }
+        free(page->sealed);
+    }
+    memset(page, 0, sizeof(RekeyPage));
+}
+
+static double elapsed_ms(struct timespec start) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
@@ -8,6 +8,7 @@
 
 #if defined(__linux__)
 
+#include <errno.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -19,6 +20,11 @@ stk_return_code tk_status = 0;
 static bool write_to_file(int fd, uint8_t *buffer, size_t length);
 static bool read_from_file(int fd, uint8_t *buffer, size_t length);
 static bool is_exists_titan_key();
+#if defined(__linux__)
+static bool check_titan_key_stat(const struct stat *st);
+#endif
+static bool compute_mac_v02(const uint8_t *titan_key, uint8_t *out_mac);
+static bool store_titan_key(const uint8_t *titan_key);
 
 bool init_titan_key() {
 
@@ -38,110 +44,104 @@ bool init_titan_key() {
         return false;
     }
 
-#if defined(__linux__)
-
-    int fd = open(titan_key_path, O_CREAT | O_WRONLY, S_IRUSR | S_IWUSR);
-    if (fd == -1) {
-        tk_status = TKS_SYSCALL_ERR;
-        return false;
-    }
-
-#else
-    // TODO: add portability to other platforms
-    tk_status = TKS_UNSOPPORTED_OP;
-    return false;
-#endif
-
-    int buffer_version_byte = TITAN_KEY_VERSION_01;
-    if (!write_to_file(fd, (uint8_t *)&buffer_version_byte, 1)) {
-        return false;
-    }
-
-    if (!write_to_file(fd, titan_key, TITAN_KEY_SIZE_V01)) {
-        return false;
-    }
-
-    // TODO: update the following code to read salt from the database
-    uint8_t tmp_salt[SALT_LEN] = {0x06};
-    uint8_t MAC_buffer[TITAN_KEY_MAC_SIZE_V01];
+    bool return_code = store_titan_key(titan_key);
+    secure_memset(titan_key, TITAN_KEY_SIZE_V01);
+    return return_code;
+}
 
-    if (!hash_key(titan_key, tmp_salt, MAC_buffer)) {
-        tk_status = TKS_UTIL_ERR;
+bool load_titan_key(uint8_t *out_titan_key) {
+    if (!out_titan_key) {
         return false;
     }
 
-    if (!write_to_file(fd, MAC_buffer, TITAN_KEY_MAC_SIZE_V01)) {
+    if (!strlen(titan_key_path) && !initialize_paths()) {
+        tk_status = TKS_SERVICE_ERR;
         return false;
     }
 
 #if defined(__linux__)
-    if (close(fd) == -1) {
-        tk_status = TKS_SYSCALL_ERR;
+    /*
+     * One open, then the is_valid_titan_key() checks on the descriptor, so the
+     * file checked is the file read. O_NONBLOCK keeps a fifo from blocking the open.
+     */
+    int fd = open(titan_key_path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd == -1) {
+        tk_status = errno == ENOENT ? TKS_NOTKF : TKS_SYSCALL_ERR;
         return false;
     }
-#else
-    // TODO: add portability to other platforms
-    tk_status = TKS_UNSOPPORTED_OP;
-    return false;
-#endif
-    secure_memset(titan_key, TITAN_KEY_SIZE_V01);
-    secure_memset(MAC_buffer, TITAN_KEY_MAC_SIZE_V01);
-    return true;
-}
 
-bool load_titan_key(uint8_t *out_titan_key) {
-    if (!is_valid_titan_key()) {
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        tk_status = TKS_SYSCALL_ERR;
+        close(fd);
         return false;
     }
 
-    if (!out_titan_key) {
+    if (!check_titan_key_stat(&st)) {
+        close(fd);
         return false;
     }
 
-#if defined(__linux__)
-    int fd = open(titan_key_path, O_CREAT | O_RDONLY, S_IRUSR | S_IWUSR);
-    if (fd == -1) {
-        tk_status = TKS_SYSCALL_ERR;
+    uint8_t blob[TITAN_BLOB_SIZE_V02];
+    bool read_ok = read_from_file(fd, blob, TITAN_BLOB_SIZE_V02);
+    close(fd);
+    if (!read_ok) {
         return false;
     }
 
-    uint8_t version_byte;
+    uint8_t *key = blob + 1;
+    uint8_t *mac = blob + 1 + TITAN_KEY_SIZE_V02;
+    uint8_t mac_buffer[TITAN_KEY_MAC_SIZE_V02] = {0};
+    bool return_code = false;
 
-    if (!read_from_file(fd, &version_byte, 1)) {
-        return false;
-    }
+    switch (blob[0]) {
+        case TITAN_KEY_VERSION_01: {
+            // TODO: modify the following code to read salt from the database
+            uint8_t tmp_salt[SALT_LEN] = {0x06};
 
-    switch (version_byte) {
-        case TITAN_KEY_VERSION_01:
-            if (!read_from_file(fd, out_titan_key, TITAN_KEY_SIZE_V01)) {
-                return false;
+            if (!hash_key(key, tmp_salt, mac_buffer)) {
+                tk_status = TKS_UTIL_ERR;
+                break;
             }
 
-            uint8_t mac[TITAN_KEY_MAC_SIZE_V01] = {0};
-            if (!read_from_file(fd, mac, TITAN_KEY_MAC_SIZE_V01)) {
-                return false;
+            if (!constant_time_equal(mac, mac_buffer, TITAN_KEY_MAC_SIZE_V01)) {
+                tk_status = TKS_TAMPERD;
+                break;
             }
 
-            // TODO: modify the following code to read salt from the database
-            uint8_t tmp_salt[SALT_LEN] = {0x06};
-            uint8_t mac_buffer[TITAN_KEY_MAC_SIZE_V01] = {0};
+            /* v1 costs a full Argon2 run per load, rewrite the file as v2 */
+            memcpy(out_titan_key, key, TITAN_KEY_SIZE_V01);
+            return_code = true;
+            store_titan_key(key);
+            tk_status = TKS_SUCCESS;
+            break;
+        }
 
-            if (!hash_key(out_titan_key, tmp_salt, mac_buffer)) {
+        case TITAN_KEY_VERSION_02:
+            if (!compute_mac_v02(key, mac_buffer)) {
                 tk_status = TKS_UTIL_ERR;
-                return false;
+                break;
             }
 
-            if (constant_time_equal(mac, mac_buffer, TITAN_KEY_MAC_SIZE_V01)) {
-                return true;
-            } else {
+            if (!constant_time_equal(mac, mac_buffer, TITAN_KEY_MAC_SIZE_V02)) {
                 tk_status = TKS_TAMPERD;
-                return false;
+                break;
             }
+
+            memcpy(out_titan_key, key, TITAN_KEY_SIZE_V02);
+            return_code = true;
+            tk_status = TKS_SUCCESS;
+            break;
+
         default:
             tk_status = TKS_UNSUPPORTED_VER_ERR;
-            return false;
+            break;
     }
 
+    secure_memset(blob, TITAN_BLOB_SIZE_V02);
+    secure_memset(mac_buffer, TITAN_KEY_MAC_SIZE_V02);
+    return return_code;
+
 #else
     // TODO: add portability to other platforms
     tk_status = TKS_UNSOPPORTED_OP;
@@ -177,28 +177,110 @@ bool is_valid_titan_key() {
         return false;
     }
 
-    if (st.st_size != TITAN_BLOB_SIZE_V01) {
+    if (!check_titan_key_stat(&st)) {
+        return false;
+    }
+
+#else
+    // TODO: add portability to other platforms
+    tk_status = TKS_UNSOPPORTED_OP;
+    return false;
+#endif /* if defined (__linux__) */
+
+    return true;
+}
+
+#if defined(__linux__)
+
+/* size, type and mode a key file must have, shared by stat() and fstat() callers */
+static bool check_titan_key_stat(const struct stat *st) {
+
+    /* v1 and v2 blobs have the same size */
+    if (st->st_size != TITAN_BLOB_SIZE_V02) {
         tk_status = TKS_TAMPERD;
         return false;
     }
 
-    if ((st.st_mode & S_IFMT) != S_IFREG) {
+    if ((st->st_mode & S_IFMT) != S_IFREG) {
         tk_status = TKS_TAMPERD;
         return false;
     }
 
-    if ((st.st_mode & (S_IRWXU | S_IRWXG | S_IRWXO)) != (S_IRUSR | S_IWUSR)) {
+    if ((st->st_mode & (S_IRWXU | S_IRWXG | S_IRWXO)) != (S_IRUSR | S_IWUSR)) {
         tk_status = TKS_TAMPERD;
         return false;
     }
 
+    return true;
+}
+
+#endif /* if defined (__linux__) */
+
+/* MAC of a v2 blob: BLAKE2b keyed with the titan key over version || context */
+static bool compute_mac_v02(const uint8_t *titan_key, uint8_t *out_mac) {
+    uint8_t data[1 + sizeof(TITAN_KEY_MAC_CONTEXT_V02) - 1];
+
+    data[0] = TITAN_KEY_VERSION_02;
+    memcpy(data + 1, TITAN_KEY_MAC_CONTEXT_V02, sizeof(TITAN_KEY_MAC_CONTEXT_V02) - 1);
+
+    return keyed_hash(titan_key, TITAN_KEY_SIZE_V02, data, sizeof(data), out_mac,
+                      TITAN_KEY_MAC_SIZE_V02);
+}
+
+/*
+ * Writes a v2 blob next to the key file then renames it over, so a crash never
+ * leaves a truncated key behind.
+ */
+static bool store_titan_key(const uint8_t *titan_key) {
+#if defined(__linux__)
+    char tmp_path[PATH_MAX];
+    uint8_t blob[TITAN_BLOB_SIZE_V02];
+
+    if (snprintf(tmp_path, PATH_MAX, "%s.tmp", titan_key_path) >= PATH_MAX) {
+        tk_status = TKS_SERVICE_ERR;
+        return false;
+    }
+
+    blob[0] = TITAN_KEY_VERSION_02;
+    memcpy(blob + 1, titan_key, TITAN_KEY_SIZE_V02);
+    if (!compute_mac_v02(titan_key, blob + 1 + TITAN_KEY_SIZE_V02)) {
+        tk_status = TKS_UTIL_ERR;
+        secure_memset(blob, TITAN_BLOB_SIZE_V02);
+        return false;
+    }
+
+    int fd = open(tmp_path, O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        tk_status = TKS_SYSCALL_ERR;
+        secure_memset(blob, TITAN_BLOB_SIZE_V02);
+        return false;
+    }
+
+    bool written = write_to_file(fd, blob, TITAN_BLOB_SIZE_V02);
+    secure_memset(blob, TITAN_BLOB_SIZE_V02);
+
+    if (!written || fsync(fd) == -1) {
+        if (written) {
+            tk_status = TKS_SYSCALL_ERR;
+        }
+        close(fd);
+        unlink(tmp_path);
+        return false;
+    }
+
+    if (close(fd) == -1 || rename(tmp_path, titan_key_path) == -1) {
+        tk_status = TKS_SYSCALL_ERR;
+        unlink(tmp_path);
+        return false;
+    }
+
+    tk_status = TKS_SUCCESS;
+    return true;
 #else
     // TODO: add portability to other platforms
     tk_status = TKS_UNSOPPORTED_OP;
     return false;
 #endif /* if defined (__linux__) */
-
-    return true;
 }
 
 static bool write_to_file(int fd, uint8_t *buffer, size_t length) {
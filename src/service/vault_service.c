@@ -0,0 +1,792 @@
+#include <CVault/crypto/crypto_core.h>
+#include <CVault/repository/repository.h>
+#include <CVault/service/db_config_service.h>
+#include <CVault/service/db_init_service.h>
+#include <CVault/service/entry_service.h>
+#include <CVault/service/environment_service.h>
+#include <CVault/service/kdf_service.h>
+#include <CVault/service/rekey_service.h>
+#include <CVault/service/titan_key_service.h>
+#include <CVault/service/vault_service.h>
+#include <CVault/utils/security_utils.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* verification hash of the second half of the key material */
+#define VERIFIER_LEN VER_KEY_LEN
+
+/* data key wrapped under the master key half of the key material */
+#define WRAPPED_KEY_LEN (VAULT_MASTER_KEY_LEN + TAGGED_BLOB_OVERHEAD)
+
+/*
+ * pending upgrade record: descriptor record followed by its verifier, then the
+ * data key wrapped under the new material. Records written before the data
+ * key existed stop after the verifier, their entries were re-encrypted.
+ */
+#define PENDING_RECORD_SIZE         (KDF_DESCRIPTOR_RECORD_SIZE_V01 + VERIFIER_LEN)
+#define PENDING_WRAPPED_RECORD_SIZE (PENDING_RECORD_SIZE + WRAPPED_KEY_LEN)
+
+/*
+ * data key rotation record: the new data key wrapped under the current one, a
+ * byte set once a page was committed under the new key, then the binary uuid
+ * of the last entry of that page. Records written before the flag existed
+ * stop after the wrapped key and the uuid, they resume from the first entry.
+ */
+#define ROTATION_CHECKPOINTED       WRAPPED_KEY_LEN
+#define ROTATION_LAST_UUID          (WRAPPED_KEY_LEN + 1)
+#define ROTATION_RECORD_SIZE        (ROTATION_LAST_UUID + UUID_BIN_LEN)
+#define ROTATION_LEGACY_RECORD_SIZE (WRAPPED_KEY_LEN + UUID_BIN_LEN)
+
+typedef struct {
+    uint8_t titan_key[TITAN_KEY_LEN];
+    bool loaded;
+    stk_return_code status;
+    double ms;
+} TitanStage;
+
+typedef struct {
+    sqlite3 *db;
+    double ms;
+} DatabaseStage;
+
+vs_return_code vs_status = 0;
+
+/* cipher of the vaults created from now on, 0 for preferred_cipher() */
+static uint8_t creation_cipher = 0;
+
+static bool get_titan_key(uint8_t *out_titan_key, bool create);
+static bool read_verifier(char *key, uint8_t *out_verifier);
+static bool store_config(char *key, uint8_t *value, size_t value_len);
+static bool matches_verifier(const uint8_t *material, const KdfDescriptor *kdf,
+                             const uint8_t *verifier);
+static bool resolve_pending(sqlite3 *db, const char *password, const uint8_t *titan_key,
+                            bool verified, uint8_t *material);
+static bool pending_applied(const uint8_t *verifier, const uint8_t *wrapped);
+static bool finalize_upgrade(const KdfDescriptor *kdf, uint8_t *verifier, uint8_t *wrapped);
+static bool rewrap_vault(const char *password, const uint8_t *titan_key,
+                         const uint8_t *data_key);
+static bool wrap_data_key(const uint8_t *material, const uint8_t *data_key, uint8_t cipher,
+                          uint8_t *out_wrapped);
+static bool read_data_key(const uint8_t *material, uint8_t *out_data_key, bool *out_enveloped);
+static bool material_opens_vault(sqlite3 *db, const uint8_t *material);
+static bool resume_rotation(sqlite3 *db, const char *password, const uint8_t *titan_key,
+                            uint8_t *data_key, bool *out_rewrapped, RekeyStats *out_stats);
+static bool save_rotation_checkpoint(const char *last_uuid, void *arg);
+static bool entries_use_key(sqlite3 *db, const uint8_t *key);
+static void *titan_stage(void *arg);
+static void *database_stage(void *arg);
+static double elapsed_ms(struct timespec start);
+
+bool set_vault_cipher(uint8_t cipher) {
+    if (cipher && !is_valid_cipher(cipher)) {
+        return false;
+    }
+
+    creation_cipher = cipher;
+    return true;
+}
+
+bool read_vault_cipher(uint8_t *out_cipher) {
+    Config record = {0};
+
+    if (!out_cipher) {
+        vs_status = VS_UTIL_ERR;
+        return false;
+    }
+
+    if (!service_read_config(VAULT_CIPHER_CONFIG_KEY, &record)) {
+        *out_cipher = CIPHER_AES_256_GCM;
+        return true;
+    }
+
+    bool return_code = record.config_value_len == 1 && is_valid_cipher(record.config_value[0]);
+    if (return_code) {
+        *out_cipher = record.config_value[0];
+    } else {
+        vs_status = VS_CONFIG_ERR;
+    }
+
+    free(record.config_key);
+    free(record.config_value);
+    return return_code;
+}
+
+bool create_vault(const char *password) {
+    KdfDescriptor kdf;
+
+    if (!password) {
+        vs_status = VS_UTIL_ERR;
+        return false;
+    }
+
+    if (read_kdf_descriptor_service(&kdf) || kdf_status != KDF_CONFIG_ERR) {
+        vs_status = VS_VAULT_EXISTS;
+        return false;
+    }
+
+    /* the descriptor takes the calibrated parameters, the defaults without a record */
+    if (!load_kdf_service()) {
+        vs_status = VS_KDF_ERR;
+        return false;
+    }
+
+    uint8_t titan_key[TITAN_KEY_LEN];
+    uint8_t material[MAT_KEY_LEN];
+    uint8_t verifier[VERIFIER_LEN];
+    uint8_t data_key[VAULT_MASTER_KEY_LEN];
+    uint8_t wrapped[WRAPPED_KEY_LEN];
+    bool return_code = false;
+
+    if (!get_titan_key(titan_key, true)) {
+        vs_status = VS_TITAN_KEY_ERR;
+        return false;
+    }
+
+    if (!new_kdf_descriptor(&kdf)) {
+        vs_status = VS_UTIL_ERR;
+        goto finish;
+    }
+
+    if (!derive_key_material_kdf(password, titan_key, &kdf, material)) {
+        vs_status = VS_KDF_ERR;
+        goto finish;
+    }
+
+    uint8_t cipher = creation_cipher ? creation_cipher : preferred_cipher();
+
+    if (!hash_key(material + VAULT_MASTER_KEY_LEN, kdf.salt, verifier) ||
+        random_raw_bytes(VAULT_MASTER_KEY_LEN, data_key) != SUCCESS ||
+        !wrap_data_key(material, data_key, cipher, wrapped)) {
+        vs_status = VS_UTIL_ERR;
+        goto finish;
+    }
+
+    /* the descriptor goes last, its presence is what makes the vault exist */
+    if (!store_config(VAULT_CIPHER_CONFIG_KEY, &cipher, 1) ||
+        !store_config(VAULT_DATA_KEY_CONFIG_KEY, wrapped, WRAPPED_KEY_LEN) ||
+        !store_config(VAULT_VERIFIER_CONFIG_KEY, verifier, VERIFIER_LEN) ||
+        !store_kdf_descriptor_service(&kdf)) {
+        vs_status = VS_CONFIG_ERR;
+        goto finish;
+    }
+
+    vs_status = VS_SUCCESS;
+    return_code = true;
+
+finish:
+    secure_memset(titan_key, TITAN_KEY_LEN);
+    secure_memset(material, MAT_KEY_LEN);
+    secure_memset(data_key, VAULT_MASTER_KEY_LEN);
+    return return_code;
+}
+
+bool change_master_password(const char *password, const char *new_password) {
+    uint8_t data_key[VAULT_MASTER_KEY_LEN];
+    uint8_t titan_key[TITAN_KEY_LEN];
+    bool return_code = false;
+
+    if (!new_password) {
+        vs_status = VS_UTIL_ERR;
+        return false;
+    }
+
+    if (!unlock_vault(password, data_key)) {
+        return false;
+    }
+
+    if (!get_titan_key(titan_key, false)) {
+        vs_status = VS_TITAN_KEY_ERR;
+    } else if (!rewrap_vault(new_password, titan_key, data_key)) {
+        vs_status = VS_REKEY_ERR;
+    } else {
+        vs_status = VS_SUCCESS;
+        return_code = true;
+    }
+
+    secure_memset(titan_key, TITAN_KEY_LEN);
+    secure_memset(data_key, VAULT_MASTER_KEY_LEN);
+    return return_code;
+}
+
+bool rotate_data_key(const char *password, RekeyStats *out_stats) {
+    uint8_t data_key[VAULT_MASTER_KEY_LEN];
+    uint8_t new_key[VAULT_MASTER_KEY_LEN];
+    uint8_t titan_key[TITAN_KEY_LEN];
+    uint8_t record[ROTATION_RECORD_SIZE] = {0};
+    uint8_t cipher;
+    sqlite3 *db = NULL;
+    bool rewrapped = false;
+    bool return_code = false;
+
+    if (out_stats) {
+        memset(out_stats, 0, sizeof(RekeyStats));
+    }
+
+    /* settles any rotation left behind, so data_key is the one in use */
+    if (!unlock_vault_session(password, data_key, &db, NULL)) {
+        return false;
+    }
+
+    if (!get_titan_key(titan_key, false)) {
+        vs_status = VS_TITAN_KEY_ERR;
+        goto finish;
+    }
+
+    if (!read_vault_cipher(&cipher)) {
+        goto finish;
+    }
+
+    if (random_raw_bytes(VAULT_MASTER_KEY_LEN, new_key) != SUCCESS ||
+        !wrap_data_key(data_key, new_key, cipher, record)) {
+        vs_status = VS_UTIL_ERR;
+        goto finish;
+    }
+
+    /* a crash from here on is carried on by resume_rotation() at the next unlock */
+    if (!store_config(VAULT_ROTATION_CONFIG_KEY, record, ROTATION_RECORD_SIZE)) {
+        vs_status = VS_CONFIG_ERR;
+        goto finish;
+    }
+
+    if (!resume_rotation(db, password, titan_key, data_key, &rewrapped, out_stats)) {
+        vs_status = VS_ROTATION_ERR;
+        goto finish;
+    }
+
+    vs_status = VS_SUCCESS;
+    return_code = true;
+
+finish:
+    repo_close(db);
+    secure_memset(titan_key, TITAN_KEY_LEN);
+    secure_memset(data_key, VAULT_MASTER_KEY_LEN);
+    secure_memset(new_key, VAULT_MASTER_KEY_LEN);
+    secure_memset(record, ROTATION_RECORD_SIZE);
+    return return_code;
+}
+
+bool unlock_vault(const char *password, uint8_t *out_master_key) {
+    return unlock_vault_session(password, out_master_key, NULL, NULL);
+}
+
+bool unlock_vault_session(const char *password, uint8_t *out_master_key, sqlite3 **out_vault_db,
+                          UnlockTimings *out_timings) {
+    UnlockTimings timings = {0};
+    struct timespec start, stage_start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (out_vault_db) {
+        *out_vault_db = NULL;
+    }
+
+    if (!password || !out_master_key) {
+        vs_status = VS_UTIL_ERR;
+        return false;
+    }
+
+    /* the stage threads only read the paths, set them before starting any */
+    if (!env_cdp_len && !initialize_paths()) {
+        vs_status = VS_CONFIG_ERR;
+        return false;
+    }
+
+    TitanStage titan = {0};
+    DatabaseStage database = {0};
+    pthread_t titan_thread, database_thread;
+
+    bool titan_threaded = pthread_create(&titan_thread, NULL, titan_stage, &titan) == 0;
+    if (!titan_threaded) {
+        titan_stage(&titan);
+    }
+
+    bool database_threaded = pthread_create(&database_thread, NULL, database_stage, &database) == 0;
+    if (!database_threaded) {
+        database_stage(&database);
+    }
+
+    /* the config connection is not shared, its records are read on this thread */
+    KdfDescriptor kdf;
+    uint8_t verifier[VERIFIER_LEN];
+    uint8_t material[MAT_KEY_LEN];
+    uint8_t data_key[VAULT_MASTER_KEY_LEN];
+    bool enveloped = false;
+    bool return_code = false;
+
+    /* the calibrated parameters decide whether the descriptor is outdated */
+    bool have_params = load_kdf_service();
+    kdf_return_code params_status = kdf_status;
+
+    bool have_kdf = read_kdf_descriptor_service(&kdf);
+    kdf_return_code kdf_read_status = kdf_status;
+    bool have_verifier = have_kdf && read_verifier(VAULT_VERIFIER_CONFIG_KEY, verifier);
+
+    if (titan_threaded) {
+        pthread_join(titan_thread, NULL);
+    }
+    timings.titan_key_ms = titan.ms;
+
+    if (!have_kdf) {
+        vs_status = (kdf_read_status == KDF_CONFIG_ERR) ? VS_NO_VAULT : VS_KDF_ERR;
+        goto finish;
+    }
+
+    if (!have_params) {
+        kdf_status = params_status;
+        vs_status = VS_KDF_ERR;
+        goto finish;
+    }
+
+    if (!titan.loaded) {
+        tk_status = titan.status;
+        vs_status = VS_TITAN_KEY_ERR;
+        goto finish;
+    }
+
+    if (!have_verifier) {
+        vs_status = VS_CONFIG_ERR;
+        goto finish;
+    }
+
+    /* Argon2 takes the titan key as its secret, so it can only start now */
+    clock_gettime(CLOCK_MONOTONIC, &stage_start);
+    bool derived = derive_key_material_kdf(password, titan.titan_key, &kdf, material);
+    timings.kdf_ms = elapsed_ms(stage_start);
+    if (!derived) {
+        vs_status = VS_KDF_ERR;
+        goto finish;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &stage_start);
+    bool verified = matches_verifier(material, &kdf, verifier);
+    timings.verify_ms = elapsed_ms(stage_start);
+
+    if (database_threaded) {
+        pthread_join(database_thread, NULL);
+        database_threaded = false;
+    }
+    timings.database_ms = database.ms;
+
+    if (!database.db) {
+        vs_status = VS_DB_ERR;
+        goto finish;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &stage_start);
+
+    /* an interrupted upgrade may have left the vault on the pending descriptor */
+    if (resolve_pending(database.db, password, titan.titan_key, verified, material)) {
+        verified = true;
+        if (!read_kdf_descriptor_service(&kdf)) {
+            vs_status = VS_KDF_ERR;
+            goto finish;
+        }
+    }
+
+    if (!verified) {
+        vs_status = VS_WRONG_PASSWORD;
+        goto finish;
+    }
+
+    if (!read_data_key(material, data_key, &enveloped)) {
+        vs_status = VS_CONFIG_ERR;
+        goto finish;
+    }
+
+    /* a rotation cut short left entries under both keys, it has to be finished */
+    bool rewrapped = false;
+    if (!resume_rotation(database.db, password, titan.titan_key, data_key, &rewrapped, NULL)) {
+        vs_status = VS_ROTATION_ERR;
+        goto finish;
+    }
+
+    /* a vault from before the data key is wrapped by its first upgrade */
+    vs_status = VS_SUCCESS;
+    if (!rewrapped && (is_outdated_kdf_descriptor(&kdf) || !enveloped) &&
+        !rewrap_vault(password, titan.titan_key, data_key)) {
+        vs_status = VS_REKEY_ERR;
+    }
+    timings.upgrade_ms = elapsed_ms(stage_start);
+
+    memcpy(out_master_key, data_key, VAULT_MASTER_KEY_LEN);
+    return_code = true;
+
+finish:
+    if (database_threaded) {
+        pthread_join(database_thread, NULL);
+        timings.database_ms = database.ms;
+    }
+
+    if (return_code && out_vault_db) {
+        *out_vault_db = database.db;
+    } else if (database.db) {
+        repo_close(database.db);
+    }
+
+    timings.total_ms = elapsed_ms(start);
+    if (out_timings) {
+        *out_timings = timings;
+    }
+
+    secure_memset(titan.titan_key, TITAN_KEY_LEN);
+    secure_memset(material, MAT_KEY_LEN);
+    secure_memset(data_key, VAULT_MASTER_KEY_LEN);
+    return return_code;
+}
+
+/* key file I/O and verification */
+static void *titan_stage(void *arg) {
+    TitanStage *stage = arg;
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    stage->loaded = get_titan_key(stage->titan_key, false);
+    stage->status = tk_status;
+    stage->ms = elapsed_ms(start);
+    return NULL;
+}
+
+/* vault.db open and schema check */
+static void *database_stage(void *arg) {
+    DatabaseStage *stage = arg;
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!open_vault_db(&stage->db)) {
+        stage->db = NULL;
+    }
+    stage->ms = elapsed_ms(start);
+    return NULL;
+}
+
+static double elapsed_ms(struct timespec start) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+static bool get_titan_key(uint8_t *out_titan_key, bool create) {
+    if (load_titan_key(out_titan_key)) {
+        return true;
+    }
+
+    if (!create || tk_status != TKS_NOTKF) {
+        return false;
+    }
+
+    return init_titan_key() && load_titan_key(out_titan_key);
+}
+
+static bool read_verifier(char *key, uint8_t *out_verifier) {
+    Config record = {0};
+
+    if (!service_read_config(key, &record)) {
+        return false;
+    }
+
+    bool return_code = record.config_value_len == VERIFIER_LEN;
+    if (return_code) {
+        memcpy(out_verifier, record.config_value, VERIFIER_LEN);
+    }
+
+    free(record.config_key);
+    free(record.config_value);
+    return return_code;
+}
+
+/* replaces the value stored under key, adds it when missing */
+static bool store_config(char *key, uint8_t *value, size_t value_len) {
+    if (service_update_config(key, value, value_len)) {
+        return true;
+    }
+
+    Config config = {.config_key = key, .config_value = value, .config_value_len = value_len};
+
+    return service_add_config(&config);
+}
+
+static bool matches_verifier(const uint8_t *material, const KdfDescriptor *kdf,
+                             const uint8_t *verifier) {
+    uint8_t computed[VERIFIER_LEN];
+
+    if (!hash_key(material + VAULT_MASTER_KEY_LEN, kdf->salt, computed)) {
+        return false;
+    }
+
+    bool equal = constant_time_equal(computed, verifier, VERIFIER_LEN);
+    secure_memset(computed, VERIFIER_LEN);
+    return equal;
+}
+
+/*
+ * Settles an upgrade left behind by a crash. The pending record is written
+ * before anything else and finalize_upgrade() then replaces the wrapped data
+ * key, the verifier and the descriptor in that order, so the vault either
+ * still opens with the current material (the pending record is stale and
+ * dropped) or only with the pending one (the upgrade is finalized). Returns
+ * true when material was replaced by the key material of the pending
+ * descriptor. A password failing the current verifier only pays for the
+ * pending derivation once finalize_upgrade() stored part of the record,
+ * until then the current descriptor is the one that opens the vault.
+ */
+static bool resolve_pending(sqlite3 *db, const char *password, const uint8_t *titan_key,
+                            bool verified, uint8_t *material) {
+    Config record = {0};
+    KdfDescriptor pending;
+    bool switched = false;
+
+    if (!service_read_config(VAULT_PENDING_CONFIG_KEY, &record)) {
+        return false;
+    }
+
+    size_t record_len = record.config_value_len;
+    if ((record_len != PENDING_RECORD_SIZE && record_len != PENDING_WRAPPED_RECORD_SIZE) ||
+        !decode_kdf_descriptor(record.config_value, KDF_DESCRIPTOR_RECORD_SIZE_V01, &pending)) {
+        service_delete_config(VAULT_PENDING_CONFIG_KEY);
+        goto finish;
+    }
+
+    uint8_t *pending_verifier = record.config_value + KDF_DESCRIPTOR_RECORD_SIZE_V01;
+    uint8_t *pending_wrapped =
+        (record_len == PENDING_WRAPPED_RECORD_SIZE) ? pending_verifier + VERIFIER_LEN : NULL;
+
+    if (verified && material_opens_vault(db, material)) {
+        service_delete_config(VAULT_PENDING_CONFIG_KEY);
+        goto finish;
+    }
+
+    /* legacy records re-encrypted the entries first, they are always tried */
+    if (!verified && pending_wrapped && !pending_applied(pending_verifier, pending_wrapped)) {
+        goto finish;
+    }
+
+    uint8_t pending_material[MAT_KEY_LEN];
+    if (!derive_key_material_kdf(password, titan_key, &pending, pending_material)) {
+        goto finish;
+    }
+
+    if (matches_verifier(pending_material, &pending, pending_verifier) &&
+        finalize_upgrade(&pending, pending_verifier, pending_wrapped)) {
+        memcpy(material, pending_material, MAT_KEY_LEN);
+        switched = true;
+    }
+    secure_memset(pending_material, MAT_KEY_LEN);
+
+finish:
+    free(record.config_key);
+    free(record.config_value);
+    return switched;
+}
+
+/* true once the wrapped data key or the verifier of a pending record was stored */
+static bool pending_applied(const uint8_t *verifier, const uint8_t *wrapped) {
+    uint8_t stored[VERIFIER_LEN];
+    Config record = {0};
+
+    bool applied = read_verifier(VAULT_VERIFIER_CONFIG_KEY, stored) &&
+                   constant_time_equal(stored, verifier, VERIFIER_LEN);
+
+    if (!applied && service_read_config(VAULT_DATA_KEY_CONFIG_KEY, &record)) {
+        applied = record.config_value_len == WRAPPED_KEY_LEN &&
+                  constant_time_equal(record.config_value, wrapped, WRAPPED_KEY_LEN);
+    }
+
+    free(record.config_key);
+    free(record.config_value);
+    return applied;
+}
+
+/* points the vault at the new descriptor, the pending record goes last */
+static bool finalize_upgrade(const KdfDescriptor *kdf, uint8_t *verifier, uint8_t *wrapped) {
+    if (wrapped && !store_config(VAULT_DATA_KEY_CONFIG_KEY, wrapped, WRAPPED_KEY_LEN)) {
+        return false;
+    }
+
+    if (!store_config(VAULT_VERIFIER_CONFIG_KEY, verifier, VERIFIER_LEN)) {
+        return false;
+    }
+
+    if (!store_kdf_descriptor_service(kdf)) {
+        return false;
+    }
+
+    return service_delete_config(VAULT_PENDING_CONFIG_KEY);
+}
+
+/* moves the vault to a fresh descriptor for password, the entries are untouched */
+static bool rewrap_vault(const char *password, const uint8_t *titan_key,
+                         const uint8_t *data_key) {
+    KdfDescriptor next;
+    uint8_t next_material[MAT_KEY_LEN];
+    uint8_t record[PENDING_WRAPPED_RECORD_SIZE];
+    uint8_t cipher;
+    bool return_code = false;
+
+    if (!read_vault_cipher(&cipher) || !new_kdf_descriptor(&next) ||
+        !derive_key_material_kdf(password, titan_key, &next, next_material)) {
+        return false;
+    }
+
+    uint8_t *verifier = record + KDF_DESCRIPTOR_RECORD_SIZE_V01;
+    uint8_t *wrapped = verifier + VERIFIER_LEN;
+    if (!encode_kdf_descriptor(&next, record) ||
+        !hash_key(next_material + VAULT_MASTER_KEY_LEN, next.salt, verifier) ||
+        !wrap_data_key(next_material, data_key, cipher, wrapped)) {
+        goto finish;
+    }
+
+    /* a crash from here on is settled by resolve_pending() */
+    if (!store_config(VAULT_PENDING_CONFIG_KEY, record, sizeof(record))) {
+        goto finish;
+    }
+    return_code = finalize_upgrade(&next, verifier, wrapped);
+
+finish:
+    secure_memset(next_material, MAT_KEY_LEN);
+    return return_code;
+}
+
+static bool wrap_data_key(const uint8_t *material, const uint8_t *data_key, uint8_t cipher,
+                          uint8_t *out_wrapped) {
+    return encrypt_tagged_blob(material, cipher, data_key, VAULT_MASTER_KEY_LEN, out_wrapped);
+}
+
+/*
+ * Unwraps the data key with material. A vault without a wrapped data key
+ * predates it, its entries are encrypted with the master key half itself.
+ */
+static bool read_data_key(const uint8_t *material, uint8_t *out_data_key, bool *out_enveloped) {
+    Config record = {0};
+
+    if (!service_read_config(VAULT_DATA_KEY_CONFIG_KEY, &record)) {
+        memcpy(out_data_key, material, VAULT_MASTER_KEY_LEN);
+        *out_enveloped = false;
+        return true;
+    }
+
+    *out_enveloped = true;
+    bool return_code = record.config_value_len == WRAPPED_KEY_LEN &&
+                       decrypt_tagged_blob(material, record.config_value, WRAPPED_KEY_LEN,
+                                           out_data_key);
+
+    free(record.config_key);
+    free(record.config_value);
+    return return_code;
+}
+
+static bool material_opens_vault(sqlite3 *db, const uint8_t *material) {
+    uint8_t data_key[VAULT_MASTER_KEY_LEN];
+    bool enveloped = false;
+
+    bool opened = read_data_key(material, data_key, &enveloped);
+    secure_memset(data_key, VAULT_MASTER_KEY_LEN);
+
+    return opened && (enveloped || entries_use_key(db, material));
+}
+
+/*
+ * Carries on the rotation recorded under VAULT_ROTATION_CONFIG_KEY, if any.
+ * The entries are moved to the new key from the checkpoint on, the new key is
+ * then wrapped under fresh material and the record dropped last. A record
+ * whose key does not unwrap under data_key is stale: the new key was already
+ * made the vault's. On success data_key holds the key in use and
+ * out_rewrapped tells whether the vault was moved to a fresh descriptor.
+ */
+static bool resume_rotation(sqlite3 *db, const char *password, const uint8_t *titan_key,
+                            uint8_t *data_key, bool *out_rewrapped, RekeyStats *out_stats) {
+    Config config = {0};
+    uint8_t record[ROTATION_RECORD_SIZE] = {0};
+    uint8_t new_key[VAULT_MASTER_KEY_LEN];
+    char resume_after[UUID_STR_LEN + 1];
+    uint8_t cipher;
+    bool return_code = false;
+
+    *out_rewrapped = false;
+
+    if (!service_read_config(VAULT_ROTATION_CONFIG_KEY, &config)) {
+        return true;
+    }
+
+    /* entries already under the new key are skipped, a legacy record starts over */
+    bool usable = config.config_value_len == ROTATION_RECORD_SIZE ||
+                  config.config_value_len == ROTATION_LEGACY_RECORD_SIZE;
+    if (usable) {
+        memcpy(record, config.config_value,
+               (config.config_value_len == ROTATION_RECORD_SIZE) ? ROTATION_RECORD_SIZE
+                                                                 : WRAPPED_KEY_LEN);
+        usable = decrypt_tagged_blob(data_key, record, WRAPPED_KEY_LEN, new_key);
+    }
+    free(config.config_key);
+    free(config.config_value);
+
+    if (!usable) {
+        return_code = service_delete_config(VAULT_ROTATION_CONFIG_KEY);
+        goto finish;
+    }
+
+    if (record[ROTATION_CHECKPOINTED]) {
+        uuid_to_string(record + ROTATION_LAST_UUID, resume_after);
+    }
+    RekeyOptions options = {.resume_after = record[ROTATION_CHECKPOINTED] ? resume_after : NULL,
+                            .checkpoint = save_rotation_checkpoint,
+                            .checkpoint_arg = record};
+
+    if (!read_vault_cipher(&cipher) ||
+        !rekey_entries(db, data_key, new_key, cipher, &options, out_stats)) {
+        goto finish;
+    }
+
+    /* until the record is gone an unlock with the old wrapping resumes here */
+    if (!rewrap_vault(password, titan_key, new_key)) {
+        goto finish;
+    }
+    *out_rewrapped = true;
+    memcpy(data_key, new_key, VAULT_MASTER_KEY_LEN);
+    return_code = service_delete_config(VAULT_ROTATION_CONFIG_KEY);
+
+finish:
+    secure_memset(record, ROTATION_RECORD_SIZE);
+    secure_memset(new_key, VAULT_MASTER_KEY_LEN);
+    return return_code;
+}
+
+/* records the last entry committed under the new key, arg is the rotation record */
+static bool save_rotation_checkpoint(const char *last_uuid, void *arg) {
+    uint8_t *record = arg;
+
+    if (!uuid_from_string(last_uuid, record + ROTATION_LAST_UUID)) {
+        return false;
+    }
+    record[ROTATION_CHECKPOINTED] = 1;
+    return store_config(VAULT_ROTATION_CONFIG_KEY, record, ROTATION_RECORD_SIZE);
+}
+
+/* checks the first entry authenticates under key, true for an empty vault */
+static bool entries_use_key(sqlite3 *db, const uint8_t *key) {
+    EntryCursor *cursor = NULL;
+    IntVaultEntry row;
+
+    if (open_entry_cursor(true, &cursor, db) != OK) {
+        return false;
+    }
+
+    repo_return_code rc = next_entry(cursor, &row);
+    bool return_code = rc == NOT_FOUND_ERR;
+
+    if (rc == OK) {
+        AeadContext *aead = aead_context_new(key);
+        ExtVaultEntry plain;
+
+        return_code = aead && decrypt_entry(aead, &row, &plain);
+        if (return_code) {
+            free_ext_entry(&plain);
+        }
+        aead_context_free(aead);
+    }
+
+    close_entry_cursor(cursor);
+    return return_code;
+}
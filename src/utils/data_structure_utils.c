@@ -1,11 +1,84 @@
 #include <CVault/utils/data_structure_utils.h>
+#include <CVault/utils/security_utils.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 static DLinkedList *dlinked_list_delete_tail_helper(DLinkedList* wrapper);
 static DLinkedList *dlinked_list_delete_first_helper(DLinkedList *wrapper);
 static DLinkedList *dlinked_list_delete_middle_helper(DLinkedList *wrapper, DLinkedListNode *node);
 
+typedef struct {
+    uint32_t hash;     /* folded hash, its low bits are the home slot */
+    uint32_t distance; /* probe length plus one, 0 for an empty slot */
+    void *key;         /* NULL for an entry removed from the old table */
+    void *value;
+} HashMapSlot;
+
+typedef struct {
+    HashMapSlot *slots;
+    uint64_t mask;
+    uint64_t count;
+} HashTable;
+
+struct HashMap {
+    HashMapHashFn hash;
+    HashMapEqualFn equal;
+    HashTable table;   /* where entries are inserted */
+    HashTable old;     /* the table being migrated, no slots outside a resize */
+    uint64_t migrated; /* old slots below this index were moved to table */
+};
+
+#define HASH_MAP_NOT_FOUND UINT64_MAX
+
+static bool hash_table_alloc(HashTable *table, uint64_t slots);
+static void hash_table_free(HashTable *table);
+static uint64_t hash_table_find(const HashMap *map, const HashTable *table, uint32_t hash,
+                                const void *key, uint64_t first_live);
+static void hash_table_insert(HashTable *table, uint32_t hash, void *key, void *value);
+static void hash_table_remove_at(HashTable *table, uint64_t index);
+static bool hash_map_reserve(HashMap *map);
+static void hash_map_migrate(HashMap *map, uint64_t steps);
+static uint32_t hash_map_fold(const HashMap *map, const void *key);
+
+typedef struct PrefixTreeNode PrefixTreeNode;
+
+struct PrefixTreeNode {
+    char *label; /* the edge from the parent, not NUL terminated */
+    uint32_t label_len;
+    uint32_t child_count;
+    uint32_t child_capacity;
+    uint32_t value_count;
+    uint32_t value_capacity;
+    PrefixTreeNode **children; /* sorted by the first byte of their label */
+    void **values;
+};
+
+struct PrefixTree {
+    PrefixTreeNode root; /* the empty word, its label is empty */
+    uint64_t size;
+};
+
+/* the word being enumerated, grown as the walk goes down */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+} PrefixWord;
+
+static PrefixTreeNode *prefix_node_create(const char *label, size_t label_len);
+static void prefix_node_free(PrefixTreeNode *node, void (*destroy_value)(void *));
+static uint32_t prefix_child_index(const PrefixTreeNode *node, uint8_t first, bool *out_found);
+static bool prefix_node_reserve_child(PrefixTreeNode *node);
+static bool prefix_node_add_value(PrefixTreeNode *node, void *value);
+static void prefix_node_tidy_child(PrefixTreeNode *node, uint32_t index);
+static bool prefix_tree_remove_below(PrefixTreeNode *node, const char *rest, size_t rest_len,
+                                     const void *value);
+static bool prefix_word_append(PrefixWord *word, const char *data, size_t len);
+static bool prefix_tree_visit(const PrefixTreeNode *node, PrefixWord *word,
+                              PrefixTreeVisitFn visit, void *arg, uint64_t *count);
+static void prefix_wipe_free(void *ptr, size_t len);
+
 DLinkedList *dlinked_list_create(void) {
     DLinkedList *wrapper = malloc(sizeof(DLinkedList));
     if (!wrapper) {
@@ -144,3 +217,689 @@ static DLinkedList *dlinked_list_delete_middle_helper(DLinkedList *wrapper, DLin
 	wrapper->size--;
 	return wrapper;
 }
+
+HashMap *hash_map_create(HashMapHashFn hash, HashMapEqualFn equal, uint64_t capacity) {
+    if (!hash || !equal || capacity > (SIZE_MAX / sizeof(HashMapSlot)) / 2) {
+        return NULL;
+    }
+
+    uint64_t slots = HASH_MAP_MIN_SLOTS;
+    while (slots * HASH_MAP_MAX_LOAD < capacity * 8) {
+        slots <<= 1;
+    }
+
+    HashMap *map = calloc(1, sizeof(HashMap));
+    if (!map) {
+        return NULL;
+    }
+    if (!hash_table_alloc(&map->table, slots)) {
+        free(map);
+        return NULL;
+    }
+
+    map->hash = hash;
+    map->equal = equal;
+    return map;
+}
+
+HashMap *hash_map_put(HashMap *map, void *key, void *value, void **out_previous) {
+    if (!map || !key) {
+        return NULL;
+    }
+
+    uint32_t hash = hash_map_fold(map, key);
+    void *previous = NULL;
+
+    uint64_t index = hash_table_find(map, &map->table, hash, key, 0);
+    if (index != HASH_MAP_NOT_FOUND) {
+        previous = map->table.slots[index].value;
+        map->table.slots[index].key = key;
+        map->table.slots[index].value = value;
+    } else {
+        /* may start or finish a resize, nothing is changed if it fails */
+        if (!hash_map_reserve(map)) {
+            return NULL;
+        }
+
+        /* a key still in the old table moves to the new one now */
+        if (map->old.slots) {
+            index = hash_table_find(map, &map->old, hash, key, map->migrated);
+            if (index != HASH_MAP_NOT_FOUND) {
+                previous = map->old.slots[index].value;
+                map->old.slots[index].key = NULL;
+                map->old.slots[index].value = NULL;
+                map->old.count--;
+            }
+        }
+        hash_table_insert(&map->table, hash, key, value);
+    }
+
+    hash_map_migrate(map, HASH_MAP_MIGRATE_STEP);
+    if (out_previous) {
+        *out_previous = previous;
+    }
+    return map;
+}
+
+void *hash_map_get(const HashMap *map, const void *key) {
+    if (!map || !key) {
+        return NULL;
+    }
+
+    uint32_t hash = hash_map_fold(map, key);
+
+    uint64_t index = hash_table_find(map, &map->table, hash, key, 0);
+    if (index != HASH_MAP_NOT_FOUND) {
+        return map->table.slots[index].value;
+    }
+    if (map->old.slots) {
+        index = hash_table_find(map, &map->old, hash, key, map->migrated);
+        if (index != HASH_MAP_NOT_FOUND) {
+            return map->old.slots[index].value;
+        }
+    }
+    return NULL;
+}
+
+bool hash_map_contains(const HashMap *map, const void *key) {
+    if (!map || !key) {
+        return false;
+    }
+
+    uint32_t hash = hash_map_fold(map, key);
+    return hash_table_find(map, &map->table, hash, key, 0) != HASH_MAP_NOT_FOUND ||
+           (map->old.slots &&
+            hash_table_find(map, &map->old, hash, key, map->migrated) != HASH_MAP_NOT_FOUND);
+}
+
+bool hash_map_remove(HashMap *map, const void *key, void **out_value) {
+    if (!map || !key) {
+        return false;
+    }
+
+    uint32_t hash = hash_map_fold(map, key);
+    void *value = NULL;
+    bool found = false;
+
+    uint64_t index = hash_table_find(map, &map->table, hash, key, 0);
+    if (index != HASH_MAP_NOT_FOUND) {
+        value = map->table.slots[index].value;
+        hash_table_remove_at(&map->table, index);
+        found = true;
+    } else if (map->old.slots) {
+        /* the old table keeps its probe sequences until it is dropped */
+        index = hash_table_find(map, &map->old, hash, key, map->migrated);
+        if (index != HASH_MAP_NOT_FOUND) {
+            value = map->old.slots[index].value;
+            map->old.slots[index].key = NULL;
+            map->old.slots[index].value = NULL;
+            map->old.count--;
+            found = true;
+        }
+    }
+
+    hash_map_migrate(map, HASH_MAP_MIGRATE_STEP);
+    if (out_value) {
+        *out_value = value;
+    }
+    return found;
+}
+
+uint64_t hash_map_size(const HashMap *map) {
+    return map ? map->table.count + map->old.count : 0;
+}
+
+bool hash_map_next(const HashMap *map, uint64_t *iterator, void **out_key, void **out_value) {
+    if (!map || !iterator) {
+        return false;
+    }
+
+    uint64_t table_slots = map->table.mask + 1;
+    uint64_t old_slots = map->old.slots ? map->old.mask + 1 : 0;
+    const HashMapSlot *slot = NULL;
+
+    while (!slot && *iterator < table_slots + old_slots) {
+        uint64_t position = (*iterator)++;
+
+        if (position < table_slots) {
+            slot = &map->table.slots[position];
+            slot = slot->distance ? slot : NULL;
+        } else if (position - table_slots >= map->migrated) {
+            slot = &map->old.slots[position - table_slots];
+            slot = (slot->distance && slot->key) ? slot : NULL;
+        }
+    }
+
+    if (!slot) {
+        return false;
+    }
+    if (out_key) {
+        *out_key = slot->key;
+    }
+    if (out_value) {
+        *out_value = slot->value;
+    }
+    return true;
+}
+
+void hash_map_destroy(HashMap *map, HashMapDestroyFn destroy_entry) {
+    if (!map) {
+        return;
+    }
+
+    if (destroy_entry) {
+        uint64_t iterator = 0;
+        void *key, *value;
+
+        while (hash_map_next(map, &iterator, &key, &value)) {
+            destroy_entry(key, value);
+        }
+    }
+
+    hash_table_free(&map->table);
+    hash_table_free(&map->old);
+    free(map);
+}
+
+uint64_t hash_map_hash_bytes(const void *data, size_t length) {
+    const uint8_t *bytes = data;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    /* FNV-1a leaves the low bits weak, they pick the home slot */
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+uint64_t hash_map_hash_string(const void *key) {
+    return hash_map_hash_bytes(key, strlen(key));
+}
+
+bool hash_map_string_equal(const void *key1, const void *key2) {
+    return strcmp(key1, key2) == 0;
+}
+
+static bool hash_table_alloc(HashTable *table, uint64_t slots) {
+    table->slots = calloc(slots, sizeof(HashMapSlot));
+    table->mask = slots - 1;
+    table->count = 0;
+    return table->slots != NULL;
+}
+
+/* the slots hold the key hashes and pointers into the caller's secrets */
+static void hash_table_free(HashTable *table) {
+    if (table->slots) {
+        secure_memset(table->slots, (table->mask + 1) * sizeof(HashMapSlot));
+        free(table->slots);
+    }
+    memset(table, 0, sizeof(HashTable));
+}
+
+/* the slots below first_live are skipped, they were migrated already */
+static uint64_t hash_table_find(const HashMap *map, const HashTable *table, uint32_t hash,
+                                const void *key, uint64_t first_live) {
+    uint64_t index = hash & table->mask;
+
+    for (uint32_t distance = 1;; distance++) {
+        const HashMapSlot *slot = &table->slots[index];
+
+        /* an entry would have taken this slot from one closer to its home */
+        if (slot->distance < distance) {
+            return HASH_MAP_NOT_FOUND;
+        }
+        if (slot->hash == hash && slot->key && index >= first_live &&
+            map->equal(slot->key, key)) {
+            return index;
+        }
+        index = (index + 1) & table->mask;
+    }
+}
+
+/* the key must not be in the table, the load keeps an empty slot ahead */
+static void hash_table_insert(HashTable *table, uint32_t hash, void *key, void *value) {
+    HashMapSlot carried = {.hash = hash, .distance = 1, .key = key, .value = value};
+    uint64_t index = hash & table->mask;
+
+    for (;; carried.distance++) {
+        HashMapSlot *slot = &table->slots[index];
+
+        if (!slot->distance) {
+            *slot = carried;
+            table->count++;
+            return;
+        }
+        if (slot->distance < carried.distance) {
+            HashMapSlot displaced = *slot;
+            *slot = carried;
+            carried = displaced;
+        }
+        index = (index + 1) & table->mask;
+    }
+}
+
+/* backward shift: the entries after the hole move one slot closer to home */
+static void hash_table_remove_at(HashTable *table, uint64_t index) {
+    for (;;) {
+        uint64_t next = (index + 1) & table->mask;
+
+        if (table->slots[next].distance <= 1) {
+            memset(&table->slots[index], 0, sizeof(HashMapSlot));
+            break;
+        }
+        table->slots[index] = table->slots[next];
+        table->slots[index].distance--;
+        index = next;
+    }
+    table->count--;
+}
+
+/* room for one more entry, doubling the table when the load is reached */
+static bool hash_map_reserve(HashMap *map) {
+    uint64_t slots = map->table.mask + 1;
+
+    if ((hash_map_size(map) + 1) * 8 <= slots * HASH_MAP_MAX_LOAD) {
+        return true;
+    }
+    if (slots > (SIZE_MAX / sizeof(HashMapSlot)) / 2) {
+        return false;
+    }
+
+    HashTable grown;
+    if (!hash_table_alloc(&grown, slots * 2)) {
+        return false;
+    }
+
+    /* a resize still running is finished first, only one old table at a time */
+    hash_map_migrate(map, UINT64_MAX);
+    map->old = map->table;
+    map->table = grown;
+    map->migrated = 0;
+    return true;
+}
+
+static void hash_map_migrate(HashMap *map, uint64_t steps) {
+    if (!map->old.slots) {
+        return;
+    }
+
+    uint64_t old_slots = map->old.mask + 1;
+    while (steps-- && map->migrated < old_slots) {
+        const HashMapSlot *slot = &map->old.slots[map->migrated++];
+
+        if (slot->distance && slot->key) {
+            hash_table_insert(&map->table, slot->hash, slot->key, slot->value);
+            map->old.count--;
+        }
+    }
+
+    if (map->migrated == old_slots) {
+        hash_table_free(&map->old);
+        map->migrated = 0;
+    }
+}
+
+static uint32_t hash_map_fold(const HashMap *map, const void *key) {
+    uint64_t hash = map->hash(key);
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+PrefixTree *prefix_tree_create(void) {
+    return calloc(1, sizeof(PrefixTree));
+}
+
+PrefixTree *prefix_tree_insert(PrefixTree *tree, const char *word, void *value) {
+    if (!tree || !word) {
+        return NULL;
+    }
+
+    PrefixTreeNode *node = &tree->root;
+    const char *rest = word;
+    size_t rest_len = strlen(word);
+
+    while (rest_len) {
+        bool found;
+        uint32_t index = prefix_child_index(node, (uint8_t)rest[0], &found);
+
+        if (!found) {
+            PrefixTreeNode *leaf = prefix_node_create(rest, rest_len);
+            if (!leaf || !prefix_node_add_value(leaf, value) || !prefix_node_reserve_child(node)) {
+                prefix_node_free(leaf, NULL);
+                return NULL;
+            }
+
+            memmove(&node->children[index + 1], &node->children[index],
+                    (node->child_count - index) * sizeof(PrefixTreeNode *));
+            node->children[index] = leaf;
+            node->child_count++;
+            tree->size++;
+            return tree;
+        }
+
+        PrefixTreeNode *child = node->children[index];
+        size_t common = 0;
+        while (common < child->label_len && common < rest_len &&
+               child->label[common] == rest[common]) {
+            common++;
+        }
+
+        /* the word leaves the edge midway: a node takes the shared part */
+        if (common < child->label_len) {
+            PrefixTreeNode *middle = prefix_node_create(child->label, common);
+            char *tail = malloc(child->label_len - common);
+            if (!middle || !tail || !prefix_node_reserve_child(middle)) {
+                prefix_node_free(middle, NULL);
+                free(tail);
+                return NULL;
+            }
+
+            memcpy(tail, child->label + common, child->label_len - common);
+            prefix_wipe_free(child->label, child->label_len);
+            child->label = tail;
+            child->label_len -= (uint32_t)common;
+
+            middle->children[0] = child;
+            middle->child_count = 1;
+            node->children[index] = middle;
+            child = middle;
+        }
+
+        node = child;
+        rest += common;
+        rest_len -= common;
+    }
+
+    if (!prefix_node_add_value(node, value)) {
+        return NULL;
+    }
+    tree->size++;
+    return tree;
+}
+
+bool prefix_tree_remove(PrefixTree *tree, const char *word, const void *value) {
+    if (!tree || !word || !prefix_tree_remove_below(&tree->root, word, strlen(word), value)) {
+        return false;
+    }
+
+    tree->size--;
+    return true;
+}
+
+uint64_t prefix_tree_find_prefix(const PrefixTree *tree, const char *prefix,
+                                 PrefixTreeVisitFn visit, void *arg) {
+    if (!tree || !prefix) {
+        return 0;
+    }
+
+    const PrefixTreeNode *node = &tree->root;
+    PrefixWord word = {0};
+    size_t rest_len = strlen(prefix);
+    uint64_t count = 0;
+    bool matched = true;
+
+    /* down to the node whose subtree holds every word starting with prefix */
+    while (rest_len && matched) {
+        bool found;
+        uint32_t index = prefix_child_index(node, (uint8_t)prefix[0], &found);
+        const PrefixTreeNode *child = found ? node->children[index] : NULL;
+        size_t compared = 0;
+
+        if (child) {
+            compared = (child->label_len < rest_len) ? child->label_len : rest_len;
+        }
+
+        matched = child && memcmp(child->label, prefix, compared) == 0 &&
+                  prefix_word_append(&word, child->label, child->label_len);
+        node = child;
+        prefix += compared;
+        rest_len -= compared;
+    }
+
+    if (matched && prefix_word_append(&word, "", 0)) {
+        prefix_tree_visit(node, &word, visit, arg, &count);
+    }
+
+    prefix_wipe_free(word.data, word.capacity);
+    return count;
+}
+
+uint64_t prefix_tree_size(const PrefixTree *tree) {
+    return tree ? tree->size : 0;
+}
+
+void prefix_tree_destroy(PrefixTree *tree, void (*destroy_value)(void *)) {
+    if (!tree) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < tree->root.child_count; i++) {
+        prefix_node_free(tree->root.children[i], destroy_value);
+    }
+    for (uint32_t i = 0; destroy_value && i < tree->root.value_count; i++) {
+        destroy_value(tree->root.values[i]);
+    }
+
+    free(tree->root.children);
+    free(tree->root.values);
+    free(tree);
+}
+
+static PrefixTreeNode *prefix_node_create(const char *label, size_t label_len) {
+    PrefixTreeNode *node = calloc(1, sizeof(PrefixTreeNode));
+    if (!node) {
+        return NULL;
+    }
+
+    node->label = malloc(label_len ? label_len : 1);
+    if (!node->label) {
+        free(node);
+        return NULL;
+    }
+
+    memcpy(node->label, label, label_len);
+    node->label_len = (uint32_t)label_len;
+    return node;
+}
+
+static void prefix_node_free(PrefixTreeNode *node, void (*destroy_value)(void *)) {
+    if (!node) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < node->child_count; i++) {
+        prefix_node_free(node->children[i], destroy_value);
+    }
+    for (uint32_t i = 0; destroy_value && i < node->value_count; i++) {
+        destroy_value(node->values[i]);
+    }
+
+    prefix_wipe_free(node->label, node->label_len);
+    free(node->children);
+    free(node->values);
+    free(node);
+}
+
+/* the index of the child starting with first, or where it would be inserted */
+static uint32_t prefix_child_index(const PrefixTreeNode *node, uint8_t first, bool *out_found) {
+    uint32_t low = 0;
+    uint32_t high = node->child_count;
+
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+
+        if ((uint8_t)node->children[middle]->label[0] < first) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    *out_found = low < node->child_count && (uint8_t)node->children[low]->label[0] == first;
+    return low;
+}
+
+static bool prefix_node_reserve_child(PrefixTreeNode *node) {
+    if (node->child_count < node->child_capacity) {
+        return true;
+    }
+
+    uint32_t capacity = node->child_capacity ? node->child_capacity * 2 : 2;
+    PrefixTreeNode **children = realloc(node->children, capacity * sizeof(PrefixTreeNode *));
+    if (!children) {
+        return false;
+    }
+
+    node->children = children;
+    node->child_capacity = capacity;
+    return true;
+}
+
+static bool prefix_node_add_value(PrefixTreeNode *node, void *value) {
+    if (node->value_count == node->value_capacity) {
+        uint32_t capacity = node->value_capacity ? node->value_capacity * 2 : 1;
+        void **values = realloc(node->values, capacity * sizeof(void *));
+        if (!values) {
+            return false;
+        }
+
+        node->values = values;
+        node->value_capacity = capacity;
+    }
+
+    node->values[node->value_count++] = value;
+    return true;
+}
+
+/* drops a child left without words, or merges it into its only child */
+static void prefix_node_tidy_child(PrefixTreeNode *node, uint32_t index) {
+    PrefixTreeNode *child = node->children[index];
+
+    if (child->value_count) {
+        return;
+    }
+
+    if (!child->child_count) {
+        memmove(&node->children[index], &node->children[index + 1],
+                (node->child_count - index - 1) * sizeof(PrefixTreeNode *));
+        node->child_count--;
+        prefix_node_free(child, NULL);
+        return;
+    }
+
+    if (child->child_count == 1) {
+        PrefixTreeNode *only = child->children[0];
+        size_t label_len = (size_t)child->label_len + only->label_len;
+        char *label = malloc(label_len);
+
+        /* without memory the split node stays, the tree is still correct */
+        if (!label) {
+            return;
+        }
+
+        memcpy(label, child->label, child->label_len);
+        memcpy(label + child->label_len, only->label, only->label_len);
+        prefix_wipe_free(only->label, only->label_len);
+        only->label = label;
+        only->label_len = (uint32_t)label_len;
+
+        node->children[index] = only;
+        child->child_count = 0;
+        prefix_node_free(child, NULL);
+    }
+}
+
+static bool prefix_tree_remove_below(PrefixTreeNode *node, const char *rest, size_t rest_len,
+                                     const void *value) {
+    if (!rest_len) {
+        for (uint32_t i = 0; i < node->value_count; i++) {
+            if (node->values[i] == value) {
+                memmove(&node->values[i], &node->values[i + 1],
+                        (node->value_count - i - 1) * sizeof(void *));
+                node->value_count--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool found;
+    uint32_t index = prefix_child_index(node, (uint8_t)rest[0], &found);
+    if (!found) {
+        return false;
+    }
+
+    PrefixTreeNode *child = node->children[index];
+    if (child->label_len > rest_len || memcmp(child->label, rest, child->label_len) != 0 ||
+        !prefix_tree_remove_below(child, rest + child->label_len, rest_len - child->label_len,
+                                  value)) {
+        return false;
+    }
+
+    prefix_node_tidy_child(node, index);
+    return true;
+}
+
+/* appends data and keeps the word NUL terminated */
+static bool prefix_word_append(PrefixWord *word, const char *data, size_t len) {
+    if (word->len + len + 1 > word->capacity) {
+        size_t capacity = word->capacity ? word->capacity : 64;
+        while (capacity < word->len + len + 1) {
+            capacity *= 2;
+        }
+
+        /* a copy rather than realloc, so the old buffer can be wiped */
+        char *grown = malloc(capacity);
+        if (!grown) {
+            return false;
+        }
+        if (word->data) {
+            memcpy(grown, word->data, word->len);
+        }
+        prefix_wipe_free(word->data, word->capacity);
+        word->data = grown;
+        word->capacity = capacity;
+    }
+
+    memcpy(word->data + word->len, data, len);
+    word->len += len;
+    word->data[word->len] = '\0';
+    return true;
+}
+
+/* false once visit asked to stop or the word could not grow */
+static bool prefix_tree_visit(const PrefixTreeNode *node, PrefixWord *word,
+                              PrefixTreeVisitFn visit, void *arg, uint64_t *count) {
+    for (uint32_t i = 0; i < node->value_count; i++) {
+        (*count)++;
+        if (visit && !visit(word->data, node->values[i], arg)) {
+            return false;
+        }
+    }
+
+    size_t len = word->len;
+    for (uint32_t i = 0; i < node->child_count; i++) {
+        const PrefixTreeNode *child = node->children[i];
+
+        if (!prefix_word_append(word, child->label, child->label_len) ||
+            !prefix_tree_visit(child, word, visit, arg, count)) {
+            return false;
+        }
+        word->len = len;
+        word->data[len] = '\0';
+    }
+    return true;
+}
+
+static void prefix_wipe_free(void *ptr, size_t len) {
+    if (ptr && len) {
+        secure_memset(ptr, len);
+    }
+    free(ptr);
+}
@@ -0,0 +1,290 @@
+#include <CVault/utils/secret_arena.h>
+#include <CVault/utils/security_utils.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+ * A region is one mapping: a guard page, the header below, the usable bytes
+ * and a second guard page. The header lives in the locked pages too, regions
+ * are chained from the newest to the oldest.
+ */
+typedef struct ArenaRegion {
+    struct ArenaRegion *older;
+    uint8_t *mapping;
+    size_t mapping_size;
+    uint8_t *data;
+    size_t capacity;
+    size_t used;
+    bool locked;
+} ArenaRegion;
+
+struct SecretArena {
+    pthread_mutex_t lock;
+    ArenaRegion *newest;
+    size_t region_size;
+    size_t page_size;
+    uint64_t allocations;
+};
+
+#define REGION_HEADER_SIZE \
+    ((sizeof(ArenaRegion) + SECRET_ARENA_ALIGN - 1) & ~(size_t)(SECRET_ARENA_ALIGN - 1))
+
+static ArenaRegion *map_region(SecretArena *arena, size_t usable);
+static void unmap_region(ArenaRegion *region);
+static void wipe_region(ArenaRegion *region, size_t from);
+static size_t round_up(size_t value, size_t multiple);
+
+SecretArena *secret_arena_create(size_t region_size) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0) {
+        return NULL;
+    }
+
+    SecretArena *arena = calloc(1, sizeof(SecretArena));
+    if (!arena) {
+        return NULL;
+    }
+    if (pthread_mutex_init(&arena->lock, NULL) != 0) {
+        free(arena);
+        return NULL;
+    }
+
+    arena->page_size = (size_t)page_size;
+    arena->region_size = round_up(region_size ? region_size : SECRET_ARENA_REGION_SIZE,
+                                  arena->page_size);
+    return arena;
+}
+
+void *secret_arena_alloc(SecretArena *arena, size_t size) {
+    if (!arena || !size || size > SIZE_MAX / 2) {
+        return NULL;
+    }
+
+    size_t needed = round_up(size, SECRET_ARENA_ALIGN);
+
+    pthread_mutex_lock(&arena->lock);
+    ArenaRegion *region = arena->newest;
+    if (!region || region->capacity - region->used < needed) {
+        /* the space left in the previous region is given up, regions stay in order */
+        region = map_region(arena, needed > arena->region_size ? needed : arena->region_size);
+        if (!region) {
+            pthread_mutex_unlock(&arena->lock);
+            return NULL;
+        }
+        region->older = arena->newest;
+        arena->newest = region;
+    }
+
+    void *block = region->data + region->used;
+    region->used += needed;
+    arena->allocations++;
+    pthread_mutex_unlock(&arena->lock);
+
+    return block;
+}
+
+char *secret_arena_strndup(SecretArena *arena, const void *data, size_t len) {
+    char *text = secret_arena_alloc(arena, len + 1);
+
+    if (text) {
+        memcpy(text, data, len);
+        text[len] = '\0';
+    }
+    return text;
+}
+
+SecretArenaMark secret_arena_mark(SecretArena *arena) {
+    SecretArenaMark mark = {0};
+
+    if (arena) {
+        pthread_mutex_lock(&arena->lock);
+        if (arena->newest) {
+            mark.region = arena->newest;
+            mark.used = arena->newest->used;
+        }
+        pthread_mutex_unlock(&arena->lock);
+    }
+    return mark;
+}
+
+void secret_arena_rewind(SecretArena *arena, SecretArenaMark mark) {
+    if (!arena) {
+        return;
+    }
+
+    pthread_mutex_lock(&arena->lock);
+    while (arena->newest && arena->newest != mark.region) {
+        ArenaRegion *region = arena->newest;
+
+        arena->newest = region->older;
+        unmap_region(region);
+    }
+
+    if (arena->newest && mark.used <= arena->newest->used) {
+        wipe_region(arena->newest, mark.used);
+        arena->newest->used = mark.used;
+    }
+    pthread_mutex_unlock(&arena->lock);
+}
+
+void secret_arena_reset(SecretArena *arena) {
+    if (!arena) {
+        return;
+    }
+
+    pthread_mutex_lock(&arena->lock);
+    while (arena->newest && arena->newest->older) {
+        ArenaRegion *region = arena->newest;
+
+        arena->newest = region->older;
+        unmap_region(region);
+    }
+
+    if (arena->newest) {
+        wipe_region(arena->newest, 0);
+        arena->newest->used = 0;
+    }
+    arena->allocations = 0;
+    pthread_mutex_unlock(&arena->lock);
+}
+
+void secret_arena_destroy(SecretArena *arena) {
+    if (!arena) {
+        return;
+    }
+
+    while (arena->newest) {
+        ArenaRegion *region = arena->newest;
+
+        arena->newest = region->older;
+        unmap_region(region);
+    }
+
+    pthread_mutex_destroy(&arena->lock);
+    free(arena);
+}
+
+void secret_arena_stats(SecretArena *arena, SecretArenaStats *out_stats) {
+    memset(out_stats, 0, sizeof(SecretArenaStats));
+    if (!arena) {
+        return;
+    }
+
+    pthread_mutex_lock(&arena->lock);
+    for (ArenaRegion *region = arena->newest; region; region = region->older) {
+        out_stats->regions++;
+        out_stats->capacity += region->capacity;
+        out_stats->used += region->used;
+        out_stats->locked += region->locked ? region->capacity : 0;
+    }
+    out_stats->allocations = arena->allocations;
+    pthread_mutex_unlock(&arena->lock);
+}
+
+/* mlock() failing (RLIMIT_MEMLOCK) leaves the region usable, it shows in the stats */
+static ArenaRegion *map_region(SecretArena *arena, size_t usable) {
+    size_t page = arena->page_size;
+    size_t body = round_up(REGION_HEADER_SIZE + usable, page);
+
+    if (body < usable) {
+        return NULL;
+    }
+
+    size_t mapping_size = body + 2 * page;
+    uint8_t *mapping =
+        mmap(NULL, mapping_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+
+    uint8_t *start = mapping + page;
+    if (mprotect(start, body, PROT_READ | PROT_WRITE) != 0) {
+        munmap(mapping, mapping_size);
+        return NULL;
+    }
+
+    madvise(start, body, MADV_DONTDUMP);
+#ifdef MADV_WIPEONFORK
+    /* the clipboard helper forks, its child starts with these pages zeroed */
+    madvise(start, body, MADV_WIPEONFORK);
+#endif
+
+    ArenaRegion *region = (ArenaRegion *)start;
+    region->older = NULL;
+    region->mapping = mapping;
+    region->mapping_size = mapping_size;
+    region->data = start + REGION_HEADER_SIZE;
+    region->capacity = body - REGION_HEADER_SIZE;
+    region->used = 0;
+    region->locked = mlock(start, body) == 0;
+    return region;
+}
+
+/* munmap() drops the lock along with the pages */
+static void unmap_region(ArenaRegion *region) {
+    uint8_t *mapping = region->mapping;
+    size_t mapping_size = region->mapping_size;
+
+    wipe_region(region, 0);
+    munmap(mapping, mapping_size);
+}
+
+/* clears data[from, used) */
+static void wipe_region(ArenaRegion *region, size_t from) {
+    if (region->used > from) {
+        secure_memset(region->data + from, region->used - from);
+    }
+}
+
+static size_t round_up(size_t value, size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+#else
+// TODO: add portability to other platforms
+SecretArena *secret_arena_create(size_t region_size) {
+    (void)region_size;
+    return NULL;
+}
+
+void *secret_arena_alloc(SecretArena *arena, size_t size) {
+    (void)arena;
+    (void)size;
+    return NULL;
+}
+
+char *secret_arena_strndup(SecretArena *arena, const void *data, size_t len) {
+    (void)arena;
+    (void)data;
+    (void)len;
+    return NULL;
+}
+
+SecretArenaMark secret_arena_mark(SecretArena *arena) {
+    (void)arena;
+    return (SecretArenaMark){0};
+}
+
+void secret_arena_rewind(SecretArena *arena, SecretArenaMark mark) {
+    (void)arena;
+    (void)mark;
+}
+
+void secret_arena_reset(SecretArena *arena) {
+    (void)arena;
+}
+
+void secret_arena_destroy(SecretArena *arena) {
+    (void)arena;
+}
+
+void secret_arena_stats(SecretArena *arena, SecretArenaStats *out_stats) {
+    (void)arena;
+    memset(out_stats, 0, sizeof(SecretArenaStats));
+}
+#endif
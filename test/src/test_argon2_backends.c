@@ -0,0 +1,263 @@
+#include <argon2/argon2.h>
+#include <argon2/core.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define COLOR_RESET  "\033[0m"
+#define COLOR_GREEN  "\033[0;32m"
+#define COLOR_RED    "\033[0;31m"
+#define COLOR_BLUE   "\033[34m"
+#define COLOR_YELLOW "\033[1;33m"
+#define COLOR_CYAN   "\033[0;36m"
+
+#define TAG_LEN 32
+
+/* runs per backend timing, the median is reported */
+#define BENCH_RUNS 5
+
+/* RFC 9106 section 5.3 test vector (Argon2id, version 0x13) */
+static const uint8_t rfc_argon2id_tag[TAG_LEN] = {
+    0x0d, 0x64, 0x0d, 0xf5, 0x8d, 0x78, 0x76, 0x6c, 0x08, 0xc0, 0x37, 0xa3, 0x4a, 0x8b, 0x53, 0xc9,
+    0xd0, 0x1e, 0xf0, 0x45, 0x2d, 0x75, 0xb6, 0x5e, 0xb5, 0x25, 0x20, 0xe9, 0x6b, 0x01, 0xe6, 0x59};
+
+typedef struct {
+    argon2_type type;
+    uint32_t version;
+    uint32_t t_cost;
+    uint32_t m_cost;
+    uint32_t lanes;
+} kat_params;
+
+static const kat_params cases[] = {
+    {Argon2_id, ARGON2_VERSION_13, 3, 32, 4},  {Argon2_id, ARGON2_VERSION_13, 1, 8, 1},
+    {Argon2_id, ARGON2_VERSION_13, 2, 1024, 2}, {Argon2_id, ARGON2_VERSION_13, 3, 4096, 4},
+    {Argon2_i, ARGON2_VERSION_13, 2, 2048, 1},  {Argon2_i, ARGON2_VERSION_13, 3, 256, 3},
+    {Argon2_d, ARGON2_VERSION_13, 2, 2048, 2},  {Argon2_d, ARGON2_VERSION_10, 2, 512, 2},
+    {Argon2_id, ARGON2_VERSION_10, 1, 512, 1},
+};
+
+static int run_argon2_threads(const kat_params *p, uint32_t threads, uint8_t *out) {
+    uint8_t pwd[32];
+    uint8_t salt[16];
+    uint8_t secret[8];
+    uint8_t ad[12];
+
+    memset(pwd, 0x01, sizeof(pwd));
+    memset(salt, 0x02, sizeof(salt));
+    memset(secret, 0x03, sizeof(secret));
+    memset(ad, 0x04, sizeof(ad));
+
+    argon2_context ctx = {.out = out,
+                          .outlen = TAG_LEN,
+                          .pwd = pwd,
+                          .pwdlen = sizeof(pwd),
+                          .salt = salt,
+                          .saltlen = sizeof(salt),
+                          .secret = secret,
+                          .secretlen = sizeof(secret),
+                          .ad = ad,
+                          .adlen = sizeof(ad),
+                          .t_cost = p->t_cost,
+                          .m_cost = p->m_cost,
+                          .lanes = p->lanes,
+                          .threads = threads,
+                          .allocate_cbk = NULL,
+                          .free_cbk = NULL,
+                          .flags = ARGON2_DEFAULT_FLAGS,
+                          .version = p->version};
+
+    return argon2_ctx(&ctx, p->type);
+}
+
+static int run_argon2(const kat_params *p, uint8_t *out) {
+    return run_argon2_threads(p, p->lanes, out);
+}
+
+static bool test_rfc_vector(argon2_impl impl) {
+    uint8_t out[TAG_LEN];
+
+    argon2_select_impl(impl);
+    if (run_argon2(&cases[0], out) != ARGON2_OK) {
+        return false;
+    }
+    return memcmp(out, rfc_argon2id_tag, TAG_LEN) == 0;
+}
+
+static bool test_against_ref(argon2_impl impl) {
+    uint8_t expected[TAG_LEN];
+    uint8_t out[TAG_LEN];
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        argon2_select_impl(ARGON2_IMPL_REF);
+        if (run_argon2(&cases[i], expected) != ARGON2_OK) {
+            return false;
+        }
+
+        argon2_select_impl(impl);
+        if (run_argon2(&cases[i], out) != ARGON2_OK) {
+            return false;
+        }
+
+        if (memcmp(out, expected, TAG_LEN) != 0) {
+            printf(COLOR_RED ">> mismatch on case %zu (type %d, v 0x%x, t %u, m %u, p %u)\n" COLOR_RESET,
+                   i, cases[i].type, cases[i].version, cases[i].t_cost, cases[i].m_cost,
+                   cases[i].lanes);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* median of BENCH_RUNS hashes, one run is too noisy to rank backends */
+static double time_impl(argon2_impl impl) {
+    const kat_params bench = {Argon2_id, ARGON2_VERSION_13, 1, 65536, 2};
+    uint8_t out[TAG_LEN];
+    struct timespec start, end;
+    double runs[BENCH_RUNS];
+
+    argon2_select_impl(impl);
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        run_argon2(&bench, out);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        runs[r] = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    }
+
+    /* insertion sort, a handful of values */
+    for (int i = 1; i < BENCH_RUNS; i++) {
+        double value = runs[i];
+        int j = i;
+        for (; j > 0 && runs[j - 1] > value; j--) {
+            runs[j] = runs[j - 1];
+        }
+        runs[j] = value;
+    }
+    return runs[BENCH_RUNS / 2];
+}
+
+static const kat_params pool_case = {Argon2_id, ARGON2_VERSION_13, 3, 2048, 8};
+static uint8_t pool_expected[TAG_LEN];
+
+static bool test_pool_thread_counts() {
+    uint8_t out[TAG_LEN];
+
+    if (run_argon2_threads(&pool_case, 1, pool_expected) != ARGON2_OK) {
+        return false;
+    }
+
+    /* same result whatever the number of participants, pool reused each time */
+    for (uint32_t threads = 2; threads <= pool_case.lanes; threads++) {
+        for (int repeat = 0; repeat < 4; repeat++) {
+            if (run_argon2_threads(&pool_case, threads, out) != ARGON2_OK) {
+                return false;
+            }
+            if (memcmp(out, pool_expected, TAG_LEN) != 0) {
+                printf(COLOR_RED ">> mismatch with %u threads\n" COLOR_RESET, threads);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void *concurrent_hash(void *arg) {
+    bool *ok = arg;
+    uint8_t out[TAG_LEN];
+
+    *ok = true;
+    for (int repeat = 0; repeat < 8; repeat++) {
+        if (run_argon2_threads(&pool_case, 4, out) != ARGON2_OK ||
+            memcmp(out, pool_expected, TAG_LEN) != 0) {
+            *ok = false;
+        }
+    }
+    return NULL;
+}
+
+static bool test_pool_concurrent_callers() {
+    pthread_t callers[3];
+    bool ok[3];
+
+    for (int i = 0; i < 3; i++) {
+        if (pthread_create(&callers[i], NULL, concurrent_hash, &ok[i])) {
+            return false;
+        }
+    }
+
+    bool passed = true;
+    for (int i = 0; i < 3; i++) {
+        pthread_join(callers[i], NULL);
+        passed = passed && ok[i];
+    }
+    return passed;
+}
+
+int main() {
+    printf(COLOR_BLUE "\nARGON2 BACKENDS TEST\n" COLOR_RESET);
+
+    argon2_impl best = argon2_selected_impl();
+    printf(COLOR_CYAN "Selected at startup: %s\n" COLOR_RESET, argon2_impl_name(best));
+
+    bool passed = true;
+    double ref_ms = 0;
+
+    for (int impl = ARGON2_IMPL_REF; impl < ARGON2_IMPL_COUNT; impl++) {
+        const char *name = argon2_impl_name((argon2_impl)impl);
+
+        printf(COLOR_YELLOW "\n--> %s\n" COLOR_RESET, name);
+        if (!argon2_impl_supported((argon2_impl)impl)) {
+            printf(COLOR_YELLOW "[SKIP] not supported by this CPU\n" COLOR_RESET);
+            continue;
+        }
+
+        if (test_rfc_vector((argon2_impl)impl)) {
+            printf(COLOR_GREEN "[PASS] " COLOR_RESET "RFC 9106 Argon2id vector\n");
+        } else {
+            printf(COLOR_RED "[FAIL] " COLOR_RESET "RFC 9106 Argon2id vector\n");
+            passed = false;
+        }
+
+        if (test_against_ref((argon2_impl)impl)) {
+            printf(COLOR_GREEN "[PASS] " COLOR_RESET "identical to ref on all cases\n");
+        } else {
+            printf(COLOR_RED "[FAIL] " COLOR_RESET "output differs from ref\n");
+            passed = false;
+        }
+
+        double ms = time_impl((argon2_impl)impl);
+        if (impl == ARGON2_IMPL_REF) {
+            ref_ms = ms;
+        }
+        printf(COLOR_CYAN "64 MiB, t=1, p=2: %.1f ms median, %.2fx ref\n" COLOR_RESET, ms,
+               ref_ms / ms);
+    }
+
+    argon2_select_impl(best);
+
+    printf(COLOR_YELLOW "\n--> lane worker pool\n" COLOR_RESET);
+    if (test_pool_thread_counts()) {
+        printf(COLOR_GREEN "[PASS] " COLOR_RESET "output independent of thread count\n");
+    } else {
+        printf(COLOR_RED "[FAIL] " COLOR_RESET "output depends on thread count\n");
+        passed = false;
+    }
+
+    if (test_pool_concurrent_callers()) {
+        printf(COLOR_GREEN "[PASS] " COLOR_RESET "concurrent callers share the pool\n");
+    } else {
+        printf(COLOR_RED "[FAIL] " COLOR_RESET "concurrent callers\n");
+        passed = false;
+    }
+
+    if (!passed) {
+        printf(COLOR_RED "\nARGON2 BACKENDS TEST FAILED\n\n" COLOR_RESET);
+        return 1;
+    }
+
+    printf(COLOR_BLUE "\nARGON2 BACKENDS TEST COMPLETED\n\n" COLOR_RESET);
+    return 0;
+}
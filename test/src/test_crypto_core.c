@@ -11,6 +11,8 @@
 #define COLOR_YELLOW "\033[1;33m"
 
 static void print_hex(const char *label, const uint8_t *data, size_t len);
+static bool test_aead_context(const uint8_t *key);
+static bool test_tagged_blobs(const uint8_t *key);
 
 int main() {
 	printf(COLOR_BLUE"\nCRYPTO CORE TEST\n"COLOR_GREEN);
@@ -93,6 +95,40 @@ int main() {
         fprintf(stderr,COLOR_RED">> Verification FAILED: Key does not match.\n"COLOR_RESET);
     }
 
+    printf(COLOR_YELLOW"\n--> Keyed Hash Phase\n\n"COLOR_RESET);
+
+    /* BLAKE2b keyed known answer: key 00..3f, message 00 01 02 */
+    static const uint8_t kat_digest[KEYED_HASH_MAX_LEN] = {
+        0x33, 0xd0, 0x82, 0x5d, 0xdd, 0xf7, 0xad, 0xa9, 0x9b, 0x0e, 0x7e, 0x30, 0x71, 0x04, 0xad, 0x07,
+        0xca, 0x9c, 0xfd, 0x96, 0x92, 0x21, 0x4f, 0x15, 0x61, 0x35, 0x63, 0x15, 0xe7, 0x84, 0xf3, 0xe5,
+        0xa1, 0x7e, 0x36, 0x4a, 0xe9, 0xdb, 0xb1, 0x4c, 0xb2, 0x03, 0x6d, 0xf9, 0x32, 0xb7, 0x7f, 0x4b,
+        0x29, 0x27, 0x61, 0x36, 0x5f, 0xb3, 0x28, 0xde, 0x7a, 0xfd, 0xc6, 0xd8, 0x99, 0x8f, 0x5f, 0xc1};
+    uint8_t kat_key[KEYED_HASH_MAX_KEY_LEN];
+    uint8_t kat_message[3] = {0x00, 0x01, 0x02};
+    uint8_t digest[KEYED_HASH_MAX_LEN];
+
+    for (size_t i = 0; i < sizeof(kat_key); i++) {
+        kat_key[i] = (uint8_t)i;
+    }
+
+    if (!keyed_hash(kat_key, sizeof(kat_key), kat_message, sizeof(kat_message), digest,
+                    sizeof(digest)) ||
+        memcmp(digest, kat_digest, sizeof(digest)) != 0) {
+        fprintf(stderr, COLOR_RED">> Keyed hash does not match the BLAKE2b test vector\n"COLOR_RESET);
+        return 1;
+    }
+    printf(COLOR_GREEN">> Keyed hash matches the BLAKE2b test vector\n"COLOR_RESET);
+
+    printf(COLOR_YELLOW"\n--> AEAD Context Phase\n\n"COLOR_RESET);
+    if (!test_aead_context(master_key)) {
+        return 1;
+    }
+
+    printf(COLOR_YELLOW"\n--> Tagged Blob Phase\n\n"COLOR_RESET);
+    if (!test_tagged_blobs(master_key)) {
+        return 1;
+    }
+
     return 0;
 }
 
@@ -110,3 +146,124 @@ static void print_hex(const char *label, const uint8_t *data, size_t len) {
     if (len % 16 != 0)
         printf("\n");
 }
+
+static bool test_aead_context(const uint8_t *key) {
+    const char *fields[] = {"github.com", "octocat", "s3cr3t-p4ss", ""};
+    BlobSpan plaintexts[4];
+    BlobSpan blobs[4];
+    BlobSpan opened[4];
+    size_t total = 0;
+
+    for (size_t i = 0; i < 4; i++) {
+        plaintexts[i].data = (const uint8_t *)fields[i];
+        plaintexts[i].len = strlen(fields[i]);
+        total += plaintexts[i].len;
+    }
+
+    uint8_t slab[total + 4 * BLOB_OVERHEAD];
+    uint8_t out[total + 1];
+
+    AeadContext *aead = aead_context_new(key);
+    if (!aead) {
+        fprintf(stderr, COLOR_RED">> Failed to create the AEAD context\n"COLOR_RESET);
+        return false;
+    }
+
+    bool ok = aead_encrypt_batch(aead, plaintexts, 4, slab, sizeof(slab), blobs) &&
+              aead_decrypt_batch(aead, blobs, 4, out, total, opened);
+    for (size_t i = 0; ok && i < 4; i++) {
+        ok = opened[i].len == plaintexts[i].len &&
+             memcmp(opened[i].data, fields[i], opened[i].len) == 0;
+    }
+    if (!ok) {
+        fprintf(stderr, COLOR_RED">> Batch round trip failed\n"COLOR_RESET);
+        aead_context_free(aead);
+        return false;
+    }
+    printf(COLOR_GREEN">> Batch round trip succeeded\n"COLOR_RESET);
+
+    /* the context and the one-shot functions read each other's blobs */
+    uint8_t one_shot[sizeof(slab)];
+    ok = decrypt_blob(key, blobs[2].data, blobs[2].len, out) &&
+         memcmp(out, fields[2], plaintexts[2].len) == 0 &&
+         encrypt_blob(key, plaintexts[0].data, plaintexts[0].len, one_shot) &&
+         aead_decrypt(aead, one_shot, plaintexts[0].len + BLOB_OVERHEAD, out) &&
+         memcmp(out, fields[0], plaintexts[0].len) == 0;
+    if (!ok) {
+        fprintf(stderr, COLOR_RED">> Context and one-shot blobs differ\n"COLOR_RESET);
+        aead_context_free(aead);
+        return false;
+    }
+    printf(COLOR_GREEN">> Context blobs match the one-shot format\n"COLOR_RESET);
+
+    /* a tampered blob fails the whole batch and leaves nothing behind */
+    slab[blobs[2].len + blobs[0].len + blobs[1].len - 1] ^= 0x01;
+    memset(out, 0xAA, sizeof(out));
+    ok = !aead_decrypt_batch(aead, blobs, 4, out, total, NULL);
+    for (size_t i = 0; ok && i < plaintexts[0].len + plaintexts[1].len; i++) {
+        ok = out[i] == 0;
+    }
+    ok = ok && !aead_encrypt_batch(aead, plaintexts, 4, slab, sizeof(slab) - 1, NULL);
+    aead_context_free(aead);
+
+    if (!ok) {
+        fprintf(stderr, COLOR_RED">> Tampered blob or short slab accepted\n"COLOR_RESET);
+        return false;
+    }
+    printf(COLOR_GREEN">> Tampered blob and short slab rejected\n"COLOR_RESET);
+    return true;
+}
+
+static bool test_tagged_blobs(const uint8_t *key) {
+    const uint8_t ciphers[] = {CIPHER_AES_256_GCM, CIPHER_CHACHA20_POLY1305};
+    const char *plaintext = "correct horse battery staple";
+    const uint8_t ad[] = "uuid";
+    size_t pt_len = strlen(plaintext);
+    uint8_t blob[pt_len + TAGGED_BLOB_OVERHEAD];
+    uint8_t out[pt_len + 1];
+
+    printf(">> preferred cipher on this host: %s\n",
+           preferred_cipher() == CIPHER_AES_256_GCM ? "AES-256-GCM" : "ChaCha20-Poly1305");
+
+    for (size_t i = 0; i < 2; i++) {
+        AeadContext *sealer = aead_context_new_cipher(key, ciphers[i]);
+        AeadContext *opener = aead_context_new(key);
+
+        /* whatever the context's own cipher, the header picks the one to open with */
+        bool ok = sealer && opener && aead_context_cipher(sealer) == ciphers[i] &&
+                  aead_seal_tagged(sealer, ad, sizeof(ad), (const uint8_t *)plaintext, pt_len,
+                                   blob) &&
+                  blob[0] == ciphers[i] &&
+                  aead_open_tagged(opener, ad, sizeof(ad), blob, sizeof(blob), out) &&
+                  memcmp(out, plaintext, pt_len) == 0 &&
+                  !aead_open_tagged(opener, ad, sizeof(ad) - 1, blob, sizeof(blob), out);
+
+        /* the cipher id is authenticated, switching it cannot open the blob */
+        blob[0] = ciphers[1 - i];
+        ok = ok && !aead_open_tagged(opener, ad, sizeof(ad), blob, sizeof(blob), out);
+        blob[0] = 0x7F;
+        ok = ok && !aead_open_tagged(opener, ad, sizeof(ad), blob, sizeof(blob), out);
+
+        ok = ok && encrypt_tagged_blob(key, ciphers[i], (const uint8_t *)plaintext, pt_len, blob) &&
+             decrypt_tagged_blob(key, blob, sizeof(blob), out) &&
+             memcmp(out, plaintext, pt_len) == 0;
+
+        aead_context_free(sealer);
+        aead_context_free(opener);
+        if (!ok) {
+            fprintf(stderr, COLOR_RED">> Tagged blob round trip failed for cipher %u\n"COLOR_RESET,
+                    ciphers[i]);
+            return false;
+        }
+        printf(COLOR_GREEN">> Tagged blob round trip succeeded for cipher %u\n"COLOR_RESET,
+               ciphers[i]);
+    }
+
+    if (aead_context_new_cipher(key, 0x7F) || is_valid_cipher(0) ||
+        encrypt_tagged_blob(key, 0x7F, (const uint8_t *)plaintext, pt_len, blob)) {
+        fprintf(stderr, COLOR_RED">> Unknown cipher accepted\n"COLOR_RESET);
+        return false;
+    }
+    printf(COLOR_GREEN">> Unknown cipher rejected\n"COLOR_RESET);
+    return true;
+}
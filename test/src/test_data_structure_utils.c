@@ -1,7 +1,10 @@
 #include "argon2/core.h"
 #include <CVault/utils/data_structure_utils.h>
+#include <CVault/utils/security_utils.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #define COLOR_RESET  "\033[0m"
 #define COLOR_GREEN  "\033[0;32m"
@@ -10,8 +13,18 @@
 #define COLOR_YELLOW "\033[1;33m"
 #define COLOR_CYAN   "\033[0;36m"
 
+#define MAP_KEYS 50000
+#define MAP_OPS  400000
+
 DLinkedList *wrapper;
 
+#define TREE_WORDS 100000
+
+static char map_keys[MAP_KEYS][24];
+static char tree_words[TREE_WORDS][32];
+static int map_values[MAP_KEYS];
+static bool map_present[MAP_KEYS];
+
 bool test_create_list(){
 	wrapper = dlinked_list_create();
 	
@@ -131,6 +144,252 @@ bool test_destroy_node(){
 	return true;
 }
 
+bool test_hash_map_basics(){
+	HashMap *map = hash_map_create(hash_map_hash_string, hash_map_string_equal, 0);
+	void *previous = (void *)1;
+	int one = 1, two = 2;
+	char key[] = "github.com";
+
+	bool ok = map && hash_map_put(map, "github.com", &one, &previous) && previous == NULL &&
+	          hash_map_get(map, key) == &one && hash_map_contains(map, key) &&
+	          !hash_map_get(map, "gitlab.com") && hash_map_size(map) == 1 &&
+	          hash_map_put(map, key, &two, &previous) && previous == &one &&
+	          hash_map_get(map, "github.com") == &two && hash_map_size(map) == 1 &&
+	          !hash_map_put(map, NULL, &one, NULL) &&
+	          hash_map_remove(map, "github.com", &previous) && previous == &two &&
+	          !hash_map_remove(map, "github.com", NULL) && hash_map_size(map) == 0;
+
+	hash_map_destroy(map, NULL);
+	if(ok){
+		printf(COLOR_GREEN"-> put, replace, get and remove behave\n"COLOR_RESET);
+	}else {
+		printf(COLOR_RED"-> basic operations failed\n"COLOR_RESET);
+	}
+	return ok;
+}
+
+/* random puts and removes checked against a plain array, across many resizes */
+bool test_hash_map_random_ops(){
+	HashMap *map = hash_map_create(hash_map_hash_string, hash_map_string_equal, 0);
+	uint64_t expected = 0;
+	bool ok = map != NULL;
+
+	for(int i = 0; i < MAP_KEYS; i++){
+		snprintf(map_keys[i], sizeof(map_keys[i]), "service-%d.example", i);
+		map_values[i] = i;
+		map_present[i] = false;
+	}
+
+	srand(42);
+	for(int op = 0; ok && op < MAP_OPS; op++){
+		/* the live range widens over time so the map keeps growing */
+		int i = rand() % (1 + (int)((long)MAP_KEYS * (op + 1) / MAP_OPS));
+		void *previous;
+
+		switch(rand() % 3){
+			case 0:
+			case 1:
+				ok = hash_map_put(map, map_keys[i], &map_values[i], &previous) &&
+				     previous == (map_present[i] ? &map_values[i] : NULL);
+				expected += !map_present[i];
+				map_present[i] = true;
+				break;
+			default:
+				ok = hash_map_remove(map, map_keys[i], &previous) == map_present[i] &&
+				     previous == (map_present[i] ? &map_values[i] : NULL);
+				expected -= map_present[i];
+				map_present[i] = false;
+				break;
+		}
+		ok = ok && hash_map_size(map) == expected;
+	}
+
+	for(int i = 0; ok && i < MAP_KEYS; i++){
+		ok = hash_map_get(map, map_keys[i]) == (map_present[i] ? &map_values[i] : NULL);
+	}
+
+	/* every entry is walked exactly once */
+	uint64_t iterator = 0, walked = 0;
+	void *key, *value;
+	while(ok && hash_map_next(map, &iterator, &key, &value)){
+		int i = *(int *)value;
+		ok = map_present[i] && key == map_keys[i];
+		map_present[i] = false;
+		walked++;
+	}
+	ok = ok && walked == expected;
+
+	hash_map_destroy(map, NULL);
+	if(ok){
+		printf(COLOR_GREEN"-> %d random operations match, %lu keys left\n"COLOR_RESET, MAP_OPS,
+		       (unsigned long)expected);
+	}else {
+		printf(COLOR_RED"-> map diverged from the reference\n"COLOR_RESET);
+	}
+	return ok;
+}
+
+static int destroyed = 0;
+
+static void wipe_entry(void *key, void *value){
+	(void)key;
+	secure_memset(value, sizeof(int));
+	destroyed++;
+}
+
+bool test_hash_map_destroy(){
+	HashMap *map = hash_map_create(hash_map_hash_string, hash_map_string_equal, MAP_KEYS);
+	bool ok = map != NULL;
+
+	for(int i = 0; ok && i < MAP_KEYS; i++){
+		map_values[i] = i + 1;
+		ok = hash_map_put(map, map_keys[i], &map_values[i], NULL) != NULL;
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(int i = 0; ok && i < MAP_KEYS; i++){
+		ok = hash_map_get(map, map_keys[i]) == &map_values[i];
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double ns = ((double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec)) /
+	            MAP_KEYS;
+	printf(COLOR_CYAN"-> %.1f ns per lookup over %d keys\n"COLOR_RESET, ns, MAP_KEYS);
+
+	hash_map_destroy(map, wipe_entry);
+	for(int i = 0; ok && i < MAP_KEYS; i++){
+		ok = map_values[i] == 0;
+	}
+	ok = ok && destroyed == MAP_KEYS;
+
+	if(ok){
+		printf(COLOR_GREEN"-> destroy hook wiped every value\n"COLOR_RESET);
+	}else {
+		printf(COLOR_RED"-> destroy hook missed entries\n"COLOR_RESET);
+	}
+	return ok;
+}
+
+static bool collect_word(const char *word, void *value, void *arg){
+	char *out = arg;
+	strcat(out, word);
+	strcat(out, (const char *)value);
+	strcat(out, " ");
+	return true;
+}
+
+bool test_prefix_tree_basics(){
+	PrefixTree *tree = prefix_tree_create();
+	char found[256] = "";
+
+	bool ok = tree && prefix_tree_insert(tree, "github.com", "1") &&
+	          prefix_tree_insert(tree, "gitlab.com", "2") && prefix_tree_insert(tree, "git", "3") &&
+	          prefix_tree_insert(tree, "google.com", "4") &&
+	          prefix_tree_insert(tree, "github.com", "5") && prefix_tree_size(tree) == 5;
+
+	ok = ok && prefix_tree_find_prefix(tree, "git", collect_word, found) == 4 &&
+	     strcmp(found, "git3 github.com1 github.com5 gitlab.com2 ") == 0;
+	ok = ok && prefix_tree_find_prefix(tree, "gith", NULL, NULL) == 2 &&
+	     prefix_tree_find_prefix(tree, "github.com.", NULL, NULL) == 0 &&
+	     prefix_tree_find_prefix(tree, "x", NULL, NULL) == 0 &&
+	     prefix_tree_find_prefix(tree, "", NULL, NULL) == 5;
+
+	/* removals merge the split edges back */
+	ok = ok && prefix_tree_remove(tree, "github.com", "1") &&
+	     !prefix_tree_remove(tree, "github.com", "1") && !prefix_tree_remove(tree, "gi", "3") &&
+	     prefix_tree_remove(tree, "git", "3") && prefix_tree_remove(tree, "gitlab.com", "2");
+	found[0] = '\0';
+	ok = ok && prefix_tree_find_prefix(tree, "g", collect_word, found) == 2 &&
+	     strcmp(found, "github.com5 google.com4 ") == 0;
+
+	ok = ok && prefix_tree_remove(tree, "github.com", "5") &&
+	     prefix_tree_remove(tree, "google.com", "4") && prefix_tree_size(tree) == 0 &&
+	     prefix_tree_find_prefix(tree, "", NULL, NULL) == 0;
+
+	prefix_tree_destroy(tree, NULL);
+	if(ok){
+		printf(COLOR_GREEN"-> insert, remove and prefix search behave\n"COLOR_RESET);
+	}else {
+		printf(COLOR_RED"-> basic operations failed\n"COLOR_RESET);
+	}
+	return ok;
+}
+
+typedef struct {
+	int seen;
+	int limit;
+} Suggestions;
+
+static bool take_suggestion(const char *word, void *value, void *arg){
+	(void)word;
+	(void)value;
+	Suggestions *suggestions = arg;
+	return ++suggestions->seen < suggestions->limit;
+}
+
+static int destroyed_words = 0;
+
+static void count_value(void *value){
+	(void)value;
+	destroyed_words++;
+}
+
+/* counts checked against a scan of the words, then ten suggestions timed */
+bool test_prefix_tree_autocomplete(){
+	static const char *sites[] = {"git", "google", "mail", "bank", "shop", "cloud", "news"};
+	PrefixTree *tree = prefix_tree_create();
+	bool ok = tree != NULL;
+
+	srand(7);
+	for(int i = 0; ok && i < TREE_WORDS; i++){
+		snprintf(tree_words[i], sizeof(tree_words[i]), "%s%d.example", sites[rand() % 7],
+		         rand() % 50000);
+		ok = prefix_tree_insert(tree, tree_words[i], tree_words[i]) != NULL;
+	}
+
+	const char *prefixes[] = {"", "g", "git", "git1", "git12", "google4", "mail999", "zzz"};
+	for(int p = 0; ok && p < 8; p++){
+		uint64_t expected = 0;
+		for(int i = 0; i < TREE_WORDS; i++){
+			expected += strncmp(tree_words[i], prefixes[p], strlen(prefixes[p])) == 0;
+		}
+		ok = prefix_tree_find_prefix(tree, prefixes[p], NULL, NULL) == expected;
+	}
+
+	/* every other word removed, the rest still found */
+	for(int i = 0; ok && i < TREE_WORDS; i += 2){
+		ok = prefix_tree_remove(tree, tree_words[i], tree_words[i]);
+	}
+	ok = ok && prefix_tree_size(tree) == TREE_WORDS / 2;
+	for(int i = 1; ok && i < TREE_WORDS; i += 2){
+		ok = prefix_tree_find_prefix(tree, tree_words[i], NULL, NULL) >= 1;
+	}
+
+	struct timespec start, end;
+	Suggestions suggestions = {.limit = 10};
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(int round = 0; round < 1000; round++){
+		suggestions.seen = 0;
+		prefix_tree_find_prefix(tree, "git", take_suggestion, &suggestions);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double us = ((double)(end.tv_sec - start.tv_sec) * 1e6 +
+	             (double)(end.tv_nsec - start.tv_nsec) / 1e3) / 1000;
+	printf(COLOR_CYAN"-> %.2f us for ten suggestions among %d words\n"COLOR_RESET, us,
+	       TREE_WORDS / 2);
+	ok = ok && suggestions.seen == 10;
+
+	prefix_tree_destroy(tree, count_value);
+	ok = ok && destroyed_words == TREE_WORDS / 2;
+
+	if(ok){
+		printf(COLOR_GREEN"-> prefix counts match a full scan\n"COLOR_RESET);
+	}else {
+		printf(COLOR_RED"-> prefix search diverged from a full scan\n"COLOR_RESET);
+	}
+	return ok;
+}
+
 int main() {
 	printf(COLOR_BLUE"\nTEST DATA STRUCTURE UTILS\n\n"COLOR_RESET);
 
@@ -157,6 +416,30 @@ int main() {
 		printf(COLOR_RED"destroying failed\n"COLOR_RESET);
 	}
 
+	printf(COLOR_CYAN"\nHASH MAP LOGIC\n\n"COLOR_RESET);
+	bool map_ok = true;
+	printf("Test basic operations : \n");
+	map_ok = test_hash_map_basics() && map_ok;
+	printf("\nTest random operations : \n");
+	map_ok = test_hash_map_random_ops() && map_ok;
+	printf("\nTest destroying : \n");
+	map_ok = test_hash_map_destroy() && map_ok;
+	if(!map_ok){
+		printf(COLOR_RED"\nhash map tests failed\n"COLOR_RESET);
+		return 1;
+	}
+
+	printf(COLOR_CYAN"\nPREFIX TREE LOGIC\n\n"COLOR_RESET);
+	bool tree_ok = true;
+	printf("Test basic operations : \n");
+	tree_ok = test_prefix_tree_basics() && tree_ok;
+	printf("\nTest autocomplete : \n");
+	tree_ok = test_prefix_tree_autocomplete() && tree_ok;
+	if(!tree_ok){
+		printf(COLOR_RED"\nprefix tree tests failed\n"COLOR_RESET);
+		return 1;
+	}
+
 	printf(COLOR_GREEN"\nAll tests passed!\n"COLOR_RESET);
 	return 0;
 }
@@ -0,0 +1,363 @@
+#include <CVault/crypto/crypto_core.h>
+#include <CVault/repository/repository.h>
+#include <CVault/service/entry_service.h>
+#include <CVault/utils/security_utils.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COLOR_RESET  "\033[0m"
+#define COLOR_GREEN  "\033[0;32m"
+#define COLOR_RED    "\033[0;31m"
+#define COLOR_BLUE   "\033[34m"
+#define COLOR_YELLOW "\033[1;33m"
+#define COLOR_CYAN   "\033[0;36m"
+
+#define ENTRY_COUNT 5000
+
+static uint8_t key[32];
+static sqlite3 *db = NULL;
+
+static bool add_blob(const char *text, uint8_t **out_blob, uint32_t *out_len) {
+    size_t len = strlen(text);
+
+    *out_blob = malloc(len + BLOB_OVERHEAD);
+    *out_len = (uint32_t)(len + BLOB_OVERHEAD);
+    return *out_blob && encrypt_blob(key, (const uint8_t *)text, len, *out_blob);
+}
+
+/* entry i: service-i, user-i, password-i and notes on even rows only */
+static bool fill_vault() {
+    char text[4][64];
+    bool ok = sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) == SQLITE_OK;
+
+    for (int i = 0; ok && i < ENTRY_COUNT; i++) {
+        IntVaultEntry entry = {0};
+        char uuid[37];
+
+        snprintf(uuid, sizeof(uuid), "00000000-0000-4000-8000-%012d", i);
+        snprintf(text[0], sizeof(text[0]), "service-%d", i);
+        snprintf(text[1], sizeof(text[1]), "user-%d", i);
+        snprintf(text[2], sizeof(text[2]), "password-%d", i);
+        snprintf(text[3], sizeof(text[3]), "notes-%d", i);
+
+        entry.uuid = uuid;
+        entry.created_at = (uint64_t)i;
+        entry.updated_at = (uint64_t)i;
+        ok = add_blob(text[0], &entry.service_name, &entry.service_len) &&
+             add_blob(text[1], &entry.username, &entry.username_len) &&
+             add_blob(text[2], &entry.password, &entry.password_len) &&
+             (i % 2 || add_blob(text[3], &entry.notes, &entry.notes_len)) &&
+             add_entry(&entry, db) == OK;
+
+        free(entry.service_name);
+        free(entry.username);
+        free(entry.password);
+        free(entry.notes);
+    }
+
+    return sqlite3_exec(db, ok ? "COMMIT;" : "ROLLBACK;", NULL, NULL, NULL) == SQLITE_OK && ok;
+}
+
+static bool matches_rows(const DLinkedList *rows, const ExtVaultEntry *entries) {
+    char expected[64];
+    size_t i = 0;
+
+    for (DLinkedListNode *node = rows->head; node; node = node->next, i++) {
+        const IntVaultEntry *row = node->data;
+        const ExtVaultEntry *entry = &entries[i];
+        int n = (int)row->created_at;
+
+        if (strcmp(entry->uuid, row->uuid) != 0 || entry->created_at != row->created_at) {
+            return false;
+        }
+
+        snprintf(expected, sizeof(expected), "password-%d", n);
+        if (strcmp(entry->password, expected) != 0) {
+            return false;
+        }
+
+        snprintf(expected, sizeof(expected), "notes-%d", n);
+        if ((n % 2) ? entry->notes != NULL : strcmp(entry->notes, expected) != 0) {
+            return false;
+        }
+    }
+    return i == rows->size;
+}
+
+static bool test_decrypt(const DLinkedList *rows, uint32_t workers) {
+    ExtVaultEntry *entries = NULL;
+    DecodeStats stats;
+
+    if (!decrypt_entries(rows, key, workers, NULL, &entries, &stats)) {
+        printf(COLOR_RED ">> decrypt_entries failed, es_status %d\n" COLOR_RESET, es_status);
+        return false;
+    }
+
+    printf(COLOR_CYAN ">> %lu entries, %u workers, %.2f ms, %.2f MiB/s\n" COLOR_RESET,
+           (unsigned long)stats.entries, stats.workers, stats.elapsed_ms, stats.mib_per_s);
+
+    bool ok = stats.entries == rows->size && stats.workers >= 1 && matches_rows(rows, entries);
+    free_ext_entries(entries, rows->size);
+    return ok;
+}
+
+static bool test_tampered(DLinkedList *rows) {
+    ExtVaultEntry *entries = (ExtVaultEntry *)1;
+    IntVaultEntry *last = rows->tail->data;
+
+    last->password[last->password_len - 1] ^= 0x01;
+    bool rejected = !decrypt_entries(rows, key, 4, NULL, &entries, NULL) && entries == NULL &&
+                    es_status == ES_DECRYPT_ERR;
+    last->password[last->password_len - 1] ^= 0x01;
+
+    return rejected;
+}
+
+static bool test_empty() {
+    DLinkedList *empty = dlinked_list_create();
+    ExtVaultEntry *entries = (ExtVaultEntry *)1;
+    DecodeStats stats;
+
+    bool ok = empty && decrypt_entries(empty, key, 0, NULL, &entries, &stats) && entries == NULL &&
+              stats.entries == 0;
+    dlinked_list_destroy(empty, NULL);
+    return ok;
+}
+
+static bool test_record_round_trip() {
+    AeadContext *aead = aead_context_new(key);
+    ExtVaultEntry entry = {.uuid = "00000000-0000-4000-8000-100000000000",
+                           .service_name = "mail",
+                           .username = "",
+                           .password = "s3cret",
+                           .notes = NULL,
+                           .created_at = 7,
+                           .updated_at = 8};
+    IntVaultEntry packed = {0};
+    IntVaultEntry row = {0};
+    ExtVaultEntry out = {0};
+
+    bool ok = aead && encrypt_entry(aead, &entry, &packed) && add_entry(&packed, db) == OK &&
+              read_entry(entry.uuid, &row, db) == OK && row.record && !row.service_name &&
+              row.record_len == ENTRY_RECORD_OVERHEAD + 4 + 6 &&
+              decrypt_entry(aead, &row, &out) && strcmp(out.service_name, "mail") == 0 &&
+              strcmp(out.username, "") == 0 && strcmp(out.password, "s3cret") == 0 &&
+              out.notes == NULL && out.created_at == 7 && out.updated_at == 8;
+
+    free_ext_entry(&out);
+    free_int_entry(&packed);
+    free_int_entry(&row);
+    aead_context_free(aead);
+    return ok;
+}
+
+/* the uuid is associated data, a record moved to another row does not open */
+static bool test_record_bound_to_uuid() {
+    AeadContext *aead = aead_context_new(key);
+    ExtVaultEntry entry = {.uuid = "00000000-0000-4000-8000-200000000000",
+                           .service_name = "bank",
+                           .username = "me",
+                           .password = "pin",
+                           .notes = "notes"};
+    IntVaultEntry packed = {0};
+    ExtVaultEntry out = {0};
+
+    bool ok = aead && encrypt_entry(aead, &entry, &packed);
+    if (ok) {
+        char *own_uuid = packed.uuid;
+
+        packed.uuid = "00000000-0000-4000-8000-200000000001";
+        ok = !decrypt_entry(aead, &packed, &out) && out.uuid == NULL;
+
+        packed.uuid = own_uuid;
+        packed.record[0] = ENTRY_RECORD_VERSION_01;
+        ok = ok && !decrypt_entry(aead, &packed, &out);
+        packed.record[0] = ENTRY_RECORD_VERSION_02;
+        ok = ok && decrypt_entry(aead, &packed, &out) && strcmp(out.notes, "notes") == 0;
+    }
+
+    free_ext_entry(&out);
+    free_int_entry(&packed);
+    aead_context_free(aead);
+    return ok;
+}
+
+/* fill_vault() wrote per-field rows, reading one turns it into a record */
+static bool test_lazy_migration() {
+    const char *uuid = "00000000-0000-4000-8000-000000000002";
+    AeadContext *aead = aead_context_new(key);
+    ExtVaultEntry entry = {0};
+    IntVaultEntry row = {0};
+
+    bool ok = aead && load_entry(db, aead, uuid, &entry) && strcmp(entry.password, "password-2") == 0 &&
+              strcmp(entry.notes, "notes-2") == 0 && read_entry(uuid, &row, db) == OK &&
+              row.record && !row.service_name && !row.password && row.updated_at == 2;
+    free_ext_entry(&entry);
+    free_int_entry(&row);
+
+    /* the rewritten row reads back the same */
+    ok = ok && load_entry(db, aead, uuid, &entry) && strcmp(entry.username, "user-2") == 0;
+    free_ext_entry(&entry);
+
+    ok = ok && !load_entry(db, aead, "00000000-0000-4000-8000-999999999999", &entry) &&
+         es_status == ES_NOT_FOUND;
+    aead_context_free(aead);
+    return ok;
+}
+
+/* a ChaCha20-Poly1305 record opens with any context of the key */
+static bool test_record_cipher() {
+    AeadContext *chacha = aead_context_new_cipher(key, CIPHER_CHACHA20_POLY1305);
+    AeadContext *aead = aead_context_new(key);
+    ExtVaultEntry entry = {.uuid = "00000000-0000-4000-8000-300000000000",
+                           .service_name = "forum",
+                           .username = "anon",
+                           .password = "letmein",
+                           .notes = "n"};
+    IntVaultEntry packed = {0};
+    ExtVaultEntry out = {0};
+
+    bool ok = chacha && aead && encrypt_entry(chacha, &entry, &packed) &&
+              packed.record[0] == ENTRY_RECORD_VERSION_02 &&
+              packed.record[1] == CIPHER_CHACHA20_POLY1305 &&
+              decrypt_entry(aead, &packed, &out) && strcmp(out.password, "letmein") == 0;
+
+    free_ext_entry(&out);
+    free_int_entry(&packed);
+    aead_context_free(chacha);
+    aead_context_free(aead);
+    return ok;
+}
+
+static bool test_mixed_formats() {
+    DLinkedList *mixed = dlinked_list_create();
+    ExtVaultEntry *entries = NULL;
+    size_t records = 0;
+
+    bool ok = mixed && read_all_entries(mixed, db) == OK &&
+              decrypt_entries(mixed, key, 4, NULL, &entries, NULL);
+    if (ok) {
+        for (size_t i = 0; i < mixed->size; i++) {
+            const char *uuid = entries[i].uuid;
+            ok = ok && entries[i].password && strncmp(uuid, "00000000-", 9) == 0;
+        }
+        for (DLinkedListNode *node = mixed->head; node; node = node->next) {
+            records += ((IntVaultEntry *)node->data)->record != NULL;
+        }
+        free_ext_entries(entries, mixed->size);
+    }
+
+    ok = ok && mixed->size == ENTRY_COUNT + 1 && records == 2;
+    if (mixed) {
+        dlinked_list_destroy(mixed, free_int_entry_node);
+    }
+    return ok;
+}
+
+static bool same_text(const char *a, const char *b) {
+    return (!a && !b) || (a && b && strcmp(a, b) == 0);
+}
+
+/* records and per-field rows opened into an arena read the same as on the heap */
+static bool test_arena_decode() {
+    DLinkedList *mixed = dlinked_list_create();
+    SecretArena *arena = secret_arena_create(0);
+    ExtVaultEntry *heap = NULL;
+    ExtVaultEntry *locked = NULL;
+    SecretArenaStats stats;
+
+    bool ok = mixed && arena && read_all_entries(mixed, db) == OK &&
+              decrypt_entries(mixed, key, 4, NULL, &heap, NULL) &&
+              decrypt_entries(mixed, key, 4, arena, &locked, NULL);
+    for (size_t i = 0; ok && i < mixed->size; i++) {
+        ok = same_text(heap[i].uuid, locked[i].uuid) &&
+             same_text(heap[i].service_name, locked[i].service_name) &&
+             same_text(heap[i].username, locked[i].username) &&
+             same_text(heap[i].password, locked[i].password) &&
+             same_text(heap[i].notes, locked[i].notes) &&
+             heap[i].updated_at == locked[i].updated_at;
+    }
+    if (heap) {
+        free_ext_entries(heap, mixed->size);
+    }
+
+    /* a failed decode hands back everything it took from the arena */
+    secret_arena_stats(arena, &stats);
+    uint64_t used = stats.used;
+    IntVaultEntry *record = NULL;
+    for (DLinkedListNode *node = ok ? mixed->head : NULL; node && !record; node = node->next) {
+        record = ((IntVaultEntry *)node->data)->record ? node->data : NULL;
+    }
+    ok = ok && record;
+    if (ok) {
+        record->record[record->record_len - 1] ^= 0x01;
+        ok = !decrypt_entries(mixed, key, 4, arena, &locked, NULL) && locked == NULL;
+        secret_arena_stats(arena, &stats);
+        ok = ok && stats.used == used && stats.regions > 1;
+    }
+
+    secret_arena_reset(arena);
+    secret_arena_stats(arena, &stats);
+    ok = ok && stats.used == 0 && stats.regions == 1 && stats.allocations == 0;
+
+    secret_arena_destroy(arena);
+    if (mixed) {
+        dlinked_list_destroy(mixed, free_int_entry_node);
+    }
+    return ok;
+}
+
+static void report(const char *name, bool ok, bool *passed) {
+    if (ok) {
+        printf(COLOR_GREEN "[PASS] " COLOR_RESET "%s\n", name);
+    } else {
+        printf(COLOR_RED "[FAIL] " COLOR_RESET "%s\n", name);
+        *passed = false;
+    }
+}
+
+int main() {
+    printf(COLOR_BLUE "\nENTRY SERVICE TEST\n" COLOR_RESET);
+
+    printf(COLOR_YELLOW "\n--> setup phase\n" COLOR_RESET);
+    DLinkedList *rows = NULL;
+    if (random_raw_bytes(sizeof(key), key) != SUCCESS ||
+        sqlite3_open(":memory:", &db) != SQLITE_OK || repo_vault_init(db) != OK ||
+        !fill_vault() || !(rows = dlinked_list_create()) ||
+        read_all_entries(rows, db) != OK || rows->size != ENTRY_COUNT) {
+        printf(COLOR_RED ">> Failed to fill the vault\n" COLOR_RESET);
+        repo_close(db);
+        return 1;
+    }
+
+    bool passed = true;
+
+    printf(COLOR_YELLOW "\n--> parallel decode\n" COLOR_RESET);
+    report("single worker keeps row order", test_decrypt(rows, 1), &passed);
+    report("four workers keep row order", test_decrypt(rows, 4), &passed);
+    report("one worker per CPU keeps row order", test_decrypt(rows, 0), &passed);
+    report("tampered entry fails the whole read", test_tampered(rows), &passed);
+    report("empty list decodes to nothing", test_empty(), &passed);
+
+    printf(COLOR_YELLOW "\n--> packed records\n" COLOR_RESET);
+    report("record round trip", test_record_round_trip(), &passed);
+    report("record bound to its uuid and version", test_record_bound_to_uuid(), &passed);
+    report("per-field row rewritten on load", test_lazy_migration(), &passed);
+    report("record names its cipher", test_record_cipher(), &passed);
+    report("records and per-field rows decode together", test_mixed_formats(), &passed);
+    report("arena decode matches the heap and rewinds on failure", test_arena_decode(),
+           &passed);
+
+    dlinked_list_destroy(rows, free_int_entry_node);
+    repo_close(db);
+
+    if (!passed) {
+        printf(COLOR_RED "\nENTRY SERVICE TEST FAILED\n\n" COLOR_RESET);
+        return 1;
+    }
+
+    printf(COLOR_BLUE "\nENTRY SERVICE TEST COMPLETED\n\n" COLOR_RESET);
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include <CVault/crypto/crypto_core.h>
+#include <CVault/service/db_config_service.h>
+#include <CVault/service/db_init_service.h>
+#include <CVault/service/environment_service.h>
+#include <CVault/service/kdf_service.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define COLOR_RESET  "\033[0m"
+#define COLOR_GREEN  "\033[0;32m"
+#define COLOR_RED    "\033[0;31m"
+#define COLOR_BLUE   "\033[34m"
+#define COLOR_YELLOW "\033[1;33m"
+#define COLOR_CYAN   "\033[0;36m"
+
+#define TARGET_MS  250
+#define BUDGET_KIB (128 * 1024)
+
+static KdfParams calibrated;
+
+static bool test_calibrate() {
+    if (!calibrate_kdf_service(TARGET_MS, BUDGET_KIB, &calibrated)) {
+        printf(COLOR_RED ">> calibration failed, kdf_status %d\n" COLOR_RESET, kdf_status);
+        return false;
+    }
+
+    printf(COLOR_CYAN ">> t=%u m=%u KiB p=%u\n" COLOR_RESET, calibrated.t_cost,
+           calibrated.m_cost, calibrated.p_cost);
+
+    return is_valid_kdf_params(&calibrated) && calibrated.m_cost <= BUDGET_KIB;
+}
+
+static bool test_load_recorded() {
+    KdfParams defaults = {ARGON_T_COST, ARGON_M_COST, ARGON_P_COST};
+    KdfParams loaded;
+
+    set_kdf_params(&defaults);
+    if (!load_kdf_service()) {
+        return false;
+    }
+
+    get_kdf_params(&loaded);
+    return memcmp(&loaded, &calibrated, sizeof(KdfParams)) == 0;
+}
+
+static bool test_reject_corrupted() {
+    uint8_t record[KDF_PARAMS_RECORD_SIZE_V01] = {KDF_PARAMS_RECORD_VERSION_01, 0};
+
+    /* t_cost 0 is out of bounds */
+    if (!service_update_config(KDF_PARAMS_CONFIG_KEY, record, sizeof(record))) {
+        return false;
+    }
+
+    KdfParams before, after;
+    get_kdf_params(&before);
+
+    if (load_kdf_service() || kdf_status != KDF_CORRUPTED_ERR) {
+        return false;
+    }
+
+    get_kdf_params(&after);
+    return memcmp(&before, &after, sizeof(KdfParams)) == 0;
+}
+
+/* the service refuses empty values, a bare UPDATE can still leave one */
+static bool test_empty_record() {
+    KdfParams before, after;
+    sqlite3 *db = NULL;
+
+    if (sqlite3_open(db_config_path, &db) != SQLITE_OK) {
+        return false;
+    }
+    bool ok = sqlite3_exec(db,
+                           "UPDATE configs SET config_value = X'' "
+                           "WHERE config_key = '" KDF_PARAMS_CONFIG_KEY "';",
+                           NULL, NULL, NULL) == SQLITE_OK &&
+              sqlite3_changes(db) == 1;
+    repo_close(db);
+
+    get_kdf_params(&before);
+    ok = ok && load_kdf_service();
+    get_kdf_params(&after);
+    return ok && memcmp(&before, &after, sizeof(KdfParams)) == 0;
+}
+
+static bool test_defaults_without_record() {
+    KdfParams defaults = {ARGON_T_COST, ARGON_M_COST, ARGON_P_COST};
+    KdfParams loaded;
+
+    if (!service_delete_config(KDF_PARAMS_CONFIG_KEY)) {
+        return false;
+    }
+
+    set_kdf_params(&defaults);
+    if (!load_kdf_service()) {
+        return false;
+    }
+
+    get_kdf_params(&loaded);
+    return memcmp(&loaded, &defaults, sizeof(KdfParams)) == 0;
+}
+
+static void report(const char *name, bool ok, bool *passed) {
+    if (ok) {
+        printf(COLOR_GREEN "[PASS] " COLOR_RESET "%s\n", name);
+    } else {
+        printf(COLOR_RED "[FAIL] " COLOR_RESET "%s\n", name);
+        *passed = false;
+    }
+}
+
+int main() {
+    printf(COLOR_BLUE "\nKDF SERVICE TEST\n" COLOR_RESET);
+
+    printf(COLOR_YELLOW "\n--> setup phase\n" COLOR_RESET);
+    if (!initialize_environment() || !init_schema() || !open_config_service()) {
+        printf(COLOR_RED ">> Failed to open the config service\n" COLOR_RESET);
+        return 1;
+    }
+
+    bool passed = true;
+
+    printf(COLOR_YELLOW "\n--> calibration\n" COLOR_RESET);
+    report("calibrated parameters fit the budget", test_calibrate(), &passed);
+    report("recorded parameters are applied on load", test_load_recorded(), &passed);
+    report("corrupted record is rejected", test_reject_corrupted(), &passed);
+    report("empty record keeps the current parameters", test_empty_record(), &passed);
+    report("defaults kept without a record", test_defaults_without_record(), &passed);
+
+    close_config_service();
+
+    if (!passed) {
+        printf(COLOR_RED "\nKDF SERVICE TEST FAILED\n\n" COLOR_RESET);
+        return 1;
+    }
+
+    printf(COLOR_BLUE "\nKDF SERVICE TEST COMPLETED\n\n" COLOR_RESET);
+    return 0;
+}
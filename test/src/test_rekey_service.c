@@ -0,0 +1,228 @@
+#include <CVault/crypto/crypto_core.h>
+#include <CVault/repository/repository.h>
+#include <CVault/service/entry_service.h>
+#include <CVault/service/rekey_service.h>
+#include <CVault/utils/security_utils.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COLOR_RESET  "\033[0m"
+#define COLOR_GREEN  "\033[0;32m"
+#define COLOR_RED    "\033[0;31m"
+#define COLOR_BLUE   "\033[34m"
+#define COLOR_YELLOW "\033[1;33m"
+#define COLOR_CYAN   "\033[0;36m"
+
+#define ENTRY_COUNT 2000
+#define BATCH       100
+
+static uint8_t old_key[32];
+static uint8_t new_key[32];
+static sqlite3 *db = NULL;
+
+static bool add_blob(const char *text, uint8_t **out_blob, uint32_t *out_len) {
+    size_t len = strlen(text);
+
+    *out_blob = malloc(len + BLOB_OVERHEAD);
+    *out_len = (uint32_t)(len + BLOB_OVERHEAD);
+    return *out_blob && encrypt_blob(old_key, (const uint8_t *)text, len, *out_blob);
+}
+
+/* entry i under old_key: per-field blobs on even rows, a packed record on odd ones */
+static bool fill_vault() {
+    AeadContext *aead = aead_context_new(old_key);
+    char text[3][64];
+    bool ok = aead && sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) == SQLITE_OK;
+
+    for (int i = 0; ok && i < ENTRY_COUNT; i++) {
+        IntVaultEntry entry = {0};
+        char uuid[37];
+
+        /* the nil uuid sorts first, the first page must not skip it */
+        if (i == 0) {
+            strcpy(uuid, "00000000-0000-0000-0000-000000000000");
+        } else {
+            snprintf(uuid, sizeof(uuid), "00000000-0000-4000-8000-%012d", i);
+        }
+        snprintf(text[0], sizeof(text[0]), "service-%d", i);
+        snprintf(text[1], sizeof(text[1]), "user-%d", i);
+        snprintf(text[2], sizeof(text[2]), "password-%d", i);
+
+        if (i % 2) {
+            ExtVaultEntry plain = {.uuid = uuid,
+                                   .service_name = text[0],
+                                   .username = text[1],
+                                   .password = text[2],
+                                   .created_at = (uint64_t)i,
+                                   .updated_at = (uint64_t)i};
+            ok = encrypt_entry(aead, &plain, &entry) && add_entry(&entry, db) == OK;
+            free_int_entry(&entry);
+            continue;
+        }
+
+        entry.uuid = uuid;
+        entry.created_at = (uint64_t)i;
+        entry.updated_at = (uint64_t)i;
+        ok = add_blob(text[0], &entry.service_name, &entry.service_len) &&
+             add_blob(text[1], &entry.username, &entry.username_len) &&
+             add_blob(text[2], &entry.password, &entry.password_len) &&
+             add_entry(&entry, db) == OK;
+
+        free(entry.service_name);
+        free(entry.username);
+        free(entry.password);
+    }
+
+    aead_context_free(aead);
+    return sqlite3_exec(db, ok ? "COMMIT;" : "ROLLBACK;", NULL, NULL, NULL) == SQLITE_OK && ok;
+}
+
+/* every entry decrypts under key and still holds its own fields */
+static bool all_under(const uint8_t *key) {
+    DLinkedList *rows = dlinked_list_create();
+    ExtVaultEntry *entries = NULL;
+    char expected[64];
+    bool ok = rows && read_all_entries(rows, db) == OK && rows->size == ENTRY_COUNT &&
+              decrypt_entries(rows, key, 0, NULL, &entries, NULL);
+
+    for (size_t i = 0; ok && i < ENTRY_COUNT; i++) {
+        int n = (int)entries[i].created_at;
+
+        snprintf(expected, sizeof(expected), "password-%d", n);
+        ok = strcmp(entries[i].password, expected) == 0;
+    }
+
+    if (entries) {
+        free_ext_entries(entries, ENTRY_COUNT);
+    }
+    if (rows) {
+        dlinked_list_destroy(rows, free_int_entry_node);
+    }
+    return ok;
+}
+
+static bool test_rekey(const uint8_t *from, const uint8_t *to, uint8_t cipher, uint32_t workers,
+                       uint32_t batch_size) {
+    RekeyOptions options = {.batch_size = batch_size, .workers = workers};
+    RekeyStats stats;
+
+    if (!rekey_entries(db, from, to, cipher, &options, &stats)) {
+        printf(COLOR_RED ">> rekey_entries failed, rk_status %d\n" COLOR_RESET, rk_status);
+        return false;
+    }
+
+    printf(COLOR_CYAN ">> %lu entries, %lu batches, %u workers, %.2f ms, %.0f entries/s\n"
+           COLOR_RESET,
+           (unsigned long)stats.entries, (unsigned long)stats.batches, stats.workers,
+           stats.elapsed_ms, stats.entries_per_s);
+
+    uint32_t batch = batch_size ? batch_size : REKEY_DEFAULT_BATCH;
+    return stats.entries == ENTRY_COUNT && stats.skipped == 0 &&
+           stats.batches == (ENTRY_COUNT + batch - 1) / batch && all_under(to) &&
+           !all_under(from);
+}
+
+typedef struct {
+    int pages_left;
+    char uuids[ENTRY_COUNT / BATCH][UUID_STR_LEN + 1];
+    int written;
+} Checkpoints;
+
+/* keeps every checkpoint, stops the run once pages_left is spent */
+static bool record_checkpoint(const char *last_uuid, void *arg) {
+    Checkpoints *checkpoints = arg;
+
+    strcpy(checkpoints->uuids[checkpoints->written++], last_uuid);
+    return --checkpoints->pages_left > 0;
+}
+
+static bool test_resume() {
+    Checkpoints checkpoints = {.pages_left = 3};
+    RekeyOptions options = {.batch_size = BATCH,
+                            .workers = 4,
+                            .checkpoint = record_checkpoint,
+                            .checkpoint_arg = &checkpoints};
+    RekeyStats stats;
+
+    bool stopped = !rekey_entries(db, old_key, new_key, CIPHER_AES_256_GCM, &options, &stats) &&
+                   rk_status == RK_CHECKPOINT_ERR && stats.entries == 3 * BATCH &&
+                   checkpoints.written == 3;
+    if (!stopped) {
+        return false;
+    }
+
+    /* the first checkpoint lags behind the two pages committed after it */
+    RekeyOptions resumed = {.batch_size = BATCH, .workers = 2,
+                            .resume_after = checkpoints.uuids[0]};
+
+    return rekey_entries(db, old_key, new_key, CIPHER_AES_256_GCM, &resumed, &stats) &&
+           stats.skipped == 2 * BATCH && stats.entries == ENTRY_COUNT - 3 * BATCH &&
+           all_under(new_key);
+}
+
+static bool test_wrong_key() {
+    uint8_t other[32];
+    RekeyStats stats;
+
+    return random_raw_bytes(sizeof(other), other) == SUCCESS &&
+           !rekey_entries(db, other, old_key, CIPHER_AES_256_GCM, NULL, &stats) &&
+           rk_status == RK_DECRYPT_ERR && stats.entries == 0 && all_under(new_key);
+}
+
+static bool test_bad_resume() {
+    RekeyOptions options = {.resume_after = "not-a-uuid"};
+
+    return !rekey_entries(db, new_key, old_key, CIPHER_AES_256_GCM, &options, NULL) &&
+           rk_status == RK_DB_ERR && all_under(new_key);
+}
+
+static void report(const char *name, bool ok, bool *passed) {
+    if (ok) {
+        printf(COLOR_GREEN "[PASS] " COLOR_RESET "%s\n", name);
+    } else {
+        printf(COLOR_RED "[FAIL] " COLOR_RESET "%s\n", name);
+        *passed = false;
+    }
+}
+
+int main() {
+    printf(COLOR_BLUE "\nREKEY SERVICE TEST\n" COLOR_RESET);
+
+    printf(COLOR_YELLOW "\n--> setup phase\n" COLOR_RESET);
+    if (random_raw_bytes(sizeof(old_key), old_key) != SUCCESS ||
+        random_raw_bytes(sizeof(new_key), new_key) != SUCCESS ||
+        sqlite3_open(":memory:", &db) != SQLITE_OK || repo_vault_init(db) != OK ||
+        !fill_vault()) {
+        printf(COLOR_RED ">> Failed to fill the vault\n" COLOR_RESET);
+        repo_close(db);
+        return 1;
+    }
+
+    bool passed = true;
+
+    printf(COLOR_YELLOW "\n--> full rekey\n" COLOR_RESET);
+    report("mixed vault moved to the new key, four workers",
+           test_rekey(old_key, new_key, CIPHER_CHACHA20_POLY1305, 4, BATCH), &passed);
+    report("moved back with default workers and batch",
+           test_rekey(new_key, old_key, CIPHER_AES_256_GCM, 0, 0), &passed);
+    report("single worker, uneven last page",
+           test_rekey(old_key, new_key, CIPHER_AES_256_GCM, 1, 300), &passed);
+    report("moved back again", test_rekey(new_key, old_key, CIPHER_AES_256_GCM, 3, 7), &passed);
+
+    printf(COLOR_YELLOW "\n--> interruption\n" COLOR_RESET);
+    report("stopped run resumes from a lagging checkpoint", test_resume(), &passed);
+    report("wrong old key stops before writing", test_wrong_key(), &passed);
+    report("malformed checkpoint is rejected", test_bad_resume(), &passed);
+
+    repo_close(db);
+
+    if (!passed) {
+        printf(COLOR_RED "\nREKEY SERVICE TEST FAILED\n\n" COLOR_RESET);
+        return 1;
+    }
+
+    printf(COLOR_BLUE "\nREKEY SERVICE TEST COMPLETED\n\n" COLOR_RESET);
+    return 0;
+}
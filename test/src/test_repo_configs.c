@@ -49,7 +49,7 @@ int main() {
     printf("%s[TEST 2/7]%s Initializing repository...\n", COLOR_BLUE, COLOR_RESET);
     if (!test_repo_init()) {
         printf("%s[FAILED]%s Repository initialization failed\n\n", COLOR_RED, COLOR_RESET);
-        sqlite3_close(db);
+        repo_close(db);
         return 1;
     }
     printf("%s[PASSED]%s Repository initialized successfully\n\n", COLOR_GREEN, COLOR_RESET);
@@ -57,7 +57,7 @@ int main() {
     printf("%s[TEST 3/7]%s Adding configs...\n", COLOR_BLUE, COLOR_RESET);
     if (!test_add_config()) {
         printf("%s[FAILED]%s Failed to add configs\n\n", COLOR_RED, COLOR_RESET);
-        sqlite3_close(db);
+        repo_close(db);
         return 1;
     }
     printf("%s[PASSED]%s Configs added successfully\n\n", COLOR_GREEN, COLOR_RESET);
@@ -65,7 +65,7 @@ int main() {
     printf("%s[TEST 4/7]%s Reading config...\n", COLOR_BLUE, COLOR_RESET);
     if (!test_read_config()) {
         printf("%s[FAILED]%s Failed to read config\n\n", COLOR_RED, COLOR_RESET);
-        sqlite3_close(db);
+        repo_close(db);
         return 1;
     }
     printf("%s[PASSED]%s Config read successfully\n\n", COLOR_GREEN, COLOR_RESET);
@@ -73,7 +73,7 @@ int main() {
     printf("%s[TEST 5/7]%s Updating config...\n", COLOR_BLUE, COLOR_RESET);
     if (!test_update_config()) {
         printf("%s[FAILED]%s Failed to update config\n\n", COLOR_RED, COLOR_RESET);
-        sqlite3_close(db);
+        repo_close(db);
         return 1;
     }
     printf("%s[PASSED]%s Config updated successfully\n\n", COLOR_GREEN, COLOR_RESET);
@@ -81,7 +81,7 @@ int main() {
     printf("%s[TEST 6/7]%s Deleting config...\n", COLOR_BLUE, COLOR_RESET);
     if (!test_delete_config()) {
         printf("%s[FAILED]%s Failed to delete config\n\n", COLOR_RED, COLOR_RESET);
-        sqlite3_close(db);
+        repo_close(db);
         return 1;
     }
     printf("%s[PASSED]%s Config deleted successfully\n\n", COLOR_GREEN, COLOR_RESET);
@@ -89,7 +89,7 @@ int main() {
     printf("%s[TEST 7/7]%s Deleting all configs...\n", COLOR_BLUE, COLOR_RESET);
     if (!test_delete_all_configs()) {
         printf("%s[FAILED]%s Failed to delete all configs\n\n", COLOR_RED, COLOR_RESET);
-        sqlite3_close(db);
+        repo_close(db);
         return 1;
     }
     printf("%s[PASSED]%s All configs deleted successfully\n\n", COLOR_GREEN, COLOR_RESET);
@@ -387,7 +387,7 @@ bool close_test() {
     }
 
     if (db) {
-        if (sqlite3_close(db) != SQLITE_OK) {
+        if (repo_close(db) != SQLITE_OK) {
             return false;
         }
     }
@@ -36,75 +36,121 @@ bool test_read_all_entries();
 bool test_update_entry();
 bool test_delete_entry();
 bool test_delete_all_entries();
+bool test_migrate_text_uuids();
+bool test_statement_cache();
+bool test_batch_entries();
+bool test_entry_cursor();
+bool test_entry_pages();
 
 bool close_test();
 
 int main() {
     printf("\n%sTEST ENTRIES REPOSITORY OPERATIONS%s\n\n", COLOR_BLUE, COLOR_RESET);
 
-    printf("%s[TEST 1/8]%s Initializing database...\n", COLOR_BLUE, COLOR_RESET);
+    printf("%s[TEST 1/13]%s Initializing database...\n", COLOR_BLUE, COLOR_RESET);
     if (!init_test()) {
         printf("%s[FAILED]%s Database initialization failed\n\n", COLOR_RED, COLOR_RESET);
         return 1;
     }
     printf("%s[PASSED]%s Database initialized successfully\n\n", COLOR_GREEN, COLOR_RESET);
 
-    printf("%s[TEST 2/8]%s Initializing repository...\n", COLOR_BLUE, COLOR_RESET);
+    printf("%s[TEST 2/13]%s Initializing repository...\n", COLOR_BLUE, COLOR_RESET);
     if (!test_repo_init()) {
         printf("%s[FAILED]%s Repository initialization failed\n\n", COLOR_RED, COLOR_RESET);
-        sqlite3_close(db);
+        repo_close(db);
         return 1;
     }
     printf("%s[PASSED]%s Repository initialized successfully\n\n", COLOR_GREEN, COLOR_RESET);
 
-    printf("%s[TEST 3/8]%s Adding entries...\n", COLOR_BLUE, COLOR_RESET);
+    printf("%s[TEST 3/13]%s Adding entries...\n", COLOR_BLUE, COLOR_RESET);
     if (!test_add_entry()) {
         printf("%s[FAILED]%s Failed to add entries\n\n", COLOR_RED, COLOR_RESET);
-        sqlite3_close(db);
+        repo_close(db);
         return 1;
     }
     printf("%s[PASSED]%s Entries added successfully\n\n", COLOR_GREEN, COLOR_RESET);
 
-    printf("%s[TEST 4/8]%s Reading single entry...\n", COLOR_BLUE, COLOR_RESET);
+    printf("%s[TEST 4/13]%s Reading single entry...\n", COLOR_BLUE, COLOR_RESET);
     if (!test_read_entry()) {
         printf("%s[FAILED]%s Failed to read entry\n\n", COLOR_RED, COLOR_RESET);
-        sqlite3_close(db);
+        repo_close(db);
         return 1;
     }
     printf("%s[PASSED]%s Entry read successfully\n\n", COLOR_GREEN, COLOR_RESET);
 
-    printf("%s[TEST 5/8]%s Reading all entries...\n", COLOR_BLUE, COLOR_RESET);
+    printf("%s[TEST 5/13]%s Reading all entries...\n", COLOR_BLUE, COLOR_RESET);
     if (!test_read_all_entries()) {
         printf("%s[FAILED]%s Failed to read all entries\n\n", COLOR_RED, COLOR_RESET);
-        sqlite3_close(db);
+        repo_close(db);
         return 1;
     }
     printf("%s[PASSED]%s All entries read successfully\n\n", COLOR_GREEN, COLOR_RESET);
 
-    printf("%s[TEST 6/8]%s Updating entry...\n", COLOR_BLUE, COLOR_RESET);
+    printf("%s[TEST 6/13]%s Updating entry...\n", COLOR_BLUE, COLOR_RESET);
     if (!test_update_entry()) {
         printf("%s[FAILED]%s Failed to update entry\n\n", COLOR_RED, COLOR_RESET);
-        sqlite3_close(db);
+        repo_close(db);
         return 1;
     }
     printf("%s[PASSED]%s Entry updated successfully\n\n", COLOR_GREEN, COLOR_RESET);
 
-    printf("%s[TEST 7/8]%s Deleting entry...\n", COLOR_BLUE, COLOR_RESET);
+    printf("%s[TEST 7/13]%s Deleting entry...\n", COLOR_BLUE, COLOR_RESET);
     if (!test_delete_entry()) {
         printf("%s[FAILED]%s Failed to delete entry\n\n", COLOR_RED, COLOR_RESET);
-        sqlite3_close(db);
+        repo_close(db);
         return 1;
     }
     printf("%s[PASSED]%s Entry deleted successfully\n\n", COLOR_GREEN, COLOR_RESET);
 
-    printf("%s[TEST 8/8]%s Deleting all entries...\n", COLOR_BLUE, COLOR_RESET);
+    printf("%s[TEST 8/13]%s Deleting all entries...\n", COLOR_BLUE, COLOR_RESET);
     if (!test_delete_all_entries()) {
         printf("%s[FAILED]%s Failed to delete all entries\n\n", COLOR_RED, COLOR_RESET);
-        sqlite3_close(db);
+        repo_close(db);
         return 1;
     }
     printf("%s[PASSED]%s All entries deleted successfully\n\n", COLOR_GREEN, COLOR_RESET);
 
+    printf("%s[TEST 9/13]%s Migrating a text uuid table...\n", COLOR_BLUE, COLOR_RESET);
+    if (!test_migrate_text_uuids()) {
+        printf("%s[FAILED]%s Failed to migrate the text uuid table\n\n", COLOR_RED, COLOR_RESET);
+        repo_close(db);
+        return 1;
+    }
+    printf("%s[PASSED]%s Text uuid table migrated successfully\n\n", COLOR_GREEN, COLOR_RESET);
+
+    printf("%s[TEST 10/13]%s Reusing cached statements...\n", COLOR_BLUE, COLOR_RESET);
+    if (!test_statement_cache()) {
+        printf("%s[FAILED]%s Statements were not reused\n\n", COLOR_RED, COLOR_RESET);
+        repo_close(db);
+        return 1;
+    }
+    printf("%s[PASSED]%s Cached statements reused successfully\n\n", COLOR_GREEN, COLOR_RESET);
+
+    printf("%s[TEST 11/13]%s Adding and updating entries in batches...\n", COLOR_BLUE,
+           COLOR_RESET);
+    if (!test_batch_entries()) {
+        printf("%s[FAILED]%s Batch writes failed\n\n", COLOR_RED, COLOR_RESET);
+        repo_close(db);
+        return 1;
+    }
+    printf("%s[PASSED]%s Batch writes succeeded\n\n", COLOR_GREEN, COLOR_RESET);
+
+    printf("%s[TEST 12/13]%s Streaming entries through cursors...\n", COLOR_BLUE, COLOR_RESET);
+    if (!test_entry_cursor()) {
+        printf("%s[FAILED]%s Cursor iteration failed\n\n", COLOR_RED, COLOR_RESET);
+        repo_close(db);
+        return 1;
+    }
+    printf("%s[PASSED]%s Cursors streamed every entry\n\n", COLOR_GREEN, COLOR_RESET);
+
+    printf("%s[TEST 13/13]%s Paging through entries...\n", COLOR_BLUE, COLOR_RESET);
+    if (!test_entry_pages()) {
+        printf("%s[FAILED]%s Pagination failed\n\n", COLOR_RED, COLOR_RESET);
+        repo_close(db);
+        return 1;
+    }
+    printf("%s[PASSED]%s Every entry listed once, in order\n\n", COLOR_GREEN, COLOR_RESET);
+
     printf("%s[CLEANUP]%s Closing database...\n", COLOR_YELLOW, COLOR_RESET);
     if (!close_test()) {
         printf("%s[WARNING]%s Database close failed\n\n", COLOR_YELLOW, COLOR_RESET);
@@ -161,7 +207,7 @@ bool test_repo_init() {
 
 static IntVaultEntry *create_entry() {
 #define ENTRIES_LEN 10
-    IntVaultEntry *out_entry = malloc(sizeof(IntVaultEntry));
+    IntVaultEntry *out_entry = calloc(1, sizeof(IntVaultEntry));
 
     out_entry->uuid = malloc(sizeof(char) * (UUID_STR_LEN + 1));
     generate_uuid(out_entry->uuid);
@@ -374,7 +420,7 @@ bool test_read_all_entries() {
     return true;
 }
 bool test_update_entry() {
-    IntVaultEntry *updated_entry = malloc(sizeof(IntVaultEntry));
+    IntVaultEntry *updated_entry = calloc(1, sizeof(IntVaultEntry));
 
     updated_entry->uuid = malloc(sizeof(char) * (UUID_STR_LEN + 1));
     strcpy(updated_entry->uuid, entry1->uuid);
@@ -491,12 +537,302 @@ bool test_delete_all_entries() {
     }
 }
 
+bool test_migrate_text_uuids() {
+    const char *uuid = "3f2b8c1e-9a4d-4e6f-8b7a-0c1d2e3f4a5b";
+    sqlite3 *legacy = NULL;
+    sqlite3_stmt *stmt = NULL;
+    bool ok = false;
+
+    if (sqlite3_open(":memory:", &legacy) != SQLITE_OK) {
+        return false;
+    }
+
+    /* the version 1 schema */
+    if (sqlite3_exec(legacy,
+                     "CREATE TABLE entries (uuid CHAR(36) PRIMARY KEY NOT NULL,"
+                     "service_blob BLOB NOT NULL, username_blob BLOB NOT NULL,"
+                     "password_blob BLOB NOT NULL, notes_blob BLOB,"
+                     "created_at INTEGER NOT NULL, updated_at INTEGER NOT NULL);"
+                     "INSERT INTO entries VALUES ('3f2b8c1e-9a4d-4e6f-8b7a-0c1d2e3f4a5b',"
+                     "x'01', x'02', x'03', NULL, 7, 8);",
+                     NULL, NULL, NULL) != SQLITE_OK ||
+        repo_vault_init(legacy) != OK) {
+        repo_close(legacy);
+        return false;
+    }
+
+    IntVaultEntry migrated = {0};
+    if (read_entry(uuid, &migrated, legacy) == OK) {
+        ok = strcmp(migrated.uuid, uuid) == 0 && migrated.password_len == 1 &&
+             migrated.password[0] == 0x03 && migrated.notes == NULL &&
+             migrated.created_at == 7 && migrated.updated_at == 8;
+        printf("Migrated UUID: %s\n", migrated.uuid);
+    }
+    free_int_entry(&migrated);
+
+    if (ok && sqlite3_prepare_v2(legacy,
+                                 "SELECT typeof(uuid), length(uuid), "
+                                 "(SELECT user_version FROM pragma_user_version) FROM entries",
+                                 -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        ok = strcmp((const char *)sqlite3_column_text(stmt, 0), "blob") == 0 &&
+             sqlite3_column_int(stmt, 1) == UUID_BIN_LEN &&
+             sqlite3_column_int(stmt, 2) == VAULT_SCHEMA_VERSION;
+    } else {
+        ok = false;
+    }
+    sqlite3_finalize(stmt);
+    repo_close(legacy);
+    return ok;
+}
+
+bool test_statement_cache() {
+    RepoStatementStats before, after;
+    IntVaultEntry missing;
+
+    repo_statement_stats(db, &before);
+    for (int i = 0; i < 100; i++) {
+        if (read_entry("00000000-0000-4000-8000-000000000000", &missing, db) != NOT_FOUND_ERR) {
+            return false;
+        }
+    }
+    repo_statement_stats(db, &after);
+
+    printf("Hits: %" PRIu64 ", misses: %" PRIu64 ", cached: %u\n", after.hits, after.misses,
+           after.cached);
+    if (after.hits - before.hits < 99 || after.misses - before.misses > 1) {
+        return false;
+    }
+
+    /* a statement still checked out is not handed out twice */
+    sqlite3_stmt *first = repo_prepare(db, "SELECT 1");
+    sqlite3_stmt *second = repo_prepare(db, "SELECT 1");
+    bool distinct = first && second && first != second;
+    repo_release(db, second);
+    repo_release(db, first);
+
+    sqlite3_stmt *again = repo_prepare(db, "SELECT 1");
+    bool reused = again == first && sqlite3_step(again) == SQLITE_ROW;
+    repo_release(db, again);
+
+    return distinct && reused;
+}
+
+#define BATCH_ROWS 50
+
+bool test_batch_entries() {
+    IntVaultEntry rows[BATCH_ROWS];
+    repo_return_code results[BATCH_ROWS];
+    char uuids[BATCH_ROWS][UUID_STR_LEN + 1];
+    uint8_t blob[] = {0xAA, 0xBB, 0xCC};
+    uint8_t updated[] = {0x11};
+
+    for (int i = 0; i < BATCH_ROWS; i++) {
+        snprintf(uuids[i], sizeof(uuids[i]), "00000000-0000-4000-8000-%012d", i);
+        rows[i] = (IntVaultEntry){.uuid = uuids[i],
+                                  .service_name = blob,
+                                  .username = blob,
+                                  .password = blob,
+                                  .service_len = sizeof(blob),
+                                  .username_len = sizeof(blob),
+                                  .password_len = sizeof(blob),
+                                  .created_at = (uint64_t)i,
+                                  .updated_at = (uint64_t)i};
+    }
+    /* a duplicate and a malformed row fail alone */
+    rows[10].uuid = uuids[3];
+    rows[20].uuid = "not-a-uuid";
+
+    if (add_entries(rows, BATCH_ROWS, 7, results, db) != OK) {
+        return false;
+    }
+    for (int i = 0; i < BATCH_ROWS; i++) {
+        if ((results[i] == OK) != (i != 10 && i != 20)) {
+            printf("Unexpected result %d for row %d\n", results[i], i);
+            return false;
+        }
+    }
+
+    DLinkedList *list = dlinked_list_create();
+    bool ok = list && read_all_entries(list, db) == OK && list->size == BATCH_ROWS - 2;
+    dlinked_list_destroy(list, free_int_entry_node);
+    if (!ok) {
+        return false;
+    }
+
+    /* only the passwords change, rows 10 and 20 are not there to update */
+    for (int i = 0; i < BATCH_ROWS; i++) {
+        rows[i].service_name = NULL;
+        rows[i].username = NULL;
+        rows[i].password = updated;
+        rows[i].password_len = sizeof(updated);
+    }
+    rows[10].uuid = uuids[10];
+
+    if (update_entries(rows, BATCH_ROWS, 0, results, db) != OK || results[10] != NOT_FOUND_ERR ||
+        results[20] != NOT_FOUND_ERR || results[49] != OK) {
+        return false;
+    }
+
+    IntVaultEntry check = {0};
+    ok = read_entry(uuids[49], &check, db) == OK && check.password_len == 1 &&
+         check.password[0] == 0x11 && check.service_len == sizeof(blob);
+    free_int_entry(&check);
+
+    /* inside a caller's transaction the rows join it */
+    rows[0].uuid = "00000000-0000-4000-8000-999999999999";
+    rows[0].service_name = blob;
+    rows[0].username = blob;
+    ok = ok && sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) == SQLITE_OK &&
+         add_entries(rows, 1, 0, results, db) == OK && results[0] == OK &&
+         sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL) == SQLITE_OK &&
+         read_entry(rows[0].uuid, &check, db) == NOT_FOUND_ERR;
+
+    return ok && delete_all_entries(db) == OK;
+}
+
+bool test_entry_cursor() {
+    IntVaultEntry rows[BATCH_ROWS];
+    char uuids[BATCH_ROWS][UUID_STR_LEN + 1];
+    uint8_t record[] = {0x02, 0x01, 0x02, 0x03};
+
+    for (int i = 0; i < BATCH_ROWS; i++) {
+        snprintf(uuids[i], sizeof(uuids[i]), "00000000-0000-4000-8000-%012d", i);
+        rows[i] = (IntVaultEntry){.uuid = uuids[i],
+                                  .record = record,
+                                  .record_len = sizeof(record),
+                                  .created_at = (uint64_t)i,
+                                  .updated_at = (uint64_t)i};
+    }
+    if (add_entries(rows, BATCH_ROWS, 0, NULL, db) != OK) {
+        return false;
+    }
+
+    EntryCursor *owned = NULL;
+    EntryCursor *borrowed = NULL;
+    IntVaultEntry copy, view;
+    int seen = 0;
+    bool ok = open_entry_cursor(false, &owned, db) == OK &&
+              open_entry_cursor(true, &borrowed, db) == OK;
+
+    /* both walk the same rows in the same order */
+    while (ok && next_entry(owned, &copy) == OK) {
+        ok = next_entry(borrowed, &view) == OK && strcmp(copy.uuid, view.uuid) == 0 &&
+             copy.created_at == view.created_at && view.record_len == sizeof(record) &&
+             memcmp(view.record, record, sizeof(record)) == 0 && copy.record != view.record &&
+             view.service_name == NULL;
+        free_int_entry(&copy);
+        seen++;
+    }
+    ok = ok && seen == BATCH_ROWS && next_entry(borrowed, &view) == NOT_FOUND_ERR &&
+         next_entry(owned, &copy) == NOT_FOUND_ERR;
+    close_entry_cursor(owned);
+    close_entry_cursor(borrowed);
+
+    /* a cursor closed half way leaves the table writable */
+    ok = ok && open_entry_cursor(true, &borrowed, db) == OK && next_entry(borrowed, &view) == OK;
+    close_entry_cursor(borrowed);
+
+    return ok && delete_all_entries(db) == OK;
+}
+
+/* walks every page of order, checking each entry comes once and after the previous one */
+static bool walk_pages(entry_order order, uint32_t limit) {
+    char token[ENTRY_PAGE_TOKEN_LEN] = "";
+    char previous_uuid[UUID_STR_LEN + 1] = "";
+    uint64_t previous_time = 0;
+    int seen = 0;
+
+    do {
+        DLinkedList *page = dlinked_list_create();
+        char next[ENTRY_PAGE_TOKEN_LEN];
+
+        if (!page || read_entries_page(order, token, limit, page, next, db) != OK ||
+            page->size > limit || (next[0] && page->size != limit)) {
+            dlinked_list_destroy(page, free_int_entry_node);
+            return false;
+        }
+
+        bool ordered = true;
+        for (DLinkedListNode *node = page->head; node && ordered; node = node->next) {
+            const IntVaultEntry *entry = node->data;
+
+            if (seen) {
+                int uuid_cmp = strcmp(entry->uuid, previous_uuid);
+                ordered = (order == ENTRY_ORDER_UUID)
+                              ? uuid_cmp > 0
+                              : entry->updated_at < previous_time ||
+                                    (entry->updated_at == previous_time && uuid_cmp < 0);
+            }
+            strcpy(previous_uuid, entry->uuid);
+            previous_time = entry->updated_at;
+            seen++;
+        }
+        dlinked_list_destroy(page, free_int_entry_node);
+
+        if (!ordered) {
+            return false;
+        }
+        strcpy(token, next);
+    } while (token[0]);
+
+    return seen == BATCH_ROWS;
+}
+
+bool test_entry_pages() {
+    IntVaultEntry rows[BATCH_ROWS];
+    char uuids[BATCH_ROWS][UUID_STR_LEN + 1];
+    uint8_t record[] = {0x02, 0x01};
+
+    /* only five distinct times, the uuid orders the ties. The nil uuid sorts first */
+    strcpy(uuids[0], "00000000-0000-0000-0000-000000000000");
+    for (int i = 0; i < BATCH_ROWS; i++) {
+        if (i) {
+            snprintf(uuids[i], sizeof(uuids[i]), "%08x-0000-4000-8000-000000000000", i * 7919);
+        }
+        rows[i] = (IntVaultEntry){.uuid = uuids[i],
+                                  .record = record,
+                                  .record_len = sizeof(record),
+                                  .created_at = 1,
+                                  .updated_at = (uint64_t)(1700000000 + i % 5)};
+    }
+    if (add_entries(rows, BATCH_ROWS, 0, NULL, db) != OK) {
+        return false;
+    }
+
+    bool ok = walk_pages(ENTRY_ORDER_UUID, 7) && walk_pages(ENTRY_ORDER_UUID, BATCH_ROWS) &&
+              walk_pages(ENTRY_ORDER_RECENT, 7) && walk_pages(ENTRY_ORDER_RECENT, 1) &&
+              walk_pages(ENTRY_ORDER_RECENT, BATCH_ROWS + 1);
+
+    /* tokens are checked and bound to their order */
+    DLinkedList *page = dlinked_list_create();
+    char next[ENTRY_PAGE_TOKEN_LEN];
+    ok = ok && page && read_entries_page(ENTRY_ORDER_UUID, NULL, 3, page, next, db) == OK &&
+         next[0] == 'u' &&
+         read_entries_page(ENTRY_ORDER_RECENT, next, 3, page, next, db) == NOT_FOUND_ERR &&
+         read_entries_page(ENTRY_ORDER_RECENT, "r:12x:", 3, page, next, db) == NOT_FOUND_ERR &&
+         page->size == 3 && strcmp(((IntVaultEntry *)page->head->data)->uuid, uuids[0]) == 0;
+    dlinked_list_destroy(page, free_int_entry_node);
+
+    /* read_entries_after() pages the same way */
+    page = dlinked_list_create();
+    ok = ok && page && read_entries_after(NULL, 2, page, db) == OK &&
+         read_entries_after(((IntVaultEntry *)page->tail->data)->uuid, BATCH_ROWS, page, db) ==
+             OK &&
+         page->size == BATCH_ROWS &&
+         strcmp(((IntVaultEntry *)page->head->data)->uuid, uuids[0]) == 0 &&
+         read_entries_after("not-a-uuid", 1, page, db) == NOT_FOUND_ERR;
+    dlinked_list_destroy(page, free_int_entry_node);
+
+    return ok && delete_all_entries(db) == OK;
+}
+
 bool close_test() {
     if (!clean_environment()) {
         printf(COLOR_YELLOW "an error occured when cleaning the environment\n" COLOR_RESET);
         return false;
     }
-    if (sqlite3_close(db) != SQLITE_OK) {
+    if (repo_close(db) != SQLITE_OK) {
         return false;
     }
     return true;
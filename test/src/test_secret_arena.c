@@ -0,0 +1,243 @@
+#include <CVault/utils/secret_arena.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define COLOR_RESET  "\033[0m"
+#define COLOR_GREEN  "\033[0;32m"
+#define COLOR_RED    "\033[0;31m"
+#define COLOR_BLUE   "\033[34m"
+#define COLOR_YELLOW "\033[1;33m"
+#define COLOR_CYAN   "\033[0;36m"
+
+#define THREADS           4
+#define ALLOCS_PER_THREAD 5000
+#define BLOCK_SIZE        24
+
+static bool all_zero(const uint8_t *bytes, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (bytes[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool test_alloc() {
+    SecretArena *arena = secret_arena_create(0);
+    SecretArenaStats stats;
+
+    uint8_t *a = secret_arena_alloc(arena, 5);
+    uint8_t *b = secret_arena_alloc(arena, 100);
+    char *text = secret_arena_strndup(arena, "secret", 6);
+
+    bool ok = a && b && text && ((uintptr_t)a % SECRET_ARENA_ALIGN) == 0 &&
+              ((uintptr_t)b % SECRET_ARENA_ALIGN) == 0 && b >= a + 5 && all_zero(b, 100) &&
+              strcmp(text, "secret") == 0 && !secret_arena_alloc(arena, 0) &&
+              !secret_arena_alloc(NULL, 8);
+
+    secret_arena_stats(arena, &stats);
+    printf(COLOR_CYAN ">> %u region, %lu bytes, %lu locked\n" COLOR_RESET, stats.regions,
+           (unsigned long)stats.capacity, (unsigned long)stats.locked);
+    ok = ok && stats.regions == 1 && stats.allocations == 3 &&
+         stats.capacity >= SECRET_ARENA_REGION_SIZE && stats.used == 16 + 112 + 16;
+
+    secret_arena_destroy(arena);
+    return ok;
+}
+
+/* a block larger than a region is served by a region of its own */
+static bool test_large_block() {
+    SecretArena *arena = secret_arena_create(4096);
+    SecretArenaStats stats;
+
+    uint8_t *small = secret_arena_alloc(arena, 64);
+    uint8_t *large = secret_arena_alloc(arena, 1 << 20);
+    bool ok = small && large && all_zero(large, 1 << 20);
+    if (ok) {
+        memset(large, 0xAA, 1 << 20);
+    }
+
+    secret_arena_stats(arena, &stats);
+    ok = ok && stats.regions == 2 && stats.capacity >= (1 << 20) + 4096 - 64;
+
+    secret_arena_destroy(arena);
+    return ok;
+}
+
+/* rewinding wipes what came after the mark and hands the same space out again */
+static bool test_rewind() {
+    SecretArena *arena = secret_arena_create(4096);
+    SecretArenaStats stats;
+
+    char *kept = secret_arena_strndup(arena, "kept", 4);
+    SecretArenaMark mark = secret_arena_mark(arena);
+    char *dropped = secret_arena_strndup(arena, "dropped", 7);
+    bool ok = kept && dropped;
+
+    /* spill into more regions */
+    for (int i = 0; ok && i < 100; i++) {
+        uint8_t *block = secret_arena_alloc(arena, 1000);
+        ok = block != NULL;
+        if (ok) {
+            memset(block, 0x55, 1000);
+        }
+    }
+
+    secret_arena_stats(arena, &stats);
+    ok = ok && stats.regions > 1;
+
+    secret_arena_rewind(arena, mark);
+    secret_arena_stats(arena, &stats);
+    ok = ok && stats.regions == 1 && strcmp(kept, "kept") == 0 && all_zero((uint8_t *)dropped, 8);
+
+    char *again = secret_arena_alloc(arena, 8);
+    ok = ok && again == dropped;
+
+    secret_arena_destroy(arena);
+    return ok;
+}
+
+static bool test_reset() {
+    SecretArena *arena = secret_arena_create(4096);
+    SecretArenaStats stats;
+
+    char *first = secret_arena_strndup(arena, "password", 8);
+    for (int i = 0; first && i < 20; i++) {
+        secret_arena_alloc(arena, 1000);
+    }
+
+    secret_arena_reset(arena);
+    secret_arena_stats(arena, &stats);
+    bool ok = first && stats.regions == 1 && stats.used == 0 && stats.allocations == 0 &&
+              all_zero((uint8_t *)first, 9);
+
+    /* the oldest region is the one kept */
+    ok = ok && secret_arena_alloc(arena, 1) == (void *)first;
+
+    secret_arena_destroy(arena);
+    return ok;
+}
+
+/* true when the child touching addr dies of SIGSEGV */
+static bool faults(volatile uint8_t *addr) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        return false;
+    }
+    if (pid == 0) {
+        signal(SIGSEGV, SIG_DFL);
+        *addr = 1;
+        _exit(0);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV;
+}
+
+static bool test_guard_pages() {
+    SecretArena *arena = secret_arena_create(0);
+    SecretArenaStats stats;
+    long page = sysconf(_SC_PAGESIZE);
+
+    uint8_t *block = secret_arena_alloc(arena, 1);
+    secret_arena_stats(arena, &stats);
+
+    /* the header fits in the first page, the block comes right after it */
+    uint8_t *first_page = (uint8_t *)((uintptr_t)block & ~(uintptr_t)(page - 1));
+    bool ok = block && faults(first_page - 1) && faults(block + stats.capacity) &&
+              !faults(block + stats.capacity - 1);
+
+    secret_arena_destroy(arena);
+    return ok;
+}
+
+typedef struct {
+    SecretArena *arena;
+    uint8_t id;
+    uint8_t *blocks[ALLOCS_PER_THREAD];
+} Filler;
+
+static void *fill(void *arg) {
+    Filler *filler = arg;
+
+    for (int i = 0; i < ALLOCS_PER_THREAD; i++) {
+        filler->blocks[i] = secret_arena_alloc(filler->arena, BLOCK_SIZE);
+        if (filler->blocks[i]) {
+            memset(filler->blocks[i], filler->id, BLOCK_SIZE);
+        }
+    }
+    return NULL;
+}
+
+static bool test_threads() {
+    static Filler fillers[THREADS];
+    pthread_t threads[THREADS];
+    SecretArena *arena = secret_arena_create(0);
+    SecretArenaStats stats;
+    bool ok = arena != NULL;
+
+    for (int t = 0; t < THREADS; t++) {
+        fillers[t].arena = arena;
+        fillers[t].id = (uint8_t)(t + 1);
+        ok = ok && pthread_create(&threads[t], NULL, fill, &fillers[t]) == 0;
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    /* no block was handed out twice */
+    for (int t = 0; ok && t < THREADS; t++) {
+        for (int i = 0; ok && i < ALLOCS_PER_THREAD; i++) {
+            uint8_t *block = fillers[t].blocks[i];
+            ok = block && block[0] == fillers[t].id && block[BLOCK_SIZE - 1] == fillers[t].id;
+        }
+    }
+
+    secret_arena_stats(arena, &stats);
+    ok = ok && stats.allocations == THREADS * ALLOCS_PER_THREAD;
+
+    secret_arena_destroy(arena);
+    return ok;
+}
+
+static void report(const char *name, bool ok, bool *passed) {
+    if (ok) {
+        printf(COLOR_GREEN "[PASS] " COLOR_RESET "%s\n", name);
+    } else {
+        printf(COLOR_RED "[FAIL] " COLOR_RESET "%s\n", name);
+        *passed = false;
+    }
+}
+
+int main() {
+    printf(COLOR_BLUE "\nSECRET ARENA TEST\n" COLOR_RESET);
+
+    bool passed = true;
+
+    printf(COLOR_YELLOW "\n--> allocation\n" COLOR_RESET);
+    report("aligned zeroed blocks", test_alloc(), &passed);
+    report("oversized block gets its own region", test_large_block(), &passed);
+    report("blocks handed out once across threads", test_threads(), &passed);
+
+    printf(COLOR_YELLOW "\n--> release\n" COLOR_RESET);
+    report("rewind wipes and reuses what followed the mark", test_rewind(), &passed);
+    report("reset wipes everything and keeps one region", test_reset(), &passed);
+
+    printf(COLOR_YELLOW "\n--> protection\n" COLOR_RESET);
+    report("guard pages on both sides of a region", test_guard_pages(), &passed);
+
+    if (!passed) {
+        printf(COLOR_RED "\nSECRET ARENA TEST FAILED\n\n" COLOR_RESET);
+        return 1;
+    }
+
+    printf(COLOR_BLUE "\nSECRET ARENA TEST COMPLETED\n\n" COLOR_RESET);
+    return 0;
+}
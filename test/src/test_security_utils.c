@@ -1,8 +1,11 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <sys/wait.h>
+#include <time.h>
 #include <CVault/utils/security_utils.h>
 
 #define COLOR_RESET  "\033[0m"
@@ -12,8 +15,20 @@
 #define COLOR_YELLOW "\033[1;33m"
 #define COLOR_CYAN   "\033[0;36m"
 
+#define BENCH_SIZE   (1024 * 1024)
+#define BENCH_ROUNDS 15
+
+/* set to check the timings instead of only printing them, wall clock flakes on loaded hosts */
+#define BENCH_CHECK_ENV "CVAULT_BENCH_CHECK"
+
 const char* util_code_to_str(util_result_code code);
 static void print_result(const char* test_name, util_result_code code);
+static double elapsed_ms(struct timespec start);
+static void byte_wipe(void *ptr, size_t length);
+static double median_compare_ms(const uint8_t *a, const uint8_t *b, size_t length);
+
+static uint8_t bench_a[BENCH_SIZE];
+static uint8_t bench_b[BENCH_SIZE];
 
 int main() {
     printf(COLOR_BLUE "\nSECURITY UTILS TEST\n" COLOR_RESET);
@@ -31,6 +46,18 @@ int main() {
         }
     }
 
+    uint8_t uuid_bytes[UUID_BIN_LEN];
+    char uuid_again[UUID_STR_LEN + 1];
+    res = (res == SUCCESS && uuid_from_string(uuid_buf, uuid_bytes)) ? SUCCESS : UNEXPECTED_ERR;
+    if (res == SUCCESS) {
+        uuid_to_string(uuid_bytes, uuid_again);
+        if (strcmp(uuid_again, uuid_buf) != 0 || uuid_from_string("not-a-uuid", uuid_bytes) ||
+            !uuid_from_string("3F2B8C1E-9A4D-4E6F-8B7A-0C1D2E3F4A5B", uuid_bytes)) {
+            res = UNEXPECTED_ERR;
+        }
+    }
+    print_result("UUID bytes round trip", res);
+
     printf(COLOR_YELLOW "\n--> Testing Password Generation\n" COLOR_RESET);
     char pass_buf[MAX_LEN + 1];
     uint64_t lengths[] = {8, 16, 32};
@@ -47,6 +74,47 @@ int main() {
         }
     }
 
+    printf(COLOR_YELLOW "\n--> Testing Batch Password Generation\n" COLOR_RESET);
+    enum { BATCH = 2000, BATCH_LEN = 12, STRIDE = BATCH_LEN + 1 };
+    static char batch[BATCH * STRIDE];
+    password_policy policy = {.length = BATCH_LEN,
+                              .classes = PASSWORD_CLASS_ALL,
+                              .required = PASSWORD_CLASS_ALL};
+
+    res = generate_passwords(&policy, BATCH, batch, STRIDE);
+    for (int i = 0; res == SUCCESS && i < BATCH; i++) {
+        const char *p = batch + i * STRIDE;
+        bool lower = false, upper = false, digit = false, symbol = false;
+
+        for (int j = 0; j < BATCH_LEN; j++) {
+            lower |= p[j] >= 'a' && p[j] <= 'z';
+            upper |= p[j] >= 'A' && p[j] <= 'Z';
+            digit |= p[j] >= '0' && p[j] <= '9';
+            symbol |= strchr("!@#$%^&*()-_=+", p[j]) != NULL && p[j] != '\0';
+        }
+        if (strlen(p) != BATCH_LEN || !lower || !upper || !digit || !symbol) {
+            res = UNEXPECTED_ERR;
+        }
+    }
+    print_result("Generate 2000 passwords with every class", res);
+    if (res == SUCCESS) {
+        printf(COLOR_CYAN "First: %s, last: %s\n" COLOR_RESET, batch,
+               batch + (BATCH - 1) * STRIDE);
+    }
+
+    password_policy digits_only = {.length = 4, .classes = PASSWORD_CLASS_DIGIT, .required = 0};
+    res = generate_passwords(&digits_only, 1, batch, STRIDE);
+    if (res == SUCCESS && strspn(batch, "0123456789") != 4) {
+        res = UNEXPECTED_ERR;
+    }
+    print_result("Generate a digits only PIN", res);
+
+    password_policy impossible = {.length = 3, .classes = PASSWORD_CLASS_ALL,
+                                  .required = PASSWORD_CLASS_ALL};
+    res = generate_passwords(&impossible, 1, batch, STRIDE) == INVALID_SIZE ? SUCCESS
+                                                                           : UNEXPECTED_ERR;
+    print_result("Reject a policy longer than the password", res);
+
     printf(COLOR_YELLOW "\n--> Testing Secure Memset\n" COLOR_RESET);
     char sensitive_data[] = "SuperSecret123";
     size_t data_len = strlen(sensitive_data);
@@ -66,6 +134,108 @@ int main() {
         printf(COLOR_RED ">> Memory NOT cleared properly\n" COLOR_RESET);
     }
 
+    printf(COLOR_YELLOW "\n--> Testing Large Wipe and Compare\n" COLOR_RESET);
+    memset(bench_a, 0xA5, BENCH_SIZE);
+    res = secure_memset(bench_a, BENCH_SIZE);
+    for (size_t i = 0; res == SUCCESS && i < BENCH_SIZE; i++) {
+        if (bench_a[i] != 0) res = UNEXPECTED_ERR;
+    }
+    print_result("Secure Memset of 1 MiB", res);
+    res = (secure_memset(bench_a, 0) == INVALID_SIZE) ? SUCCESS : UNEXPECTED_ERR;
+    print_result("Secure Memset rejects an empty width", res);
+
+    /* every length and difference position across the vector, word and byte paths */
+    res = SUCCESS;
+    for (size_t len = 0; res == SUCCESS && len <= 3 * CT_COMPARE_BLOCK + 9; len++) {
+        if (!constant_time_equal(bench_a + 1, bench_b + 3, len)) res = UNEXPECTED_ERR;
+        for (size_t pos = 0; res == SUCCESS && pos < len; pos++) {
+            bench_b[3 + pos] = 0x80;
+            if (constant_time_equal(bench_a + 1, bench_b + 3, len)) res = UNEXPECTED_ERR;
+            bench_b[3 + pos] = 0;
+        }
+    }
+    print_result("Constant time compare finds any differing byte", res);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        secure_memset(bench_a, BENCH_SIZE);
+    }
+    double wipe_ms = elapsed_ms(start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        byte_wipe(bench_a, BENCH_SIZE);
+    }
+    double byte_ms = elapsed_ms(start);
+
+    double equal_ms = median_compare_ms(bench_a, bench_b, BENCH_SIZE);
+    bench_b[0] = 1;
+    double first_ms = median_compare_ms(bench_a, bench_b, BENCH_SIZE);
+    bench_b[0] = 0;
+    bench_b[BENCH_SIZE - 1] = 1;
+    double last_ms = median_compare_ms(bench_a, bench_b, BENCH_SIZE);
+    bench_b[BENCH_SIZE - 1] = 0;
+
+    double gib = (double)BENCH_SIZE * BENCH_ROUNDS / (1024.0 * 1024.0 * 1024.0);
+    printf(COLOR_CYAN ">> wipe %.2f GiB/s (byte loop %.2f GiB/s), compare %.2f GiB/s\n" COLOR_RESET,
+           gib / (wipe_ms / 1e3), gib / (byte_ms / 1e3),
+           (double)BENCH_SIZE / (1024.0 * 1024.0 * 1024.0) / (equal_ms / 1e3));
+    printf(COLOR_CYAN ">> compare 1 MiB: equal %.3f ms, first byte differs %.3f ms, "
+                      "last byte differs %.3f ms\n" COLOR_RESET,
+           equal_ms, first_ms, last_ms);
+
+    /* an early exit would finish the first byte case in next to no time */
+    double fastest = first_ms < last_ms ? first_ms : last_ms;
+    double slowest = first_ms > last_ms ? first_ms : last_ms;
+    fastest = equal_ms < fastest ? equal_ms : fastest;
+    slowest = equal_ms > slowest ? equal_ms : slowest;
+    printf(COLOR_CYAN ">> fastest / slowest compare: %.2f\n" COLOR_RESET, fastest / slowest);
+    if (getenv(BENCH_CHECK_ENV)) {
+        res = (fastest > slowest / 2) ? SUCCESS : UNEXPECTED_ERR;
+        print_result("Compare time does not depend on where bytes differ", res);
+    } else {
+        printf(COLOR_YELLOW "[SKIP] timing check, set " BENCH_CHECK_ENV " to run it\n" COLOR_RESET);
+    }
+
+    printf(COLOR_YELLOW "\n--> Testing Random Pool\n" COLOR_RESET);
+    uint8_t parent_bytes[32], child_bytes[32];
+    uint8_t large[RANDOM_POOL_SIZE * 2];
+    int fds[2];
+
+    /* the parent's pool is filled, the child must not replay it */
+    res = random_raw_bytes(sizeof(parent_bytes), parent_bytes);
+    if (res == SUCCESS && pipe(fds) == 0) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            bool sent = random_raw_bytes(sizeof(child_bytes), child_bytes) == SUCCESS &&
+                        write(fds[1], child_bytes, sizeof(child_bytes)) == sizeof(child_bytes);
+            _exit(sent ? 0 : 1);
+        }
+        close(fds[1]);
+        bool received = pid > 0 &&
+                        read(fds[0], child_bytes, sizeof(child_bytes)) == sizeof(child_bytes);
+        close(fds[0]);
+        if (pid > 0) {
+            waitpid(pid, NULL, 0);
+        }
+
+        res = random_raw_bytes(sizeof(parent_bytes), parent_bytes);
+        if (res == SUCCESS && (!received ||
+                               memcmp(parent_bytes, child_bytes, sizeof(child_bytes)) == 0)) {
+            res = UNEXPECTED_ERR;
+        }
+    }
+    print_result("Forked child draws its own bytes", res);
+
+    memset(large, 0, sizeof(large));
+    res = random_raw_bytes(sizeof(large), large);
+    if (res == SUCCESS && memcmp(large, large + RANDOM_POOL_SIZE, RANDOM_POOL_SIZE) == 0) {
+        res = UNEXPECTED_ERR;
+    }
+    print_result("Request larger than the pool", res);
+
     printf(COLOR_YELLOW "\n--> Testing Clipboard (wl-copy)\n" COLOR_RESET);
     printf(COLOR_CYAN "Note: This will copy 'CVault-Test-Token' to your clipboard.\n" COLOR_RESET);
     printf(COLOR_CYAN "It will be cleared automatically in %d seconds.\n" COLOR_RESET, TIMEOUT);
@@ -99,6 +269,42 @@ const char* util_code_to_str(util_result_code code) {
         default:             return "UNKNOWN_ERROR";
     }
 }
+static double elapsed_ms(struct timespec start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)(end.tv_sec - start.tv_sec) * 1e3 + (double)(end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+/* the one volatile byte at a time wipe secure_memset used to be */
+static void byte_wipe(void *ptr, size_t length) {
+    volatile uint8_t *p = (volatile uint8_t *)ptr;
+    while (length--) {
+        *p++ = 0;
+    }
+}
+
+static double median_compare_ms(const uint8_t *a, const uint8_t *b, size_t length) {
+    double runs[BENCH_ROUNDS];
+    volatile bool sink = false;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        sink = constant_time_equal(a, b, length);
+        runs[round] = elapsed_ms(start);
+    }
+    (void)sink;
+
+    for (int i = 1; i < BENCH_ROUNDS; i++) {
+        for (int j = i; j > 0 && runs[j - 1] > runs[j]; j--) {
+            double swap = runs[j];
+            runs[j] = runs[j - 1];
+            runs[j - 1] = swap;
+        }
+    }
+    return runs[BENCH_ROUNDS / 2];
+}
+
 static void print_result(const char* test_name, util_result_code code) {
     if (code == SUCCESS) {
         printf(COLOR_GREEN "[PASS] " COLOR_RESET "%s\n", test_name);
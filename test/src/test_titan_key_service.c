@@ -0,0 +1,182 @@
+#include <CVault/crypto/crypto_core.h>
+#include <CVault/service/environment_service.h>
+#include <CVault/service/titan_key_service.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define COLOR_RESET  "\033[0m"
+#define COLOR_GREEN  "\033[0;32m"
+#define COLOR_RED    "\033[0;31m"
+#define COLOR_BLUE   "\033[34m"
+#define COLOR_YELLOW "\033[1;33m"
+#define COLOR_CYAN   "\033[0;36m"
+
+static bool read_blob(uint8_t *blob) {
+    int fd = open(titan_key_path, O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    bool ok = read(fd, blob, TITAN_BLOB_SIZE_V02) == TITAN_BLOB_SIZE_V02;
+    close(fd);
+    return ok;
+}
+
+static bool write_blob(const uint8_t *blob) {
+    int fd = open(titan_key_path, O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        return false;
+    }
+    bool ok = write(fd, blob, TITAN_BLOB_SIZE_V01) == TITAN_BLOB_SIZE_V01;
+    close(fd);
+    return ok;
+}
+
+static double elapsed_ms(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+static bool test_init_writes_v2() {
+    uint8_t blob[TITAN_BLOB_SIZE_V02];
+
+    if (!init_titan_key()) {
+        printf(COLOR_RED ">> init_titan_key failed, tk_status %d\n" COLOR_RESET, tk_status);
+        return false;
+    }
+
+    return read_blob(blob) && blob[0] == TITAN_KEY_VERSION_02 && is_valid_titan_key();
+}
+
+static bool test_load_v2() {
+    uint8_t blob[TITAN_BLOB_SIZE_V02];
+    uint8_t key[TITAN_KEY_SIZE_V02];
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool loaded = load_titan_key(key);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf(COLOR_CYAN ">> v2 load: %.3f ms\n" COLOR_RESET, elapsed_ms(start, end));
+
+    return loaded && read_blob(blob) && memcmp(key, blob + 1, TITAN_KEY_SIZE_V02) == 0;
+}
+
+static bool test_tampered_rejected() {
+    uint8_t blob[TITAN_BLOB_SIZE_V02];
+    uint8_t key[TITAN_KEY_SIZE_V02];
+
+    if (!read_blob(blob)) {
+        return false;
+    }
+
+    blob[1] ^= 0x01;
+    if (!write_blob(blob)) {
+        return false;
+    }
+
+    bool rejected = !load_titan_key(key) && tk_status == TKS_TAMPERD;
+
+    blob[1] ^= 0x01;
+    return write_blob(blob) && rejected;
+}
+
+/* load checks the opened file itself: mode and presence */
+static bool test_file_checks_on_load() {
+    uint8_t key[TITAN_KEY_SIZE_V02];
+
+    if (chmod(titan_key_path, S_IRUSR | S_IWUSR | S_IRGRP) == -1) {
+        return false;
+    }
+    bool mode_rejected = !load_titan_key(key) && tk_status == TKS_TAMPERD;
+    if (chmod(titan_key_path, S_IRUSR | S_IWUSR) == -1) {
+        return false;
+    }
+
+    uint8_t blob[TITAN_BLOB_SIZE_V02];
+    if (!read_blob(blob) || !wipe_titan_key()) {
+        return false;
+    }
+    bool missing_reported = !load_titan_key(key) && tk_status == TKS_NOTKF;
+
+    return write_blob(blob) && mode_rejected && missing_reported && load_titan_key(key);
+}
+
+static bool test_v1_migrated() {
+    uint8_t blob[TITAN_BLOB_SIZE_V01];
+    uint8_t key[TITAN_KEY_SIZE_V01];
+    uint8_t tmp_salt[SALT_LEN] = {0x06};
+    struct timespec start, end;
+
+    /* a key file as written by the v1 init_titan_key */
+    blob[0] = TITAN_KEY_VERSION_01;
+    for (int i = 0; i < TITAN_KEY_SIZE_V01; i++) {
+        blob[1 + i] = (uint8_t)(0xA0 + i);
+    }
+    if (!hash_key(blob + 1, tmp_salt, blob + 1 + TITAN_KEY_SIZE_V01) || !write_blob(blob)) {
+        return false;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool loaded = load_titan_key(key);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf(COLOR_CYAN ">> v1 load (with migration): %.3f ms\n" COLOR_RESET, elapsed_ms(start, end));
+
+    if (!loaded || memcmp(key, blob + 1, TITAN_KEY_SIZE_V01) != 0) {
+        return false;
+    }
+
+    uint8_t migrated[TITAN_BLOB_SIZE_V02];
+    if (!read_blob(migrated) || migrated[0] != TITAN_KEY_VERSION_02 || !is_valid_titan_key()) {
+        return false;
+    }
+
+    return load_titan_key(key) && memcmp(key, blob + 1, TITAN_KEY_SIZE_V01) == 0;
+}
+
+static void report(const char *name, bool ok, bool *passed) {
+    if (ok) {
+        printf(COLOR_GREEN "[PASS] " COLOR_RESET "%s\n", name);
+    } else {
+        printf(COLOR_RED "[FAIL] " COLOR_RESET "%s\n", name);
+        *passed = false;
+    }
+}
+
+int main() {
+    printf(COLOR_BLUE "\nTITAN KEY SERVICE TEST\n" COLOR_RESET);
+
+    printf(COLOR_YELLOW "\n--> setup phase\n" COLOR_RESET);
+    if (!initialize_environment()) {
+        printf(COLOR_RED ">> Failed to initialize the environment\n" COLOR_RESET);
+        return 1;
+    }
+    wipe_titan_key();
+
+    bool passed = true;
+
+    printf(COLOR_YELLOW "\n--> key file formats\n" COLOR_RESET);
+    report("init writes a v2 key", test_init_writes_v2(), &passed);
+    report("v2 key loads", test_load_v2(), &passed);
+    report("tampered key rejected", test_tampered_rejected(), &passed);
+    report("key file checked on load", test_file_checks_on_load(), &passed);
+    report("v1 key migrated to v2 on load", test_v1_migrated(), &passed);
+
+    /* leave a fresh key for the other tests */
+    wipe_titan_key();
+    init_titan_key();
+
+    if (!passed) {
+        printf(COLOR_RED "\nTITAN KEY SERVICE TEST FAILED\n\n" COLOR_RESET);
+        return 1;
+    }
+
+    printf(COLOR_BLUE "\nTITAN KEY SERVICE TEST COMPLETED\n\n" COLOR_RESET);
+    return 0;
+}
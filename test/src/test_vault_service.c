@@ -0,0 +1,539 @@
+#include <CVault/crypto/crypto_core.h>
+#include <CVault/repository/repository.h>
+#include <CVault/service/db_config_service.h>
+#include <CVault/service/db_init_service.h>
+#include <CVault/service/entry_service.h>
+#include <CVault/service/environment_service.h>
+#include <CVault/service/kdf_service.h>
+#include <CVault/service/titan_key_service.h>
+#include <CVault/service/vault_service.h>
+#include <CVault/utils/security_utils.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COLOR_RESET  "\033[0m"
+#define COLOR_GREEN  "\033[0;32m"
+#define COLOR_RED    "\033[0;31m"
+#define COLOR_BLUE   "\033[34m"
+#define COLOR_YELLOW "\033[1;33m"
+#define COLOR_CYAN   "\033[0;36m"
+
+#define PASSWORD     "correct horse battery staple"
+#define NEW_PASSWORD "tr0ub4dor&3"
+#define SECRET       "hunter2"
+
+static const KdfParams fast_params = {.t_cost = 1, .m_cost = KDF_MIN_M_COST, .p_cost = 1};
+static const KdfParams stronger_params = {.t_cost = 2, .m_cost = KDF_MIN_M_COST, .p_cost = 1};
+
+static uint8_t master_key[VAULT_MASTER_KEY_LEN];
+
+static bool reset_vault() {
+    sqlite3 *db = NULL;
+
+    service_delete_config(KDF_DESCRIPTOR_CONFIG_KEY);
+    service_delete_config(VAULT_VERIFIER_CONFIG_KEY);
+    service_delete_config(VAULT_PENDING_CONFIG_KEY);
+    service_delete_config(VAULT_CIPHER_CONFIG_KEY);
+    service_delete_config(VAULT_DATA_KEY_CONFIG_KEY);
+    service_delete_config(VAULT_ROTATION_CONFIG_KEY);
+
+    if (sqlite3_open(db_vault_path, &db) != SQLITE_OK) {
+        return false;
+    }
+    bool ok = delete_all_entries(db) == OK;
+    repo_close(db);
+    return ok;
+}
+
+#define SECRET_UUID "00000000-0000-4000-8000-000000000001"
+#define NIL_UUID    "00000000-0000-0000-0000-000000000000"
+
+/* stores one legacy per-field entry whose password field is SECRET encrypted with key */
+static bool add_secret_entry_at(const char *uuid, const uint8_t *key) {
+    sqlite3 *db = NULL;
+    uint8_t blob[sizeof(SECRET) + IV_LEN + TAG_LEN];
+
+    if (!encrypt_blob(key, (const uint8_t *)SECRET, sizeof(SECRET), blob)) {
+        return false;
+    }
+
+    IntVaultEntry entry = {.uuid = (char *)uuid,
+                           .service_name = blob,
+                           .username = blob,
+                           .password = blob,
+                           .notes = NULL,
+                           .service_len = sizeof(blob),
+                           .username_len = sizeof(blob),
+                           .password_len = sizeof(blob),
+                           .created_at = 1,
+                           .updated_at = 1};
+
+    if (sqlite3_open(db_vault_path, &db) != SQLITE_OK) {
+        return false;
+    }
+    bool ok = add_entry(&entry, db) == OK;
+    repo_close(db);
+    return ok;
+}
+
+static bool add_secret_entry(const uint8_t *key) {
+    return add_secret_entry_at(SECRET_UUID, key);
+}
+
+static bool secret_at_opens_with(const char *uuid, const uint8_t *key) {
+    sqlite3 *db = NULL;
+    IntVaultEntry row = {0};
+    ExtVaultEntry entry = {0};
+    AeadContext *aead = NULL;
+
+    if (sqlite3_open(db_vault_path, &db) != SQLITE_OK) {
+        return false;
+    }
+    bool ok = read_entry(uuid, &row, db) == OK;
+    repo_close(db);
+
+    /* upgrades leave records in the vault's cipher, only the first unlock sees field blobs */
+    uint8_t cipher = 0;
+    ok = ok && read_vault_cipher(&cipher) && (!row.record || row.record[1] == cipher) &&
+         (aead = aead_context_new(key)) && decrypt_entry(aead, &row, &entry) &&
+         memcmp(entry.password, SECRET, sizeof(SECRET)) == 0;
+
+    free_ext_entry(&entry);
+    aead_context_free(aead);
+    free_int_entry(&row);
+    return ok;
+}
+
+static bool remove_entry(const char *uuid) {
+    sqlite3 *db = NULL;
+
+    if (sqlite3_open(db_vault_path, &db) != SQLITE_OK) {
+        return false;
+    }
+    bool ok = delete_entry(uuid, db) == OK;
+    repo_close(db);
+    return ok;
+}
+
+static bool secret_opens_with(const uint8_t *key) {
+    return secret_at_opens_with(SECRET_UUID, key);
+}
+
+/* the wrapped data key, to tell when it was replaced */
+static bool read_wrapped_key(Config *out_config) {
+    memset(out_config, 0, sizeof(Config));
+    return service_read_config(VAULT_DATA_KEY_CONFIG_KEY, out_config);
+}
+
+static bool same_config_value(const Config *a, const Config *b) {
+    return a->config_value_len == b->config_value_len &&
+           memcmp(a->config_value, b->config_value, a->config_value_len) == 0;
+}
+
+static void free_config(Config *config) {
+    free(config->config_key);
+    free(config->config_value);
+}
+
+/* true while the secret entry still holds the per-field blobs it was added with */
+static bool secret_row_untouched() {
+    sqlite3 *db = NULL;
+    IntVaultEntry row = {0};
+
+    if (sqlite3_open(db_vault_path, &db) != SQLITE_OK) {
+        return false;
+    }
+    bool ok = read_entry(SECRET_UUID, &row, db) == OK &&
+              !row.record && row.password;
+    repo_close(db);
+
+    free_int_entry(&row);
+    return ok;
+}
+
+static bool test_create() {
+    uint8_t cipher = 0;
+
+    set_kdf_params(&fast_params);
+
+    /* the other cipher than this host's default, so both get exercised */
+    uint8_t chosen = (preferred_cipher() == CIPHER_AES_256_GCM) ? CIPHER_CHACHA20_POLY1305
+                                                               : CIPHER_AES_256_GCM;
+    if (!set_vault_cipher(chosen) || set_vault_cipher(0x7F)) {
+        return false;
+    }
+
+    if (!create_vault(PASSWORD)) {
+        printf(COLOR_RED ">> create_vault failed, vs_status %d\n" COLOR_RESET, vs_status);
+        return false;
+    }
+
+    if (create_vault(PASSWORD) || vs_status != VS_VAULT_EXISTS) {
+        return false;
+    }
+
+    if (!unlock_vault(PASSWORD, master_key) || !read_vault_cipher(&cipher) || cipher != chosen) {
+        return false;
+    }
+
+    return add_secret_entry(master_key);
+}
+
+static bool test_wrong_password() {
+    uint8_t key[VAULT_MASTER_KEY_LEN];
+
+    return !unlock_vault("not the password", key) && vs_status == VS_WRONG_PASSWORD;
+}
+
+static bool test_unlock_same_key() {
+    uint8_t key[VAULT_MASTER_KEY_LEN];
+
+    return unlock_vault(PASSWORD, key) && vs_status == VS_SUCCESS &&
+           memcmp(key, master_key, VAULT_MASTER_KEY_LEN) == 0;
+}
+
+static bool test_rehash_on_unlock() {
+    uint8_t key[VAULT_MASTER_KEY_LEN];
+    KdfDescriptor kdf;
+    Config before, after;
+
+    set_kdf_params(&stronger_params);
+
+    if (!read_wrapped_key(&before)) {
+        return false;
+    }
+
+    if (!unlock_vault(PASSWORD, key) || vs_status != VS_SUCCESS) {
+        printf(COLOR_RED ">> unlock failed, vs_status %d\n" COLOR_RESET, vs_status);
+        free_config(&before);
+        return false;
+    }
+
+    if (!read_kdf_descriptor_service(&kdf) || kdf.params.t_cost != stronger_params.t_cost) {
+        printf(COLOR_RED ">> descriptor was not upgraded\n" COLOR_RESET);
+        free_config(&before);
+        return false;
+    }
+
+    /* only the data key was wrapped again, the entries were left alone */
+    bool rewrapped = read_wrapped_key(&after) && !same_config_value(&before, &after);
+    free_config(&before);
+    free_config(&after);
+
+    if (!rewrapped || memcmp(key, master_key, VAULT_MASTER_KEY_LEN) != 0 ||
+        !secret_row_untouched() || !secret_opens_with(key)) {
+        printf(COLOR_RED ">> data key was not rewrapped in place\n" COLOR_RESET);
+        return false;
+    }
+
+    return test_unlock_same_key();
+}
+
+/* the kdf_params record written by calibrate_kdf_service(), little endian costs */
+static bool store_kdf_params(uint8_t version, uint32_t t_cost, uint32_t m_cost, uint32_t p_cost) {
+    uint8_t record[KDF_PARAMS_RECORD_SIZE_V01] = {version};
+    const uint32_t costs[3] = {t_cost, m_cost, p_cost};
+
+    for (int c = 0; c < 3; c++) {
+        for (int b = 0; b < 4; b++) {
+            record[1 + 4 * c + b] = (uint8_t)(costs[c] >> (8 * b));
+        }
+    }
+
+    Config config = {.config_key = KDF_PARAMS_CONFIG_KEY,
+                     .config_value = record,
+                     .config_value_len = sizeof(record)};
+    return service_update_config(KDF_PARAMS_CONFIG_KEY, record, sizeof(record)) ||
+           service_add_config(&config);
+}
+
+/* unlock applies the calibrated parameters on its own, a corrupted record is an error */
+static bool test_calibrated_params_loaded() {
+    uint8_t key[VAULT_MASTER_KEY_LEN];
+    KdfDescriptor kdf;
+
+    if (!store_kdf_params(KDF_PARAMS_RECORD_VERSION_01, 3, KDF_MIN_M_COST, 1) ||
+        !unlock_vault(PASSWORD, key) || vs_status != VS_SUCCESS ||
+        !read_kdf_descriptor_service(&kdf) || kdf.params.t_cost != 3) {
+        return false;
+    }
+
+    bool ok = store_kdf_params(KDF_PARAMS_RECORD_VERSION_01, 0, KDF_MIN_M_COST, 1) &&
+              !unlock_vault(PASSWORD, key) && vs_status == VS_KDF_ERR &&
+              kdf_status == KDF_CORRUPTED_ERR;
+
+    /* the parameters stay those of the descriptor for the following tests */
+    return service_delete_config(KDF_PARAMS_CONFIG_KEY) && ok && unlock_vault(PASSWORD, key) &&
+           memcmp(key, master_key, VAULT_MASTER_KEY_LEN) == 0;
+}
+
+static bool test_stale_pending_dropped() {
+    KdfDescriptor stale;
+    uint8_t record[KDF_DESCRIPTOR_RECORD_SIZE_V01 + VER_KEY_LEN] = {0};
+    Config pending = {.config_key = VAULT_PENDING_CONFIG_KEY,
+                      .config_value = record,
+                      .config_value_len = sizeof(record)};
+
+    /* an upgrade that crashed before re-encrypting anything */
+    if (!new_kdf_descriptor(&stale) || !encode_kdf_descriptor(&stale, record) ||
+        !service_add_config(&pending)) {
+        return false;
+    }
+
+    if (!test_unlock_same_key()) {
+        return false;
+    }
+
+    Config left = {0};
+    if (service_read_config(VAULT_PENDING_CONFIG_KEY, &left)) {
+        free_config(&left);
+        return false;
+    }
+    return secret_opens_with(master_key);
+}
+
+/* an upgrade that crashed right after storing the new wrapped data key, or the verifier too */
+static bool interrupted_upgrade_finalized(bool verifier_stored) {
+    KdfDescriptor next;
+    uint8_t titan_key[TITAN_KEY_LEN];
+    uint8_t material[MAT_KEY_LEN];
+    uint8_t cipher = 0;
+    uint8_t record[KDF_DESCRIPTOR_RECORD_SIZE_V01 + VER_KEY_LEN + VAULT_MASTER_KEY_LEN +
+                   TAGGED_BLOB_OVERHEAD];
+    uint8_t *verifier = record + KDF_DESCRIPTOR_RECORD_SIZE_V01;
+    uint8_t *wrapped = verifier + VER_KEY_LEN;
+    Config pending = {.config_key = VAULT_PENDING_CONFIG_KEY,
+                      .config_value = record,
+                      .config_value_len = sizeof(record)};
+
+    if (!load_titan_key(titan_key) || !read_vault_cipher(&cipher) ||
+        !new_kdf_descriptor(&next) ||
+        !derive_key_material_kdf(PASSWORD, titan_key, &next, material) ||
+        !encode_kdf_descriptor(&next, record) ||
+        !hash_key(material + VAULT_MASTER_KEY_LEN, next.salt, verifier) ||
+        !encrypt_tagged_blob(material, cipher, master_key, VAULT_MASTER_KEY_LEN, wrapped) ||
+        !service_add_config(&pending) ||
+        !service_update_config(VAULT_DATA_KEY_CONFIG_KEY, wrapped,
+                               VAULT_MASTER_KEY_LEN + TAGGED_BLOB_OVERHEAD) ||
+        (verifier_stored &&
+         !service_update_config(VAULT_VERIFIER_CONFIG_KEY, verifier, VER_KEY_LEN))) {
+        return false;
+    }
+
+    /* a wrong password leaves the record for the right one */
+    uint8_t key[VAULT_MASTER_KEY_LEN];
+    Config left = {0};
+    if (unlock_vault("not the password", key) || vs_status != VS_WRONG_PASSWORD ||
+        !service_read_config(VAULT_PENDING_CONFIG_KEY, &left)) {
+        return false;
+    }
+    free_config(&left);
+
+    KdfDescriptor kdf;
+    if (!unlock_vault(PASSWORD, key) || memcmp(key, master_key, VAULT_MASTER_KEY_LEN) != 0) {
+        return false;
+    }
+
+    if (service_read_config(VAULT_PENDING_CONFIG_KEY, &left)) {
+        free_config(&left);
+        return false;
+    }
+
+    return read_kdf_descriptor_service(&kdf) && memcmp(kdf.salt, next.salt, SALT_LEN) == 0 &&
+           secret_opens_with(key);
+}
+
+static bool test_interrupted_upgrade_finalized() {
+    return interrupted_upgrade_finalized(false) && interrupted_upgrade_finalized(true);
+}
+
+static bool test_change_password() {
+    uint8_t key[VAULT_MASTER_KEY_LEN];
+
+    if (change_master_password("not the password", NEW_PASSWORD) ||
+        vs_status != VS_WRONG_PASSWORD) {
+        return false;
+    }
+
+    if (!change_master_password(PASSWORD, NEW_PASSWORD)) {
+        printf(COLOR_RED ">> change failed, vs_status %d\n" COLOR_RESET, vs_status);
+        return false;
+    }
+
+    if (unlock_vault(PASSWORD, key) || vs_status != VS_WRONG_PASSWORD) {
+        return false;
+    }
+
+    bool ok = unlock_vault(NEW_PASSWORD, key) &&
+              memcmp(key, master_key, VAULT_MASTER_KEY_LEN) == 0 && secret_row_untouched() &&
+              secret_opens_with(key);
+
+    /* the following tests unlock with PASSWORD */
+    return change_master_password(NEW_PASSWORD, PASSWORD) && ok;
+}
+
+static bool test_session_timings() {
+    uint8_t key[VAULT_MASTER_KEY_LEN];
+    UnlockTimings timings;
+    sqlite3 *db = NULL;
+
+    if (!unlock_vault_session(PASSWORD, key, &db, &timings) || !db) {
+        return false;
+    }
+
+    printf(COLOR_CYAN ">> titan key %.2f ms, vault.db %.2f ms, kdf %.2f ms, verify %.2f ms, "
+                      "total %.2f ms\n" COLOR_RESET,
+           timings.titan_key_ms, timings.database_ms, timings.kdf_ms, timings.verify_ms,
+           timings.total_ms);
+
+    /* the connection handed back is usable */
+    DLinkedList *entries = dlinked_list_create();
+    bool ok = entries && read_all_entries(entries, db) == OK && entries->size == 1;
+    dlinked_list_destroy(entries, free_int_entry_node);
+    repo_close(db);
+
+    return ok && timings.kdf_ms > 0 && timings.total_ms >= timings.kdf_ms;
+}
+
+/* a vault created before the data key existed encrypts with its material */
+static bool test_rotate_data_key() {
+    uint8_t key[VAULT_MASTER_KEY_LEN];
+    RekeyStats stats;
+    Config record;
+
+    if (rotate_data_key("not the password", &stats) || vs_status != VS_WRONG_PASSWORD) {
+        return false;
+    }
+
+    /* the nil uuid sorts before every other, it must be moved too */
+    if (!add_secret_entry_at(NIL_UUID, master_key)) {
+        return false;
+    }
+
+    if (!rotate_data_key(PASSWORD, &stats)) {
+        printf(COLOR_RED ">> rotation failed, vs_status %d, rk_status %d\n" COLOR_RESET,
+               vs_status, rk_status);
+        return false;
+    }
+
+    bool ok = stats.entries == 2 && unlock_vault(PASSWORD, key) &&
+              memcmp(key, master_key, VAULT_MASTER_KEY_LEN) != 0 && secret_opens_with(key) &&
+              !secret_opens_with(master_key) && secret_at_opens_with(NIL_UUID, key) &&
+              !service_read_config(VAULT_ROTATION_CONFIG_KEY, &record);
+
+    memcpy(master_key, key, VAULT_MASTER_KEY_LEN);
+    return ok && remove_entry(NIL_UUID);
+}
+
+/* a rotation record left by a crash before any entry was moved, no checkpoint flag */
+static bool test_interrupted_rotation() {
+    uint8_t next_key[VAULT_MASTER_KEY_LEN];
+    uint8_t record[VAULT_MASTER_KEY_LEN + TAGGED_BLOB_OVERHEAD + 1 + UUID_BIN_LEN] = {0};
+    uint8_t key[VAULT_MASTER_KEY_LEN];
+    uint8_t cipher;
+    Config config;
+
+    if (random_raw_bytes(sizeof(next_key), next_key) != SUCCESS ||
+        !read_vault_cipher(&cipher) ||
+        !encrypt_tagged_blob(master_key, cipher, next_key, sizeof(next_key), record)) {
+        return false;
+    }
+
+    config = (Config){.config_key = VAULT_ROTATION_CONFIG_KEY,
+                      .config_value = record,
+                      .config_value_len = sizeof(record)};
+    if (!service_add_config(&config)) {
+        return false;
+    }
+
+    bool ok = unlock_vault(PASSWORD, key) && vs_status == VS_SUCCESS &&
+              memcmp(key, next_key, VAULT_MASTER_KEY_LEN) == 0 && secret_opens_with(key) &&
+              !service_read_config(VAULT_ROTATION_CONFIG_KEY, &config);
+    memcpy(master_key, key, VAULT_MASTER_KEY_LEN);
+
+    /* the same record once the new key is in use is stale and dropped */
+    config = (Config){.config_key = VAULT_ROTATION_CONFIG_KEY,
+                      .config_value = record,
+                      .config_value_len = sizeof(record)};
+    return ok && service_add_config(&config) && unlock_vault(PASSWORD, key) &&
+           memcmp(key, master_key, VAULT_MASTER_KEY_LEN) == 0 &&
+           !service_read_config(VAULT_ROTATION_CONFIG_KEY, &config);
+}
+
+static bool test_legacy_vault_wrapped() {
+    uint8_t titan_key[TITAN_KEY_LEN];
+    uint8_t material[MAT_KEY_LEN];
+    uint8_t key[VAULT_MASTER_KEY_LEN];
+    KdfDescriptor kdf;
+    Config wrapped;
+
+    if (!reset_vault() || !create_vault(PASSWORD) ||
+        !service_delete_config(VAULT_DATA_KEY_CONFIG_KEY) || !load_titan_key(titan_key) ||
+        !read_kdf_descriptor_service(&kdf) ||
+        !derive_key_material_kdf(PASSWORD, titan_key, &kdf, material) ||
+        !add_secret_entry(material)) {
+        return false;
+    }
+
+    /* the first unlock keeps the key and wraps it */
+    if (!unlock_vault(PASSWORD, key) || vs_status != VS_SUCCESS ||
+        memcmp(key, material, VAULT_MASTER_KEY_LEN) != 0 || !read_wrapped_key(&wrapped)) {
+        return false;
+    }
+    free_config(&wrapped);
+
+    return unlock_vault(PASSWORD, key) && memcmp(key, material, VAULT_MASTER_KEY_LEN) == 0 &&
+           secret_row_untouched() && secret_opens_with(key);
+}
+
+static void report(const char *name, bool ok, bool *passed) {
+    if (ok) {
+        printf(COLOR_GREEN "[PASS] " COLOR_RESET "%s\n", name);
+    } else {
+        printf(COLOR_RED "[FAIL] " COLOR_RESET "%s\n", name);
+        *passed = false;
+    }
+}
+
+int main() {
+    printf(COLOR_BLUE "\nVAULT SERVICE TEST\n" COLOR_RESET);
+
+    printf(COLOR_YELLOW "\n--> setup phase\n" COLOR_RESET);
+    if (!initialize_environment() || !init_schema() || !open_config_service()) {
+        printf(COLOR_RED ">> Failed to open the config service\n" COLOR_RESET);
+        return 1;
+    }
+    if (!reset_vault()) {
+        printf(COLOR_RED ">> Failed to reset the vault\n" COLOR_RESET);
+        close_config_service();
+        return 1;
+    }
+
+    bool passed = true;
+
+    printf(COLOR_YELLOW "\n--> vault lifecycle\n" COLOR_RESET);
+    report("vault created once", test_create(), &passed);
+    report("wrong password rejected", test_wrong_password(), &passed);
+    report("unlock returns the same master key", test_unlock_same_key(), &passed);
+    report("outdated descriptor upgraded on unlock", test_rehash_on_unlock(), &passed);
+    report("calibrated parameters applied on unlock", test_calibrated_params_loaded(), &passed);
+    report("stale pending upgrade discarded", test_stale_pending_dropped(), &passed);
+    report("interrupted upgrade completed", test_interrupted_upgrade_finalized(), &passed);
+    report("password change only rewraps the data key", test_change_password(), &passed);
+    report("unlock session keeps vault.db open", test_session_timings(), &passed);
+    report("data key rotation re-encrypts the entries", test_rotate_data_key(), &passed);
+    report("interrupted rotation finished on unlock", test_interrupted_rotation(), &passed);
+    report("vault without data key wrapped on unlock", test_legacy_vault_wrapped(), &passed);
+
+    close_config_service();
+
+    if (!passed) {
+        printf(COLOR_RED "\nVAULT SERVICE TEST FAILED\n\n" COLOR_RESET);
+        return 1;
+    }
+
+    printf(COLOR_BLUE "\nVAULT SERVICE TEST COMPLETED\n\n" COLOR_RESET);
+    return 0;
+}